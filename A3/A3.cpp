@@ -466,7 +466,7 @@ static void updateShaderUniforms(
 	{
 		//-- Set ModelView matrix:
 		GLint location = shader.getUniformLocation("ModelView");
-		mat4 modelView = viewMatrix * node.trans;
+		mat4 modelView = viewMatrix * node.get_world_transform();
 		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
 		CHECK_GL_ERRORS;
 
@@ -570,6 +570,9 @@ void A3::renderSceneGraph(const SceneNode & root) {
 	// could put a set of mutually recursive functions in this class, which
 	// walk down the tree from nodes of different types.
 
+	// one pass over the tree brings every moved node's world transform up to date
+	((SceneNode &) root).update_world();
+
 	renderNodes((SceneNode *) &root);
 
 	glBindVertexArray(0);
@@ -592,9 +595,7 @@ void A3::renderNodes(SceneNode *root, bool picking){
 		m_shader.disable();
 	}
 	for (SceneNode *child : root->children){
-		child->set_transform(root->get_transform() * child->get_transform());
 		renderNodes(child);
-		child->set_transform(glm::inverse(root->get_transform()) * child->get_transform());
 	}
 }
 
@@ -64,6 +64,7 @@ void JointNode::rotate(char axis, float angle) {
 	undo_rot = rot_matrix * undo_rot;
 	mat4 tempscale = scale_mat;
 	trans = rot_matrix * trans;
+	world_dirty = true;
 
 }
 
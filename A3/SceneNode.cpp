@@ -27,6 +27,8 @@ SceneNode::SceneNode(const std::string& name)
 	undo_rot(mat4()),
 	isSelected(false),
 	scale_mat(mat4()),
+	world(mat4()),
+	world_dirty(true),
 	m_nodeId(nodeInstanceCount++)
 {
 
@@ -38,7 +40,9 @@ SceneNode::SceneNode(const SceneNode & other)
 	: m_nodeType(other.m_nodeType),
 	  m_name(other.m_name),
 	  trans(other.trans),
-	  invtrans(other.invtrans)
+	  invtrans(other.invtrans),
+	  world(other.world),
+	  world_dirty(true)
 {
 	for(SceneNode * child : other.children) {
 		this->children.push_front(new SceneNode(*child));
@@ -56,6 +60,20 @@ SceneNode::~SceneNode() {
 void SceneNode::set_transform(const glm::mat4& m) {
 	trans = m;
 	invtrans = m;
+	world_dirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+void SceneNode::update_world(const glm::mat4& parentWorld, bool parentChanged) {
+	bool changed = parentChanged || world_dirty;
+	if (changed) {
+		world = parentWorld * trans;
+		world_dirty = false;
+	}
+
+	for (SceneNode * child : children) {
+		child->update_world(world, changed);
+	}
 }
 
 //---------------------------------------------------------------------------------------
@@ -63,6 +81,11 @@ const glm::mat4& SceneNode::get_transform() const {
 	return trans;
 }
 
+//---------------------------------------------------------------------------------------
+const glm::mat4& SceneNode::get_world_transform() const {
+	return world;
+}
+
 //---------------------------------------------------------------------------------------
 const glm::mat4& SceneNode::get_inverse() const {
 	return invtrans;
@@ -114,6 +137,7 @@ void SceneNode::rotate(char axis, float angle) {
 	rot = rot_matrix * rot;
 	undo_rot = rot_matrix * undo_rot;
 	trans = rot_matrix * trans;
+	world_dirty = true;
 
 }
 
@@ -124,12 +148,14 @@ void SceneNode::scale(const glm::vec3 & amount) {
 	trans = glm::scale(amount) * mat4();
 	trans = temp * trans;*/
 	trans = glm::scale(amount) * trans;
+	world_dirty = true;
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::translate(const glm::vec3& amount) {
 	transl = glm::translate(amount) * transl;
 	trans = glm::translate(amount) * trans;
+	world_dirty = true;
 }
 
 void SceneNode::start_undo(){
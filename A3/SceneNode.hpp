@@ -29,8 +29,15 @@ public:
     const glm::mat4& get_translation() const;
     const glm::mat4& get_rotation() const;
     const glm::mat4& get_scale() const;
+
+    // trans composed with every ancestor's, as of the last update_world()
+    const glm::mat4& get_world_transform() const;
     
     void set_transform(const glm::mat4& m);
+
+    // Recomputes the cached world transforms below this node, only for nodes whose
+    // trans, or an ancestor's, changed since the last update.
+    void update_world(const glm::mat4& parentWorld = glm::mat4(), bool parentChanged = false);
     
     void add_child(SceneNode* child);
     
@@ -56,6 +63,8 @@ public:
     glm::mat4 transl;
     glm::mat4 scale_mat;
     glm::mat4 invtrans;
+    glm::mat4 world;
+    bool world_dirty; // trans changed since world was computed
 
     glm::mat4 undo_rot;
     
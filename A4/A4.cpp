@@ -1,13 +1,20 @@
 #include <glm/ext.hpp>
 
+#include <chrono>
+
 #include "A4.hpp"
 #include "GeometryNode.hpp"
 #include "PhongMaterial.hpp"
-
-#define EPSILON 0.0001
+#include "Rasterizer.hpp"
+#include "Parallel.hpp"
+#include "FrameHistory.hpp"
+#include "PerfCounters.hpp"
 
 #define RENDER_BOUNDING false
 
+//find primary ray hits by rasterizing the scene, only shadow rays traverse the tree
+#define RASTER_PRIMARY true
+
 void A4_Render(
 		// What to render
 		SceneNode * root,
@@ -23,7 +30,11 @@ void A4_Render(
 
 		// Lighting parameters
 		const glm::vec3 & ambient,
-		const std::list<Light *> & lights
+		const std::list<Light *> & lights,
+
+		FeatureBuffers * features,
+
+		FrameHistory * history
 ) {
 
   // Fill in raytracing code here...
@@ -56,73 +67,144 @@ void A4_Render(
 	glm::vec3 _eye = eye;
 	glm::vec3 _view = view;
 
+	//convert (x,y) to world coordinates
+	double d = glm::length(_view);
+	double h_fov = 2*d*tan(glm::radians(fovy)/2);
+
+	glm::mat4 T1 = glm::translate(glm::vec3(-(double)w/2.0, -(double)h/2.0, d));
+	glm::mat4 S2  = glm::scale(glm::vec3(-h_fov/(double)h, -h_fov/(double)h, 1.0));
+	
+	glm::vec3 u, v, w_vec;
+	w_vec = glm::normalize(_view);
+	u = glm::normalize(glm::cross(up, w_vec));
+	v = glm::cross(w_vec, u);
+
+	glm::mat4 R3 = glm::mat4( glm::vec4(u, 0),
+							glm::vec4(v, 0),
+							glm::vec4(w_vec, 0),
+							glm::vec4(glm::vec3(0.0), 1));
+	
+	glm::mat4 T4 = glm::mat4(glm::vec4(1, 0, 0, 0),
+							glm::vec4(0, 1, 0, 0),
+							glm::vec4(0, 0, 1, 0),
+							glm::vec4(eye[0], eye[1], eye[2], 1));
+
+	glm::mat4 to_world = T4 * R3 * S2 * T1;
+
+	Rasterizer *raster = nullptr;
+	if (RASTER_PRIMARY && !RENDER_BOUNDING) {
+		auto start = std::chrono::steady_clock::now();
+
+		{
+			PerfScope build(PerfPhase::Build);
+			raster = new Rasterizer(root, w, h, _eye, to_world);
+		}
+		raster->render(renderThreads());
+
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		std::cout << "Primary visibility: " << raster->numTriangles() << " triangles rasterized in "
+			<< ms << " ms" << std::endl;
+	}
+
+	// everything below runs on this thread, so one context covers it
+	TraceContext context(lights.size());
+	std::vector<uint64_t> touched;
+	Sampler sampler;
+
+	if (history) {
+		PerfScope build(PerfPhase::Build);
+		history->beginFrame(root, w, h, eye, view, up, fovy, ambient, lights);
+		context.touched = &touched;
+	}
+
+	PerfScope shade(PerfPhase::Shade);
+
 	for (uint y = 0; y < h; ++y) {
 		for (uint x = 0; x < w; ++x) {
 
-			//convert (x,y) to world coordinates
 			p_k[0] = x; //x_k
 			p_k[1] = y; //y_k
 			p_k[2] = 0; //z_k
 			p_k[3] = 1;
 
-			double d = glm::length(_view);
-			double h_fov = 2*d*tan(glm::radians(fovy)/2);
+			glm::vec3 p_world = glm::vec3(to_world * p_k);//glm::vec3(p_world4[0], p_world4[1], p_world4[2]);
 
-			glm::mat4 T1 = glm::translate(glm::vec3(-(double)w/2.0, -(double)h/2.0, d));
-			glm::mat4 S2  = glm::scale(glm::vec3(-h_fov/(double)h, -h_fov/(double)h, 1.0));
-			
-			glm::vec3 u, v, w_vec;
-			w_vec = glm::normalize(_view);
-			u = glm::normalize(glm::cross(up, w_vec));
-			v = glm::cross(w_vec, u);
-
-			glm::mat4 R3 = glm::mat4( glm::vec4(u, 0),
-									glm::vec4(v, 0),
-									glm::vec4(w_vec, 0),
-									glm::vec4(glm::vec3(0.0), 1));
-			
-			glm::mat4 T4 = glm::mat4(glm::vec4(1, 0, 0, 0),
-									glm::vec4(0, 1, 0, 0),
-									glm::vec4(0, 0, 1, 0),
-									glm::vec4(eye[0], eye[1], eye[2], 1));
+			Ray r(rvec3(_eye), rvec3(p_world - _eye));
 
-			//glm::vec4 p_world4 = to_world*p_k;
-			glm::mat4 to_world = T4 * R3 * S2 * T1;
-			glm::vec3 p_world = glm::vec3(to_world * p_k);//glm::vec3(p_world4[0], p_world4[1], p_world4[2]);
+			if (history && history->reuse(x, y, r, image, features)) {
+				context.stats.pixelsReused++;
+				continue;
+			}
 
-			Ray r(_eye, p_world - _eye);
-			Intersection inter = intersect(root, &r);
+			Intersection inter = raster ? raster->intersect(x, y, r) : intersect(root, &r);
+			touched.clear();
+			if (inter._hit) touched.push_back(inter._instance);
 
 			// Red: increasing from top to bottom
 			// Green: increasing from left to right
 			// Blue: in lower-left and upper-right corners
 			/*glm::vec3 color((double)y / h, (double)x / w, ((y < h/2 && x < w/2)
 							|| (y >= h/2 && x >= w/2)) ? 1.0 : 0.0);*/
-			glm::vec3 color = getBg(x, y, w, h);
+			PixelSampler pixelSampler(sampler, x, y);
+			glm::vec3 color = getBg(x, y, w, h, pixelSampler);
 
 			if (inter._hit){
 				const PhongMaterial * phong_m = static_cast<const PhongMaterial *>(inter._material);
 				int maxHits = 3;
-				color = rayColor (&r, inter, ambient, lights, root, maxHits);
+				color = rayColor (&r, inter, ambient, lights, root, maxHits, &context);
 			} 
 
+			if (features) {
+				glm::vec3 albedo = color;
+				glm::vec3 normal(0.0f);
+				double depth = -1;
+				if (inter._hit) {
+					albedo = static_cast<const PhongMaterial *>(inter._material)->kd();
+					normal = inter._normal;
+					depth = glm::length(glm::vec3(inter._point) - _eye);
+				}
+				for (int i = 0; i < 3; i++) {
+					features->albedo(x, y, i) = albedo[i];
+					features->normal(x, y, i) = normal[i];
+				}
+				features->depth(x, y, 0) = depth;
+			}
+
 			// Red: increasing from top to bottom
 			image(x, y, 0) = color[0];
 			// Green: increasing from left to right
 			image(x, y, 1) = color[1];
 			// Blue: in lower-left and upper-right corners
 			image(x, y, 2) = color[2];
+
+			if (history) {
+				history->record(x, y, inter, touched, image, features);
+			}
 		}
 	}
 	//image.savePng("test.png");
 
+	shade.stop();
+
+	if (history) {
+		history->endFrame();
+	}
+
+	std::cout << context.stats << std::endl;
+
+	perfAddRays((uint64_t)w*h - context.stats.pixelsReused + context.stats.shadowRays);
+	perfReport(std::cout);
+
+	delete raster;
 }
 
-Intersection intersect(SceneNode *root, Ray *ray) {
+Intersection intersect(SceneNode *root, Ray *ray, uint64_t path) {
 	Intersection intersection;
 	Material *material = nullptr;
+	path = instancePath(path, root);
 
-	Ray r(glm::vec3(root->get_inverse() * glm::vec4(ray->_orig, 1)), glm::vec3(root->get_inverse() * glm::vec4(ray->_dir,0)));
+	Ray r = ray->transformed(root->get_inverse());
 	//Ray r(glm::mat3(root->get_transform()) * ray->_orig, glm::mat3(root->get_transform()) * ray->_dir);
 
 	if (root->m_nodeType == NodeType::GeometryNode){
@@ -130,12 +212,13 @@ Intersection intersect(SceneNode *root, Ray *ray) {
 		//test intersection with actual primitive
 		intersection = (RENDER_BOUNDING ? geometryNode->m_primitive->intersect_bounding(&r) 
 									: geometryNode->m_primitive->intersect(&r));
+		intersection._instance = path;
 		material = geometryNode->m_material;
 	}
 
 	for (SceneNode *child : root->children){
 
-		Intersection i = intersect(child, &r);
+		Intersection i = intersect(child, &r, path);
 
 		if (i._t < EPSILON) continue;
 
@@ -155,8 +238,7 @@ Intersection intersect(SceneNode *root, Ray *ray) {
 
 	//transform intersection point by original transformation
 	
-	intersection._point = glm::vec3(root->get_transform() * glm::vec4(intersection._point,1));
-	intersection._normal = glm::normalize(glm::transpose(glm::mat3(root->get_inverse())) * intersection._normal);
+	intersection.transform(root->get_transform(), root->get_inverse());
 	if (intersection._hit){
 		if (material != nullptr){
 			intersection._material = material;
@@ -166,44 +248,109 @@ Intersection intersect(SceneNode *root, Ray *ray) {
 	return intersection;
 }
 
+bool findOccluder(SceneNode *root, Ray *ray, Occluder &occluder, RenderStats *stats, uint64_t path) {
+	if (stats) stats->shadowNodesVisited++;
+	path = instancePath(path, root);
+
+	Ray r = ray->transformed(root->get_inverse());
+
+	if (root->m_nodeType == NodeType::GeometryNode){
+		GeometryNode * geometryNode = static_cast<GeometryNode *>(root);
+		Intersection i = (RENDER_BOUNDING ? geometryNode->m_primitive->intersect_bounding(&r) 
+									: geometryNode->m_primitive->intersect(&r));
+		if (i._hit && i._t >= EPSILON && i._t < 1) {
+			occluder.node = geometryNode;
+			occluder.toLocal = root->get_inverse();
+			occluder.instance = path;
+			return true;
+		}
+	}
+
+	for (SceneNode *child : root->children){
+		if (findOccluder(child, &r, occluder, stats, path)) {
+			//compose on the way back up, only the path to the occluder pays for it
+			occluder.toLocal = occluder.toLocal * root->get_inverse();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//true if something lies between the shadow ray's origin and the light (t < 1)
+static bool inShadow(Ray *shadow, SceneNode *root, Occluder *cached, TraceContext *context) {
+	RenderStats *stats = context ? &context->stats : nullptr;
+	if (stats) stats->shadowRays++;
+
+	if (cached && cached->node) {
+		Ray local = shadow->transformed(cached->toLocal);
+		Intersection i = (RENDER_BOUNDING ? cached->node->m_primitive->intersect_bounding(&local) 
+									: cached->node->m_primitive->intersect(&local));
+		if (i._hit && i._t >= EPSILON && i._t < 1) {
+			if (stats) {
+				stats->shadowCacheHits++;
+				stats->shadowOccluded++;
+			}
+			if (context->touched) context->touched->push_back(cached->instance);
+			return true;
+		}
+	}
+
+	if (stats) stats->shadowTraversals++;
+
+	Occluder occluder;
+	bool occluded = findOccluder(root, shadow, occluder, stats);
+	if (stats && occluded) stats->shadowOccluded++;
+	if (occluded && context && context->touched) context->touched->push_back(occluder.instance);
+
+	//forget the occluder once the light is visible again, lit neighbours are
+	//likely lit too and testing a stale occluder first would only cost time
+	if (cached) {
+		*cached = occluder;
+	}
+	return occluded;
+}
+
 //maxHits not even used yet
 glm::vec3 rayColor(Ray* r, Intersection &inter, 
 	const glm::vec3 & ambient, const std::list<Light *> & lights, SceneNode *root,
 	/*const glm::vec3 & bg,*/
-	int &maxHits) 
+	int &maxHits, TraceContext *context) 
 {
 	const PhongMaterial * phong_m = static_cast<const PhongMaterial *>(inter._material);
 	Light _light;
-	glm::dvec3 p = inter._point;
-	glm::dvec3 raydir = glm::normalize(r->_orig - inter._point); //intersection to eye
-	glm::dvec3 light_dir;
+	rvec3 p = inter._point;
+	rvec3 raydir = glm::normalize(r->_orig - inter._point); //intersection to eye
+	rvec3 light_dir;
 	//glm::vec3 total_col = bg;
-	glm::dvec3 col = phong_m->kd() * ambient;
-	glm::dvec3 normal = glm::normalize(glm::dvec3(inter._normal));
+	rvec3 col = rvec3(phong_m->kd() * ambient);
+	rvec3 normal = glm::normalize(inter._normal);
+
+	size_t lightIndex = 0;
 
 	//implementation based off of A3 fragment shader
 	for (Light *light : lights){
-		glm::dvec3 diffuse(0.0f);
-		glm::dvec3 specular(0.0f);
+		Occluder *cached = (context && lightIndex < context->shadowCache.size()) ? &context->shadowCache[lightIndex] : nullptr;
+		lightIndex++;
+
+		rvec3 diffuse(0.0f);
+		rvec3 specular(0.0f);
 
 		//from intersection point to light
-		light_dir = light->position - inter._point;
-		glm::dvec3 shadow_dir = light_dir;
+		light_dir = rvec3(light->position) - inter._point;
+		rvec3 shadow_dir = light_dir;
 		light_dir = glm::normalize(light_dir);
-		Ray shadow(glm::dvec3(inter._point) + EPSILON * shadow_dir, shadow_dir);
-
-		//check shadow ray intersection
-		Intersection shadow_inter = intersect(root, &shadow);
+		Ray shadow(inter._point + real(EPSILON) * shadow_dir, shadow_dir);
 
-		//if shadow ray hits something, don't do anything
-		if (shadow_inter._hit && glm::length(shadow_inter._t * shadow._dir) < glm::length(shadow_dir)) continue;
+		//if shadow ray hits something before the light, don't do anything
+		if (inShadow(&shadow, root, cached, context)) continue;
 		
 		//L - 2N(L*N)
-		glm::dvec3 reflected_ray = light_dir - 2*glm::dot(light_dir, normal)*normal; 
-		double l_n = glm::dot(normal, light_dir); //L*N
+		rvec3 reflected_ray = light_dir - 2*glm::dot(light_dir, normal)*normal; 
+		real l_n = glm::dot(normal, light_dir); //L*N
 		if (l_n < 0) l_n = 0.0;
 		if (glm::length(phong_m->kd()) != 0){
-			diffuse = l_n*phong_m->kd();// * light->colour;
+			diffuse = l_n*rvec3(phong_m->kd());// * light->colour;
 		}
 		
 		//Ray reflected(glm::dvec3(inter._point) + 0.001*reflected_ray, reflected_ray);
@@ -213,22 +360,22 @@ glm::vec3 rayColor(Ray* r, Intersection &inter,
 
 		if (glm::length(phong_m->ks()) > 0 && maxHits > 0){
 		//if (l_n > 0.0) {
-			glm::dvec3 v = glm::normalize(-inter._point);
-			glm::dvec3 l = shadow_dir;
-			double n_h = std::max(glm::dot(normal, glm::normalize(v + l)), 0.0);
+			rvec3 v = glm::normalize(-inter._point);
+			rvec3 l = shadow_dir;
+			real n_h = std::max(glm::dot(normal, glm::normalize(v + l)), real(0));
 			
-			specular = phong_m->ks() * pow(n_h, phong_m->shininess());
+			specular = rvec3(phong_m->ks()) * real(pow(n_h, phong_m->shininess()));
 			/*if (l_n != 0)
 				specular = (pow(r_v,phong_m->shininess()))*phong_m->ks();// * light->colour;
 			/*specular = pow(ks,phong_m->shininess() )*phong_m->ks() *
 				rayColor(&reflected, inter, ambient, lights, root, --maxHits);*/
 		}
-		col = col + glm::dvec3(light->colour) * (diffuse + specular /( light->falloff[0] + 
+		col = col + rvec3(light->colour) * (diffuse + specular /real( light->falloff[0] + 
 				light->falloff[1] * glm::length(reflected_ray) +
 				light->falloff[2] * pow(glm::length(reflected_ray), 2)));
 	}
 	
-	return col;
+	return glm::vec3(col);
 }
 
 void printHier(SceneNode *root){
@@ -243,7 +390,7 @@ void printHier(SceneNode *root){
 }
 
 //generates a black - blue gradient night sky with random stars
-glm::vec3 getBg(int x, int y, int w, int h){
+glm::vec3 getBg(int x, int y, int w, int h, PixelSampler &sampler){
 	//default from starter code
 	/*return glm::vec3((double)y / h, (double)x / w, ((y < h/2 && x < w/2)
 							|| (y >= h/2 && x >= w/2)) ? 1.0 : 0.0);*/
@@ -256,10 +403,10 @@ glm::vec3 getBg(int x, int y, int w, int h){
 	r *= 0.1;
 	g *= 0.1;
 
-	int rand = std::rand() % 100;
-
-	if (rand == 0) {
-		rand = std::rand() % 20 + 1;
+	//1 in 100 pixels is a star, per pixel rather than std::rand so it doesn't
+	//depend on the order pixels are traced in
+	if (sampler.get1D() < 0.01f) {
+		int rand = (int)(sampler.get1D() * 20) + 1;
 		glm::dvec3 col(r, g, b);
 		return col + glm::dvec3(1.0)/(double)rand;
 	}
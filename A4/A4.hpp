@@ -5,6 +5,45 @@
 #include "SceneNode.hpp"
 #include "Light.hpp"
 #include "Image.hpp"
+#include "Denoiser.hpp"
+#include "RenderStats.hpp"
+#include "Sampler.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#define EPSILON 0.0001
+
+class GeometryNode;
+class FrameHistory;
+
+// Identifies one instance of a node: the same node added under several parents
+// gets a different key for each path from the root.
+inline uint64_t instancePath(uint64_t parentPath, const SceneNode * node) {
+	return (parentPath ^ (node->m_nodeId + 1)) * 1099511628211ULL;
+}
+
+// A GeometryNode found blocking a shadow ray.
+struct Occluder {
+	Occluder() : node(nullptr), instance(0) { }
+	GeometryNode * node;
+	rmat4 toLocal; // world to the node's model space
+	uint64_t instance;
+};
+
+// Per-thread tracing state.
+struct TraceContext {
+	TraceContext(size_t numLights) : shadowCache(numLights), touched(nullptr) { }
+
+	// Last object found blocking each light, tested before walking the scene graph
+	// since neighbouring shading points are usually shadowed by the same thing.
+	std::vector<Occluder> shadowCache;
+
+	RenderStats stats;
+
+	// If set, the instances hit by the current pixel's rays are appended here.
+	std::vector<uint64_t> * touched;
+};
 
 void A4_Render(
 		// What to render
@@ -21,16 +60,26 @@ void A4_Render(
 
 		// Lighting parameters
 		const glm::vec3 & ambient,
-		const std::list<Light *> & lights
+		const std::list<Light *> & lights,
+
+		// Optional albedo/normal/depth buffers for the denoiser
+		FeatureBuffers * features = nullptr,
+
+		// Optional record of the previous frame, unchanged pixels are copied from it
+		FrameHistory * history = nullptr
 );
 
-Intersection intersect(SceneNode *root, Ray *ray);
+// path is the instancePath of root's parent, hits report theirs in _instance
+Intersection intersect(SceneNode *root, Ray *ray, uint64_t path = 0);
+
+// Any-hit query for shadow rays: finds a GeometryNode hit with EPSILON <= t < 1.
+bool findOccluder(SceneNode *root, Ray *ray, Occluder &occluder, RenderStats *stats, uint64_t path = 0);
 
 glm::vec3 rayColor(Ray* r, Intersection &inter, 
 	const glm::vec3 & ambient, const std::list<Light *> & lights, SceneNode *root,
 	/*const glm::vec3 & bg,*/
-	int &maxHits);
+	int &maxHits, TraceContext *context = nullptr);
 
 void printHier(SceneNode *root);
 
-glm::vec3 getBg(int x, int y, int w, int h);
\ No newline at end of file
+glm::vec3 getBg(int x, int y, int w, int h, PixelSampler &sampler);
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "Denoiser.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Edge stopping parameters.  The colour term is halved every pass since the image
+// gets smoother; depth differences are relative to the centre pixel's depth.
+#define SIGMA_COLOUR 0.6f
+#define SIGMA_NORMAL 0.3f
+#define SIGMA_ALBEDO 0.1f
+#define SIGMA_DEPTH 0.05f
+
+static const float kernel[5] = { 1.0f/16, 1.0f/4, 3.0f/8, 1.0f/4, 1.0f/16 };
+
+// feature planes a tap compares: colour, normal, albedo (3 each), depth
+#define NUM_TAP_PLANES 10
+
+// One plane per channel.  Each tap's row is gathered from them, clamped at the edges,
+// into contiguous scratch rows, so the weight loop reads every plane at x and
+// vectorises.
+struct Planes {
+	Planes(size_t n, int channels) : c(channels, std::vector<float>(n)) { }
+	std::vector<std::vector<float>> c;
+};
+
+//---------------------------------------------------------------------------------------
+static void toPlanes(const Image & image, Planes & planes, int channels)
+{
+	size_t n = (size_t)image.width()*image.height();
+	const double * data = image.data();
+	for (int k = 0; k < channels; k++) {
+		float * out = planes.c[k].data();
+		for (size_t i = 0; i < n; i++) {
+			out[i] = (float)data[3*i + k];
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Row y of src shifted by `shift` pixels, clamped at the edges, into dst.
+static void gatherRow(const float * src, int w, int shift, float * dst)
+{
+	int begin = std::min(std::max(-shift, 0), w);
+	int end = std::max(std::min(w - shift, w), begin);
+	std::fill(dst, dst + begin, src[0]);
+	std::copy(src + begin + shift, src + end + shift, dst + begin);
+	std::fill(dst + end, dst + w, src[w - 1]);
+}
+
+//---------------------------------------------------------------------------------------
+// exp(x) for x <= 0, to about 3e-5 relative: 2^n from the exponent bits times a
+// polynomial for 2^f, f in (-1, 0].  Clamped at -80 on the bits, since a float
+// compare here is a branch GCC won't if-convert without -fno-trapping-math, so the
+// weight loop still vectorises.
+static inline float fastExp(float x)
+{
+	uint32_t xbits;
+	std::memcpy(&xbits, &x, sizeof(xbits));
+	const uint32_t minus80 = 0xc2a00000u; // negative floats sort by magnitude as bits
+	xbits = xbits > minus80 ? minus80 : xbits;
+	std::memcpy(&x, &xbits, sizeof(x));
+
+	float t = x * 1.44269504f;
+	int n = (int)t;
+	float f = (t - (float)n) * 0.69314718f;
+	float p = 1.0f + f*(1.0f + f*(0.5f + f*(1.0f/6 + f*(1.0f/24 + f*(1.0f/120 + f*(1.0f/720))))));
+
+	uint32_t bits;
+	std::memcpy(&bits, &p, sizeof(bits));
+	bits += (uint32_t)n << 23;
+	std::memcpy(&p, &bits, sizeof(p));
+	return p;
+}
+
+//---------------------------------------------------------------------------------------
+// Inverse squared sigmas of one pass.
+struct EdgeStops {
+	float colour;
+	float normal;
+	float albedo;
+	float depth;
+};
+
+//---------------------------------------------------------------------------------------
+// Adds one tap with kernel weight k to a row: centre and tap are the row's and the
+// tap's planes, in the order colour, normal, albedo (3 each), depth.
+static void accumulateTap(int w, float k, const EdgeStops & stops,
+	const float * const * centre, const float * const * tap,
+	float * __restrict weights, float * __restrict sumR, float * __restrict sumG,
+	float * __restrict sumB)
+{
+	const float * __restrict cr = centre[0], * __restrict cg = centre[1], * __restrict cb = centre[2];
+	const float * __restrict cnx = centre[3], * __restrict cny = centre[4], * __restrict cnz = centre[5];
+	const float * __restrict car = centre[6], * __restrict cag = centre[7], * __restrict cab = centre[8];
+	const float * __restrict cz = centre[9];
+	const float * __restrict tr = tap[0], * __restrict tg = tap[1], * __restrict tb = tap[2];
+	const float * __restrict tnx = tap[3], * __restrict tny = tap[4], * __restrict tnz = tap[5];
+	const float * __restrict tar = tap[6], * __restrict tag = tap[7], * __restrict tab = tap[8];
+	const float * __restrict tz = tap[9];
+
+	for (int x = 0; x < w; x++) {
+		float dr = cr[x] - tr[x], dg = cg[x] - tg[x], db = cb[x] - tb[x];
+		float dc = dr*dr + dg*dg + db*db;
+		float nx = cnx[x] - tnx[x], ny = cny[x] - tny[x], nz = cnz[x] - tnz[x];
+		float dn = nx*nx + ny*ny + nz*nz;
+		float ar = car[x] - tar[x], ag = cag[x] - tag[x], ab = cab[x] - tab[x];
+		float da = ar*ar + ag*ag + ab*ab;
+		float zp = cz[x];
+		float zq = tz[x];
+		// background depths are -1, and a background tap is dropped below anyway
+		float dz = std::abs(zp - zq) / (std::abs(zp) + 1e-4f);
+
+		float wq = k*fastExp(-dc*stops.colour - dn*stops.normal
+			- da*stops.albedo - dz*stops.depth);
+
+		// never mix background into geometry or the other way round, masked on the
+		// bits for the same reason as in fastExp
+		uint32_t same = 0u - (uint32_t)((zp < 0) == (zq < 0));
+		uint32_t wbits;
+		std::memcpy(&wbits, &wq, sizeof(wbits));
+		wbits &= same;
+		std::memcpy(&wq, &wbits, sizeof(wq));
+
+		weights[x] += wq;
+		sumR[x] += wq*tr[x];
+		sumG[x] += wq*tg[x];
+		sumB[x] += wq*tb[x];
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void denoise(Image & image, const FeatureBuffers & features, uint iterations)
+{
+	int w = image.width();
+	int h = image.height();
+	size_t n = (size_t)w*h;
+	if (n == 0) return;
+
+	Planes colour(n, 3), filtered(n, 3), albedo(n, 3), normal(n, 3), depth(n, 1);
+	toPlanes(image, colour, 3);
+	toPlanes(features.albedo, albedo, 3);
+	toPlanes(features.normal, normal, 3);
+	toPlanes(features.depth, depth, 1);
+
+	for (uint it = 0; it < iterations; it++) {
+		int step = 1 << it;
+		float sigmaColour = SIGMA_COLOUR / (float)step;
+		EdgeStops stops;
+		stops.colour = 1.0f / (sigmaColour*sigmaColour);
+		stops.normal = 1.0f / (SIGMA_NORMAL*SIGMA_NORMAL);
+		stops.albedo = 1.0f / (SIGMA_ALBEDO*SIGMA_ALBEDO);
+		stops.depth = 1.0f / (SIGMA_DEPTH*step);
+
+		parallelFor(renderThreads(), h, [&](size_t y) {
+			std::vector<float> scratch((NUM_TAP_PLANES + 4)*w, 0.0f);
+			float * tap[NUM_TAP_PLANES];
+			for (int c = 0; c < NUM_TAP_PLANES; c++) {
+				tap[c] = scratch.data() + c*w;
+			}
+			float * sum[3] = { tap[NUM_TAP_PLANES - 1] + w, tap[NUM_TAP_PLANES - 1] + 2*w,
+				tap[NUM_TAP_PLANES - 1] + 3*w };
+			float * weights = tap[NUM_TAP_PLANES - 1] + 4*w;
+
+			size_t row = y*w;
+			const float * centre[NUM_TAP_PLANES];
+			const std::vector<float> * planes[NUM_TAP_PLANES] = {
+				&colour.c[0], &colour.c[1], &colour.c[2],
+				&normal.c[0], &normal.c[1], &normal.c[2],
+				&albedo.c[0], &albedo.c[1], &albedo.c[2],
+				&depth.c[0]
+			};
+			for (int c = 0; c < NUM_TAP_PLANES; c++) {
+				centre[c] = planes[c]->data() + row;
+			}
+
+			for (int j = -2; j <= 2; j++) {
+				int qy = std::min(std::max((int)y + j*step, 0), h - 1);
+				size_t qrow = (size_t)qy*w;
+
+				for (int i = -2; i <= 2; i++) {
+					float k = kernel[i + 2]*kernel[j + 2];
+					for (int c = 0; c < NUM_TAP_PLANES; c++) {
+						gatherRow(planes[c]->data() + qrow, w, i*step, tap[c]);
+					}
+
+					accumulateTap(w, k, stops, centre, tap, weights, sum[0], sum[1], sum[2]);
+				}
+			}
+
+			for (int x = 0; x < w; x++) {
+				// the centre tap always has weight > 0
+				float inv = 1.0f / weights[x];
+				for (int c = 0; c < 3; c++) {
+					filtered.c[c][row + x] = sum[c][x]*inv;
+				}
+			}
+		});
+
+		std::swap(colour, filtered);
+	}
+
+	double * data = image.data();
+	for (size_t i = 0; i < n; i++) {
+		for (int c = 0; c < 3; c++) {
+			data[3*i + c] = colour.c[c][i];
+		}
+	}
+}
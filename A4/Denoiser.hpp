@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Image.hpp"
+
+// Per-pixel features written by A4_Render alongside colour.  Pixels whose primary
+// ray missed the scene have depth -1 and a zero normal; their albedo is the
+// background colour.
+struct FeatureBuffers {
+	FeatureBuffers(uint width, uint height)
+		: albedo(width, height),
+		  normal(width, height),
+		  depth(width, height)
+	{ }
+
+	Image albedo;
+	Image normal;
+	Image depth; // distance from the eye, in component 0
+};
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010).  Each pass is a 5x5
+// B3-spline kernel with holes, weighted by colour, normal, albedo and depth
+// similarity, so noise is smoothed within a surface but not across edges.
+// Runs `iterations` passes with doubling step size, in place on `image`.
+void denoise(Image & image, const FeatureBuffers & features, uint iterations = 5);
@@ -0,0 +1,208 @@
+#include "FrameHistory.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+//---------------------------------------------------------------------------------------
+FrameHistory::FrameHistory()
+	: m_valid(false),
+	  m_stride(0)
+{
+	m_view.width = 0;
+	m_view.height = 0;
+	m_view.fovy = 0;
+}
+
+//---------------------------------------------------------------------------------------
+// Same walk as the tracer: the outermost GeometryNode with a material wins.
+void FrameHistory::flatten(SceneNode * node, const rmat4 & parent, Material * material, uint64_t path)
+{
+	rmat4 trans = parent * node->get_transform();
+	path = instancePath(path, node);
+
+	if (node->m_nodeType == NodeType::GeometryNode) {
+		GeometryNode * geometryNode = static_cast<GeometryNode *>(node);
+		if (material == nullptr) {
+			material = geometryNode->m_material;
+		}
+
+		Instance instance;
+		instance.key = path;
+		instance.node = geometryNode;
+		instance.primitive = geometryNode->m_primitive;
+		instance.trans = trans;
+		instance.invtrans = glm::inverse(trans);
+		instance.material = material;
+		m_instances.push_back(instance);
+	}
+
+	for (SceneNode * child : node->children) {
+		flatten(child, trans, material, path);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+bool FrameHistory::sameView(const View & a, const View & b)
+{
+	if (a.width != b.width || a.height != b.height || a.eye != b.eye || a.view != b.view ||
+		a.up != b.up || a.fovy != b.fovy || a.ambient != b.ambient ||
+		a.lights.size() != b.lights.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.lights.size(); i++) {
+		const Light & l = a.lights[i];
+		const Light & m = b.lights[i];
+		if (l.colour != m.colour || l.position != m.position || l.falloff[0] != m.falloff[0] ||
+			l.falloff[1] != m.falloff[1] || l.falloff[2] != m.falloff[2]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void FrameHistory::beginFrame(SceneNode * root, uint width, uint height,
+	const glm::vec3 & eye, const glm::vec3 & view, const glm::vec3 & up, double fovy,
+	const glm::vec3 & ambient, const std::list<Light *> & lights)
+{
+	View current;
+	current.width = width;
+	current.height = height;
+	current.eye = eye;
+	current.view = view;
+	current.up = up;
+	current.fovy = fovy;
+	current.ambient = ambient;
+	for (const Light * light : lights) {
+		current.lights.push_back(*light);
+	}
+
+	if (!sameView(current, m_view)) {
+		m_valid = false;
+	}
+	m_view = current;
+
+	std::swap(m_instances, m_prevInstances);
+	m_instances.clear();
+	flatten(root, rmat4(), nullptr, 0);
+
+	m_changedKeys.clear();
+	m_changed.clear();
+
+	std::unordered_map<uint64_t, const Instance *> previous;
+	for (const Instance & instance : m_prevInstances) {
+		previous[instance.key] = &instance;
+	}
+
+	for (const Instance & instance : m_instances) {
+		auto found = previous.find(instance.key);
+		if (found != previous.end()) {
+			const Instance & old = *found->second;
+			previous.erase(found);
+			if (old.trans == instance.trans && old.material == instance.material &&
+				old.primitive == instance.primitive) {
+				continue;
+			}
+		}
+		m_changedKeys.insert(instance.key);
+		m_changed.push_back(&instance);
+	}
+
+	// whatever is left was removed from the scene
+	for (const auto & removed : previous) {
+		m_changedKeys.insert(removed.first);
+	}
+
+	size_t numPixels = (size_t)width*height;
+	m_stride = 1 + lights.size();
+	m_pixels.resize(numPixels);
+	m_touched.assign(numPixels*m_stride, 0);
+}
+
+//---------------------------------------------------------------------------------------
+// Does a changed instance, where it is now, cross the ray with EPSILON <= t < tmax?
+bool FrameHistory::blockedByChange(const Ray & ray, real tmax) const
+{
+	for (const Instance * instance : m_changed) {
+		Ray local = ray.transformed(instance->invtrans);
+		Intersection i = instance->primitive->intersect(&local);
+		if (i._hit && i._t >= EPSILON && i._t < tmax) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------------------
+bool FrameHistory::reuse(uint x, uint y, const Ray & ray, Image & image, FeatureBuffers * features)
+{
+	if (!m_valid) return false;
+
+	size_t p = (size_t)y*m_view.width + x;
+	const Pixel & pixel = m_prevPixels[p];
+	const uint64_t * touched = &m_prevTouched[p*m_stride];
+
+	for (size_t k = 0; k < m_stride; k++) {
+		if (touched[k] != 0 && m_changedKeys.count(touched[k])) return false;
+	}
+
+	if (!m_changed.empty()) {
+		if (blockedByChange(ray, pixel.hit ? pixel.t : std::numeric_limits<real>::infinity())) {
+			return false;
+		}
+
+		// shadow rays exactly as rayColor casts them
+		if (pixel.hit) {
+			for (const Light & light : m_view.lights) {
+				rvec3 shadow_dir = rvec3(light.position) - pixel.point;
+				Ray shadow(pixel.point + real(EPSILON) * shadow_dir, shadow_dir);
+				if (blockedByChange(shadow, 1)) return false;
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		image(x, y, i) = pixel.colour[i];
+		if (features) {
+			features->albedo(x, y, i) = pixel.albedo[i];
+			features->normal(x, y, i) = pixel.normal[i];
+		}
+	}
+	if (features) {
+		features->depth(x, y, 0) = pixel.depth;
+	}
+
+	m_pixels[p] = pixel;
+	std::copy(touched, touched + m_stride, &m_touched[p*m_stride]);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void FrameHistory::record(uint x, uint y, const Intersection & primary, const std::vector<uint64_t> & touched,
+	const Image & image, const FeatureBuffers * features)
+{
+	size_t p = (size_t)y*m_view.width + x;
+	Pixel & pixel = m_pixels[p];
+
+	for (int i = 0; i < 3; i++) {
+		pixel.colour[i] = image(x, y, i);
+		pixel.albedo[i] = features ? features->albedo(x, y, i) : 0;
+		pixel.normal[i] = features ? features->normal(x, y, i) : 0;
+	}
+	pixel.depth = features ? features->depth(x, y, 0) : 0;
+	pixel.hit = primary._hit;
+	pixel.t = primary._t;
+	pixel.point = primary._point;
+
+	size_t n = std::min(touched.size(), m_stride);
+	std::copy(touched.begin(), touched.begin() + n, &m_touched[p*m_stride]);
+}
+
+//---------------------------------------------------------------------------------------
+void FrameHistory::endFrame()
+{
+	std::swap(m_pixels, m_prevPixels);
+	std::swap(m_touched, m_prevTouched);
+	m_valid = true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <list>
+#include <unordered_set>
+#include <vector>
+
+#include "A4.hpp"
+#include "GeometryNode.hpp"
+
+// Carries pixels over between the frames of an animation.
+//
+// Each traced pixel records its colour, its primary hit and the instances its rays
+// hit (the visible surface and each light's occluder).  When the next frame starts
+// the scene is diffed against the previous one.  A pixel is copied instead of
+// traced if none of its recorded instances changed, and if no changed instance,
+// at its new pose, now blocks its primary ray or any of its shadow rays.
+//
+// Any change to the camera, image size, ambient or lights retraces everything:
+// every primary ray moves with the camera, so there is nothing to reuse.
+class FrameHistory {
+public:
+	FrameHistory();
+
+	// Diffs the frame about to be rendered against the last one.
+	void beginFrame(SceneNode * root, uint width, uint height,
+		const glm::vec3 & eye, const glm::vec3 & view, const glm::vec3 & up, double fovy,
+		const glm::vec3 & ambient, const std::list<Light *> & lights);
+
+	// Copies pixel (x, y) from the previous frame into image (and features) if it
+	// cannot have changed.  ray is the pixel's primary ray in this frame.
+	bool reuse(uint x, uint y, const Ray & ray, Image & image, FeatureBuffers * features);
+
+	// Remembers a pixel that was traced this frame.
+	void record(uint x, uint y, const Intersection & primary, const std::vector<uint64_t> & touched,
+		const Image & image, const FeatureBuffers * features);
+
+	// The frame just rendered becomes the previous frame.
+	void endFrame();
+
+private:
+	// A GeometryNode placed in the world by one path from the root.
+	// Only the current frame's nodes are dereferenced, the previous frame's may
+	// belong to a scene snapshot that has been freed since.
+	struct Instance {
+		uint64_t key;
+		GeometryNode * node;
+		Primitive * primitive;
+		rmat4 trans;
+		rmat4 invtrans;
+		Material * material;
+	};
+
+	struct Pixel {
+		glm::vec3 colour;
+		glm::vec3 albedo;
+		glm::vec3 normal;
+		float depth;
+		bool hit;
+		real t;
+		rvec3 point;
+	};
+
+	struct View {
+		uint width;
+		uint height;
+		glm::vec3 eye;
+		glm::vec3 view;
+		glm::vec3 up;
+		double fovy;
+		glm::vec3 ambient;
+		std::vector<Light> lights;
+	};
+
+	void flatten(SceneNode * node, const rmat4 & parent, Material * material, uint64_t path);
+	bool blockedByChange(const Ray & ray, real tmax) const;
+	static bool sameView(const View & a, const View & b);
+
+	bool m_valid; // false until a frame has been recorded with the current view
+	View m_view;
+	size_t m_stride; // touched slots per pixel, primary hit + one occluder per light
+
+	std::vector<Instance> m_instances;
+	std::vector<Instance> m_prevInstances;
+
+	// instances that moved, changed material or were added/removed since last frame
+	std::unordered_set<uint64_t> m_changedKeys;
+	std::vector<const Instance *> m_changed; // current pose of those still present
+
+	std::vector<Pixel> m_pixels;
+	std::vector<Pixel> m_prevPixels;
+	std::vector<uint64_t> m_touched; // m_stride per pixel, 0 = unused
+	std::vector<uint64_t> m_prevTouched;
+};
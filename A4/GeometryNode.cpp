@@ -10,6 +10,12 @@ GeometryNode::GeometryNode(
 	m_nodeType = NodeType::GeometryNode;
 }
 
+//---------------------------------------------------------------------------------------
+SceneNode * GeometryNode::clone() const
+{
+	return new GeometryNode( *this );
+}
+
 void GeometryNode::setMaterial( Material *mat )
 {
 	// Obviously, there's a potential memory leak here.  A good solution
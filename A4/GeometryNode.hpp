@@ -11,6 +11,8 @@ public:
 
 	void setMaterial( Material *material );
 
+	virtual SceneNode * clone() const;
+
 	Material *m_material;
 	Primitive *m_primitive;
 };
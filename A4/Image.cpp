@@ -39,6 +39,17 @@ Image::Image(const Image & other)
   }
 }
 
+//---------------------------------------------------------------------------------------
+Image::Image(Image && other)
+  : m_width(other.m_width),
+    m_height(other.m_height),
+    m_data(other.m_data)
+{
+  other.m_width = 0;
+  other.m_height = 0;
+  other.m_data = 0;
+}
+
 //---------------------------------------------------------------------------------------
 Image::~Image()
 {
@@ -64,6 +75,24 @@ Image & Image::operator=(const Image& other)
   return *this;
 }
 
+//---------------------------------------------------------------------------------------
+Image & Image::operator=(Image && other)
+{
+  if (this != &other) {
+    delete [] m_data;
+
+    m_width = other.m_width;
+    m_height = other.m_height;
+    m_data = other.m_data;
+
+    other.m_width = 0;
+    other.m_height = 0;
+    other.m_data = 0;
+  }
+
+  return *this;
+}
+
 //---------------------------------------------------------------------------------------
 uint Image::width() const
 {
@@ -23,10 +23,14 @@ public:
 	// Copy an image.
 	Image(const Image & other);
 
+	// Take over another image's pixels, leaving it empty.
+	Image(Image && other);
+
 	~Image();
 
 	// Copy the data from one image to another.
 	Image & operator=(const Image & other);
+	Image & operator=(Image && other);
 
 	// Returns the width of the image.
 	uint width() const;
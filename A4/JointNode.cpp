@@ -11,6 +11,11 @@ JointNode::JointNode(const std::string& name)
 JointNode::~JointNode() {
 
 }
+//---------------------------------------------------------------------------------------
+SceneNode * JointNode::clone() const {
+	return new JointNode(*this);
+}
+
  //---------------------------------------------------------------------------------------
 void JointNode::set_joint_x(double min, double init, double max) {
 	m_joint_x.min = min;
@@ -7,6 +7,8 @@ public:
 	JointNode(const std::string & name);
 	virtual ~JointNode();
 
+	virtual SceneNode * clone() const;
+
 	void set_joint_x(double min, double init, double max);
 	void set_joint_y(double min, double init, double max);
 
@@ -5,6 +5,7 @@
 
 // #include "cs488-framework/ObjFileDecoder.hpp"
 #include "Mesh.hpp"
+#include "RayKernels.hpp"
 
 Mesh::Mesh( const std::string& fname)
 	: m_vertices()
@@ -87,73 +88,22 @@ Intersection Mesh::intersect(Ray* ray){
 		if (!bounding_inter._hit) return intersection;
 	}
 
-	for (Triangle face : m_faces ){
-		glm::dvec3 p_0 = m_vertices[face.v1];
-		glm::dvec3 p_1 = m_vertices[face.v2];
-		glm::dvec3 p_2 = m_vertices[face.v3];
-
-		glm::dvec3 a = ray->_orig;
-		glm::dvec3 b_a = ray->_dir;
-
-		//solve for beta, gamma, t using Cramer's rule
-		glm::dvec3 R = a - p_0;
-		double X1 = p_1[0] - p_0[0];
-		double X2 = p_2[0] - p_0[0];
-		double X3 = -b_a[0];
-
-		double Y1 = p_1[1] - p_0[1];
-		double Y2 = p_2[1] - p_0[1];
-		double Y3 = -b_a[1];
-
-		double Z1 = p_1[2] - p_0[2];
-		double Z2 = p_2[2] - p_0[2];
-		double Z3 = -b_a[2];
-
-		glm::mat3 M = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(X3, Y3, Z3));
-		double D = glm::determinant(M);
-
-		glm::mat3 M1 = glm::mat3(glm::vec3(R[0], R[1], R[2]),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(X3, Y3, Z3));
-		double D1 = glm::determinant(M1);
-
-		glm::mat3 M2 = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(R[0], R[1], R[2]),
-								glm::vec3(X3, Y3, Z3));
-		double D2 = glm::determinant(M2);
-
-		glm::mat3 M3 = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(R[0], R[1], R[2]));
-		double D3 = glm::determinant(M3);
-
-		double beta = D1/D;
-		double gamma = D2/D;
-		double t = D3/D;
-
-		//glm::dvec3 i;
-		//my life was saved when i realized this function existed
-		//turns out we are not allowed to use it
-		//bool inter = glm::intersectRayTriangle(a, b_a, p_0, p_1, p_2, i);
-
-		//std::cout << beta << " " << gamma << " " << t << std::endl;
-		if (beta >= 0 && gamma >= 0 && (beta + gamma) <= 1){
-		//if (inter){
-			//std::cout << "t = " << i.z << std::endl;
-			//double t = i.z;
-			if (!intersection._hit || (intersection._hit && t < intersection._t)){ // first intersection || closer intersection
-				intersection._hit = true;
-				intersection._t = t;
-
-				intersection._point = a + t*(b_a);
-				intersection._normal = glm::normalize(glm::cross(p_1 - p_0, p_2 - p_0));
-			}
-		} 
-		
+	for (const Triangle & face : m_faces ){
+		rvec3 p_0 = m_vertices[face.v1];
+		rvec3 p_1 = m_vertices[face.v2];
+		rvec3 p_2 = m_vertices[face.v3];
+
+		real t, beta, gamma;
+		if (!intersectTriangle(*ray, p_0, p_1, p_2, t, beta, gamma)) continue;
+
+		if (!intersection._hit || t < intersection._t){ // first intersection || closer intersection
+			intersection._hit = true;
+			intersection._t = t;
+
+			intersection._point = ray->_orig + t*ray->_dir;
+			intersection._normal = glm::normalize(glm::cross(p_1 - p_0, p_2 - p_0));
+		}
 	}
-	
 
     return intersection;
 }
@@ -162,6 +112,16 @@ Intersection Mesh::intersect_bounding(Ray *ray){
 	return bounding_sphere->intersect(ray);
 }
 
+bool Mesh::tessellate(std::vector<glm::vec3> & triangles){
+	triangles.reserve(triangles.size() + 3*m_faces.size());
+	for (const Triangle & face : m_faces){
+		triangles.push_back(m_vertices[face.v1]);
+		triangles.push_back(m_vertices[face.v2]);
+		triangles.push_back(m_vertices[face.v3]);
+	}
+	return true;
+}
+
 std::ostream& operator<<(std::ostream& out, const Mesh& mesh)
 {
   out << "mesh {";
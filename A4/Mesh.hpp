@@ -27,6 +27,7 @@ public:
   Mesh( const std::string& fname );
   virtual Intersection intersect(Ray* ray);
   virtual Intersection intersect_bounding(Ray* ray);
+  virtual bool tessellate(std::vector<glm::vec3> & triangles);
   
 private:
 	void initBoundingSphere();
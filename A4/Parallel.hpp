@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Runs body(i) for i in [0, count) on numThreads threads (the caller is one of them),
+// handing out indices in order.
+inline void parallelFor(unsigned int numThreads, size_t count,
+	const std::function<void(size_t)> & body)
+{
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++) {
+			body(i);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < numThreads; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread & t : threads) {
+		t.join();
+	}
+}
+
+//---------------------------------------------------------------------------------------
+inline unsigned int renderThreads()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
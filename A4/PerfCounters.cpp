@@ -0,0 +1,321 @@
+#include "PerfCounters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char * phaseNames[(int)PerfPhase::Count] = { "load", "build", "trace", "shade", "encode" };
+
+struct PerfTotals {
+	PerfTotals()
+	{
+		std::fill(values, values + NumPerfEvents, 0);
+	}
+
+	uint64_t values[NumPerfEvents];
+};
+
+static std::mutex perfMutex;
+static std::map<std::pair<int, unsigned>, PerfTotals> perfTotals; // by (phase, thread)
+static uint64_t perfRays = 0;
+static std::string perfError;             // why the counters couldn't be opened
+static bool perfMissing[NumPerfEvents];   // events this machine doesn't count
+
+static std::vector<bool> threadIndexTaken; // by row index, whether a live thread has it
+
+//---------------------------------------------------------------------------------------
+// The calling thread's counters: one group, led by the cycle counter, so all events
+// are scheduled together and IPC is taken over the same intervals.
+struct ThreadCounters {
+	ThreadCounters();
+	~ThreadCounters();
+
+	// Current counts, scaled up if the kernel had to multiplex the group.
+	bool read(uint64_t values[NumPerfEvents]) const;
+
+	unsigned index;
+	int leader;
+	int fds[NumPerfEvents];
+	int slot[NumPerfEvents]; // position in the group's read buffer, -1 if not open
+	int numOpen;
+};
+
+//---------------------------------------------------------------------------------------
+// Rows are per live thread, not per thread ever started: a thread takes the lowest row
+// free and gives it back when it exits, so the short-lived workers parallelFor starts
+// on every call add up in the same few rows.
+static unsigned acquireThreadIndex()
+{
+	std::lock_guard<std::mutex> lock(perfMutex);
+	unsigned index = std::find(threadIndexTaken.begin(), threadIndexTaken.end(), false) - threadIndexTaken.begin();
+	if (index == threadIndexTaken.size()) {
+		threadIndexTaken.push_back(true);
+	} else {
+		threadIndexTaken[index] = true;
+	}
+	return index;
+}
+
+//---------------------------------------------------------------------------------------
+static void releaseThreadIndex(unsigned index)
+{
+	std::lock_guard<std::mutex> lock(perfMutex);
+	threadIndexTaken[index] = false;
+}
+
+//---------------------------------------------------------------------------------------
+static void setError(const std::string & error)
+{
+	std::lock_guard<std::mutex> lock(perfMutex);
+	if (perfError.empty()) perfError = error;
+}
+
+#ifdef __linux__
+
+//---------------------------------------------------------------------------------------
+static int openEvent(uint32_t type, uint64_t config, int groupFd)
+{
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = groupFd == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// this thread only, on whichever cpu it runs
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+//---------------------------------------------------------------------------------------
+ThreadCounters::ThreadCounters()
+	: index(acquireThreadIndex()),
+	  leader(-1),
+	  numOpen(0)
+{
+	static const uint32_t types[NumPerfEvents] = {
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HW_CACHE,
+		PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE
+	};
+	static const uint64_t configs[NumPerfEvents] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// nothing is open yet, the destructor closes only what the loop below opened
+	for (int e = 0; e < NumPerfEvents; e++) {
+		fds[e] = slot[e] = -1;
+	}
+
+	for (int e = 0; e < NumPerfEvents; e++) {
+		fds[e] = openEvent(types[e], configs[e], leader);
+		slot[e] = fds[e] >= 0 ? numOpen++ : -1;
+
+		if (e == PerfCycles && fds[e] < 0) {
+			std::string error = std::string("perf_event_open: ") + std::strerror(errno);
+			if (errno == EACCES || errno == EPERM) {
+				error += " (see /proc/sys/kernel/perf_event_paranoid)";
+			} else if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP || errno == ENOSYS) {
+				error += " (no hardware counters here, VM or container?)";
+			}
+			setError(error);
+			numOpen = 0;
+			return;
+		}
+		if (fds[e] < 0) {
+			std::lock_guard<std::mutex> lock(perfMutex);
+			perfMissing[e] = true;
+		}
+		if (e == PerfCycles) leader = fds[e];
+	}
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+//---------------------------------------------------------------------------------------
+ThreadCounters::~ThreadCounters()
+{
+	for (int e = 0; e < NumPerfEvents; e++) {
+		if (fds[e] >= 0) close(fds[e]);
+	}
+	releaseThreadIndex(index);
+}
+
+//---------------------------------------------------------------------------------------
+bool ThreadCounters::read(uint64_t values[NumPerfEvents]) const
+{
+	if (leader < 0) return false;
+
+	// nr, time enabled, time running, then one value per open event
+	uint64_t buffer[3 + NumPerfEvents];
+	if (::read(leader, buffer, sizeof(buffer)) < (ssize_t)((3 + numOpen)*sizeof(uint64_t))) {
+		return false;
+	}
+
+	double scale = buffer[2] ? (double)buffer[1] / buffer[2] : 0.0;
+	for (int e = 0; e < NumPerfEvents; e++) {
+		values[e] = slot[e] >= 0 ? (uint64_t)(buffer[3 + slot[e]] * scale) : 0;
+	}
+	return true;
+}
+
+#else
+
+//---------------------------------------------------------------------------------------
+ThreadCounters::ThreadCounters()
+	: index(acquireThreadIndex()),
+	  leader(-1),
+	  numOpen(0)
+{
+	setError("hardware counters are only read on Linux");
+}
+
+//---------------------------------------------------------------------------------------
+ThreadCounters::~ThreadCounters()
+{
+	releaseThreadIndex(index);
+}
+
+//---------------------------------------------------------------------------------------
+bool ThreadCounters::read(uint64_t values[NumPerfEvents]) const
+{
+	return false;
+}
+
+#endif
+
+//---------------------------------------------------------------------------------------
+static ThreadCounters & threadCounters()
+{
+	thread_local ThreadCounters counters;
+	return counters;
+}
+
+//---------------------------------------------------------------------------------------
+PerfScope::PerfScope(PerfPhase phase)
+	: m_phase(phase),
+	  m_active(false)
+{
+	if (!PERF_COUNTERS) return;
+
+	m_active = threadCounters().read(m_start);
+}
+
+//---------------------------------------------------------------------------------------
+PerfScope::~PerfScope()
+{
+	stop();
+}
+
+//---------------------------------------------------------------------------------------
+void PerfScope::stop()
+{
+	if (!m_active) return;
+	m_active = false;
+
+	const ThreadCounters & counters = threadCounters();
+	uint64_t end[NumPerfEvents];
+	if (!counters.read(end)) return;
+
+	std::lock_guard<std::mutex> lock(perfMutex);
+	PerfTotals & totals = perfTotals[std::make_pair((int)m_phase, counters.index)];
+	for (int e = 0; e < NumPerfEvents; e++) {
+		// scaling for multiplexing can make a scaled count step backwards
+		totals.values[e] += end[e] > m_start[e] ? end[e] - m_start[e] : 0;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void perfAddRays(uint64_t rays)
+{
+	if (!PERF_COUNTERS) return;
+
+	std::lock_guard<std::mutex> lock(perfMutex);
+	perfRays += rays;
+}
+
+//---------------------------------------------------------------------------------------
+static void printRow(std::ostream & os, const std::string & phase, const std::string & thread,
+	const PerfTotals & totals)
+{
+	os << "\t" << std::left << std::setw(8) << phase << std::setw(8) << thread << std::right;
+	os << std::setw(14) << totals.values[PerfCycles];
+
+	if (perfMissing[PerfInstructions]) {
+		os << std::setw(14) << "n/a" << std::setw(7) << "n/a";
+	} else {
+		double ipc = totals.values[PerfCycles] ? (double)totals.values[PerfInstructions] / totals.values[PerfCycles] : 0.0;
+		os << std::setw(14) << totals.values[PerfInstructions]
+		   << std::setw(7) << std::fixed << std::setprecision(2) << ipc;
+	}
+
+	for (int e = PerfL1Misses; e < NumPerfEvents; e++) {
+		if (perfMissing[e]) {
+			os << std::setw(12) << "n/a";
+		} else if (perfRays) {
+			os << std::setw(12) << std::fixed << std::setprecision(3) << (double)totals.values[e] / perfRays;
+		} else {
+			os << std::setw(12) << totals.values[e];
+		}
+	}
+	os << std::defaultfloat << std::endl;
+}
+
+//---------------------------------------------------------------------------------------
+void perfReport(std::ostream & os)
+{
+	if (!PERF_COUNTERS) return;
+
+	std::lock_guard<std::mutex> lock(perfMutex);
+
+	os << "PerfCounters{" << std::endl;
+	if (perfTotals.empty()) {
+		os << "\tunavailable: " << (perfError.empty() ? "nothing recorded" : perfError) << std::endl;
+		os << "}" << std::endl;
+		return;
+	}
+
+	os << "\trays: " << perfRays << (perfRays ? ", misses per ray" : ", misses") << std::endl;
+	os << "\t" << std::left << std::setw(8) << "phase" << std::setw(8) << "thread" << std::right
+	   << std::setw(14) << "cycles" << std::setw(14) << "instructions" << std::setw(7) << "IPC"
+	   << std::setw(12) << "L1D" << std::setw(12) << "LLC" << std::setw(12) << "branch" << std::endl;
+
+	for (int phase = 0; phase < (int)PerfPhase::Count; phase++) {
+		PerfTotals all;
+		int threads = 0;
+		for (const auto & entry : perfTotals) {
+			if (entry.first.first != phase) continue;
+			printRow(os, phaseNames[phase], std::to_string(entry.first.second), entry.second);
+			for (int e = 0; e < NumPerfEvents; e++) {
+				all.values[e] += entry.second.values[e];
+			}
+			threads++;
+		}
+		if (threads > 1) {
+			printRow(os, phaseNames[phase], "all", all);
+		}
+	}
+	os << "}" << std::endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+// Set to true to sample hardware performance counters (Linux perf_event_open)
+// around the render phases and report them with the render stats
+#define PERF_COUNTERS false
+
+enum class PerfPhase {
+	Load,   // reading meshes
+	Build,  // setting up the rasterizer and frame history
+	Trace,  // primary visibility
+	Shade,  // the pixel loop: shading, shadow rays
+	Encode, // writing PNGs
+	Count
+};
+
+enum PerfEvent {
+	PerfCycles,
+	PerfInstructions,
+	PerfL1Misses,     // L1 data cache read misses
+	PerfLLCMisses,    // last level cache misses
+	PerfBranchMisses,
+	NumPerfEvents
+};
+
+// Counts hardware events on the calling thread from construction to destruction and
+// adds them to the totals for (phase, thread).  Each thread opens its counters the
+// first time it needs them; threads that have exited hand their row in the report on
+// to the next thread started.  If PERF_COUNTERS is off, or the counters can't be opened
+// (not Linux, perf_event_paranoid, containers, VMs without a PMU) it does nothing.
+class PerfScope {
+public:
+	PerfScope(PerfPhase phase);
+	~PerfScope();
+
+	// Stops counting before the end of the scope.
+	void stop();
+
+private:
+	PerfPhase m_phase;
+	bool m_active;
+	uint64_t m_start[NumPerfEvents];
+};
+
+// Rays traced so far, for the per-ray columns of the report.
+void perfAddRays(uint64_t rays);
+
+// Prints the totals recorded so far per phase and thread: IPC, and cache and branch
+// misses per ray.  Prints nothing at all if PERF_COUNTERS is off.
+void perfReport(std::ostream & os);
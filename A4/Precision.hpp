@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Scalar type of the ray tracing core (rays, hits and the primitive kernels).
+// Single precision is the fast path; scenes with very large extents or very thin
+// features can be built with -DA4_DOUBLE_PRECISION (premake4 --double-precision).
+#ifdef A4_DOUBLE_PRECISION
+typedef double real;
+#else
+typedef float real;
+#endif
+
+typedef glm::tvec3<real> rvec3;
+typedef glm::tvec4<real> rvec4;
+typedef glm::tmat3x3<real> rmat3;
+typedef glm::tmat4x4<real> rmat4;
@@ -1,5 +1,5 @@
 #include "Primitive.hpp"
-#include "polyroots.hpp"
+#include "RayKernels.hpp"
 
 Primitive::~Primitive()
 {
@@ -21,6 +21,10 @@ Intersection Sphere::intersect(Ray* ray){
     return _primitive->intersect(ray);
 }
 
+bool Sphere::tessellate(std::vector<glm::vec3> & triangles){
+    return _primitive->tessellate(triangles);
+}
+
 Cube::Cube(){
     _primitive = new NonhierBox(glm::vec3(0,0,0), 1.0);
 }
@@ -37,68 +41,57 @@ Intersection Cube::intersect(Ray* ray){
     return _primitive->intersect(ray);
 }
 
+bool Cube::tessellate(std::vector<glm::vec3> & triangles){
+    return _primitive->tessellate(triangles);
+}
+
 
 NonhierSphere::~NonhierSphere()
 {
 }
 
+//the sphere is bounded by its axis aligned box, covered pixels get the exact test
+bool NonhierSphere::tessellate(std::vector<glm::vec3> & triangles){
+    glm::vec3 r(m_radius);
+    glm::vec3 lo = glm::vec3(m_pos) - r;
+    glm::vec3 hi = glm::vec3(m_pos) + r;
+    glm::vec3 c[8] = {
+        glm::vec3(lo.x, lo.y, lo.z), glm::vec3(hi.x, lo.y, lo.z),
+        glm::vec3(hi.x, hi.y, lo.z), glm::vec3(lo.x, hi.y, lo.z),
+        glm::vec3(lo.x, lo.y, hi.z), glm::vec3(hi.x, lo.y, hi.z),
+        glm::vec3(hi.x, hi.y, hi.z), glm::vec3(lo.x, hi.y, hi.z)
+    };
+    static const int faces[36] = {
+        0, 2, 1,  0, 3, 2,
+        4, 5, 6,  4, 6, 7,
+        0, 1, 5,  0, 5, 4,
+        3, 6, 2,  3, 7, 6,
+        0, 4, 7,  0, 7, 3,
+        1, 2, 6,  1, 6, 5
+    };
+    for (int i = 0; i < 36; i++){
+        triangles.push_back(c[faces[i]]);
+    }
+    return false;
+}
+
 Intersection NonhierSphere::intersect_bounding(Ray *ray){
 	return intersect(ray);
 }
 
 //(P-c)(P-c) = R^2
 //where P = a + t(b-a) = origin + t(direction)
-//(a + t(d))(a + t(d)) - R^2 = 0
-//d*d*t^2 + d*(a-c)*2*t + (a-c)*(a-c) - R^2 = 0;
-//d = ray._dir; a = ray._orig; c = m_pos, R = m_radius
 Intersection NonhierSphere::intersect(Ray* ray){
     Intersection intersection;
 
-    //from notes
-    glm::vec3 a_c = ray->_orig - m_pos;
-    double B = 2*glm::dot(ray->_dir, a_c);
-    double A = glm::dot(ray->_dir, ray->_dir);
-    double C = glm::dot(a_c, a_c) - m_radius*m_radius;
-
-    double roots[2];
-    int n = quadraticRoots(A, B, C, roots);
-    double t = -1;
-    
-    switch (n) {
-        case 2:
-            t = std::min(roots[0], roots[1]);
-            if (t < 0) 
-                t = std::max(roots[0], roots[1]);
-            if (t < 0){
-                intersection._hit = false;
-                return intersection;
-            } else {
-                intersection._hit = true;
-                intersection._t = t;
-            }
-        break;
-        case 1:
-            t = roots[0];
-            if (t < 0){
-                intersection._hit = false;
-                return intersection;
-            } else {
-                intersection._hit = true;
-                intersection._t = t;
-            }
-        break;
-        default:
-            intersection._hit = false;
-            return intersection;
+    real t;
+    if (!intersectSphere(*ray, m_pos, m_radius, t)){
+        return intersection;
     }
 
-    //t * ray->_dir because you can't multiply double and vec3....
-    glm::vec3 t_dir;
-    t_dir[0] = t * ray->_dir[0];
-    t_dir[1] = t * ray->_dir[1];
-    t_dir[2] = t * ray->_dir[2];
-
-    intersection._point = ray->_orig + t_dir;
+    intersection._hit = true;
+    intersection._t = t;
+    intersection._point = ray->_orig + t*ray->_dir;
     intersection._normal = glm::normalize(intersection._point - m_pos);
 
     return intersection;
@@ -123,22 +116,29 @@ NonhierBox::NonhierBox(const glm::vec3& pos, double size)
         x + l, y + l, z + l
     };
 
-    for (int i = 0; i < 24; i++){
-        m_cube[i] = tempcube[i];
+    for (int i = 0; i < 8; i++){
+        m_corners[i] = rvec3(tempcube[3*i], tempcube[3*i + 1], tempcube[3*i + 2]);
     }
 
-    m_vertices.emplace_back(5, 6, 2);
-    m_vertices.emplace_back(6, 7, 3);
-    m_vertices.emplace_back(7, 8, 4);
-    m_vertices.emplace_back(5, 1, 8);
-    m_vertices.emplace_back(1, 2, 3);
-    m_vertices.emplace_back(8, 7, 6);
-    m_vertices.emplace_back(1, 5, 2);
-    m_vertices.emplace_back(2, 6, 3);
-    m_vertices.emplace_back(3, 7, 4);
-    m_vertices.emplace_back(8, 1, 4);
-    m_vertices.emplace_back(4, 1, 3);
-    m_vertices.emplace_back(5, 8, 6);
+    //corner indices of each face, counting from 1 like an obj file
+    int faces[36] = {
+        5, 6, 2,
+        6, 7, 3,
+        7, 8, 4,
+        5, 1, 8,
+        1, 2, 3,
+        8, 7, 6,
+        1, 5, 2,
+        2, 6, 3,
+        3, 7, 4,
+        8, 1, 4,
+        4, 1, 3,
+        5, 8, 6
+    };
+
+    for (int i = 0; i < 36; i += 3){
+        m_triangles.emplace_back(faces[i] - 1, faces[i + 1] - 1, faces[i + 2] - 1);
+    }
 
   }
 
@@ -146,6 +146,16 @@ NonhierBox::~NonhierBox()
 {
 }
 
+//same triangles (and winding) as intersect() walks
+bool NonhierBox::tessellate(std::vector<glm::vec3> & triangles){
+    for (const glm::ivec3 & triangle : m_triangles){
+        for (int k = 0; k < 3; k++){
+            triangles.push_back(glm::vec3(m_corners[triangle[k]]));
+        }
+    }
+    return true;
+}
+
 Intersection NonhierBox::intersect_bounding(Ray *ray){
 	return intersect(ray);
 }
@@ -153,77 +163,20 @@ Intersection NonhierBox::intersect_bounding(Ray *ray){
 Intersection NonhierBox::intersect(Ray* ray){
     Intersection intersection;
 
-    std::vector<glm::vec3>::iterator it;
-
-    for (it = m_vertices.begin(); it != m_vertices.end(); ++it){
-        glm::vec3 triangle = *it;
-        int i0 = (triangle[0] - 1)*3;
-        int i1 = (triangle[1] - 1)*3;
-        int i2 = (triangle[2] - 1)*3;
-
-        glm::dvec3 p_0 = glm::dvec3(m_cube[i0], m_cube[i0 + 1], m_cube[i0 + 2]);
-        glm::dvec3 p_1 = glm::dvec3(m_cube[i1], m_cube[i1 + 1], m_cube[i1 + 2]);
-        glm::dvec3 p_2 = glm::dvec3(m_cube[i2], m_cube[i2 + 1], m_cube[i2 + 2]);
-
-        glm::dvec3 a = ray->_orig;
-		glm::dvec3 b_a = ray->_dir;
-
-        glm::dvec3 R = a - p_0;
-		double X1 = p_1[0] - p_0[0];
-		double X2 = p_2[0] - p_0[0];
-		double X3 = -b_a[0];
-
-		double Y1 = p_1[1] - p_0[1];
-		double Y2 = p_2[1] - p_0[1];
-		double Y3 = -b_a[1];
-
-		double Z1 = p_1[2] - p_0[2];
-		double Z2 = p_2[2] - p_0[2];
-		double Z3 = -b_a[2];
-
-		glm::mat3 M = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(X3, Y3, Z3));
-		double D = glm::determinant(M);
-
-		glm::mat3 M1 = glm::mat3(glm::vec3(R[0], R[1], R[2]),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(X3, Y3, Z3));
-		double D1 = glm::determinant(M1);
-
-		glm::mat3 M2 = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(R[0], R[1], R[2]),
-								glm::vec3(X3, Y3, Z3));
-		double D2 = glm::determinant(M2);
-
-		glm::mat3 M3 = glm::mat3(glm::vec3(X1, Y1, Z1),
-								glm::vec3(X2, Y2, Z2),
-								glm::vec3(R[0], R[1], R[2]));
-		double D3 = glm::determinant(M3);
-
-		double beta = D1/D;
-		double gamma = D2/D;
-		double t = D3/D;
-
-		//glm::dvec3 i;
-		//my life was saved when i realized this function existed
-		//turns out we are not allowed to use it
-		//bool inter = glm::intersectRayTriangle(a, b_a, p_0, p_1, p_2, i);
-
-		//std::cout << beta << " " << gamma << " " << t << std::endl;
-		if (beta >= 0 && gamma >= 0 && (beta + gamma) <= 1){
-		//if (inter){
-			//std::cout << "t = " << i.z << std::endl;
-			//double t = i.z;
-			if (!intersection._hit || (intersection._hit && t < intersection._t)){ // first intersection || closer intersection
-				intersection._hit = true;
-				intersection._t = t;
-
-                intersection._point = a + t*(b_a);
-				intersection._normal = glm::normalize(glm::cross(p_1 - p_0, p_2 - p_0));
-			}
-		} 
-		
+    for (const glm::ivec3 & triangle : m_triangles){
+        const rvec3 & p_0 = m_corners[triangle[0]];
+        const rvec3 & p_1 = m_corners[triangle[1]];
+        const rvec3 & p_2 = m_corners[triangle[2]];
+
+        real t, beta, gamma;
+        if (!intersectTriangle(*ray, p_0, p_1, p_2, t, beta, gamma)) continue;
+
+        if (!intersection._hit || t < intersection._t){ // first intersection || closer intersection
+            intersection._hit = true;
+            intersection._t = t;
+            intersection._point = ray->_orig + t*ray->_dir;
+            intersection._normal = glm::normalize(glm::cross(p_1 - p_0, p_2 - p_0));
+        }
     }
 
     return intersection;
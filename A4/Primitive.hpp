@@ -9,6 +9,11 @@ public:
   virtual ~Primitive();
   virtual Intersection intersect(Ray* ray) = 0;
   virtual Intersection intersect_bounding(Ray* ray) = 0;
+
+  // Appends the primitive's surface as model-space triangles (3 vertices each).
+  // Returns false if the triangles are only a bounding hull, in which case every
+  // pixel they cover has to be refined with intersect().
+  virtual bool tessellate(std::vector<glm::vec3> & triangles) = 0;
 };
 
 class Sphere : public Primitive {
@@ -17,6 +22,7 @@ public:
   virtual ~Sphere();
   virtual Intersection intersect(Ray* ray);
   virtual Intersection intersect_bounding(Ray* ray);
+  virtual bool tessellate(std::vector<glm::vec3> & triangles);
 private:
   Primitive* _primitive;
 };
@@ -27,6 +33,7 @@ public:
   virtual ~Cube();
   virtual Intersection intersect(Ray* ray);
   virtual Intersection intersect_bounding(Ray* ray);
+  virtual bool tessellate(std::vector<glm::vec3> & triangles);
 private:
   Primitive* _primitive;
 };
@@ -40,11 +47,11 @@ public:
   virtual ~NonhierSphere();
   virtual Intersection intersect(Ray* ray);
   virtual Intersection intersect_bounding(Ray* ray);
-
+  virtual bool tessellate(std::vector<glm::vec3> & triangles);
 
 private:
-  glm::vec3 m_pos;
-  double m_radius;
+  rvec3 m_pos;
+  real m_radius;
 };
 
 class NonhierBox : public Primitive {
@@ -54,10 +61,11 @@ public:
   virtual ~NonhierBox();
   virtual Intersection intersect(Ray* ray);
   virtual Intersection intersect_bounding(Ray* ray);
+  virtual bool tessellate(std::vector<glm::vec3> & triangles);
 
 private:
   glm::vec3 m_pos;
-  double m_cube [24];
-  std::vector<glm::vec3> m_vertices;
+  rvec3 m_corners [8];
+  std::vector<glm::ivec3> m_triangles; // into m_corners
   double m_size;
 };
@@ -0,0 +1,258 @@
+#include "Rasterizer.hpp"
+#include "Parallel.hpp"
+#include "PerfCounters.hpp"
+
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// rows per bin, each bin is rasterized by a single thread
+#define RASTER_BAND 16
+
+//---------------------------------------------------------------------------------------
+Rasterizer::Rasterizer(SceneNode * root, uint width, uint height,
+	const glm::vec3 & eye, const glm::mat4 & to_world)
+	: m_width(width),
+	  m_height(height),
+	  m_eye(eye),
+	  m_toWorld(to_world)
+{
+	// p_world - eye = x*col0 + y*col1 + (col3 - eye)
+	glm::dmat3 pixelToDir = glm::dmat3(glm::dvec3(to_world[0]), glm::dvec3(to_world[1]),
+		glm::dvec3(to_world[3]) - glm::dvec3(eye));
+	m_project = glm::inverse(pixelToDir);
+
+	flatten(root, rmat4(), nullptr, 0);
+}
+
+//---------------------------------------------------------------------------------------
+// Collects every GeometryNode with its accumulated transform.  Materials resolve the
+// same way as in intersect(): the outermost GeometryNode with a material wins.
+void Rasterizer::flatten(SceneNode * node, const rmat4 & parent, Material * material, uint64_t path)
+{
+	rmat4 trans = parent * node->get_transform();
+	path = instancePath(path, node);
+
+	if (node->m_nodeType == NodeType::GeometryNode) {
+		GeometryNode * geometryNode = static_cast<GeometryNode *>(node);
+		if (material == nullptr) {
+			material = geometryNode->m_material;
+		}
+
+		Item item;
+		item.node = geometryNode;
+		item.trans = trans;
+		item.invtrans = glm::inverse(trans);
+		item.material = material;
+		item.instance = path;
+		item.exact = geometryNode->m_primitive->tessellate(item.triangles);
+		if (!item.triangles.empty()) {
+			m_items.push_back(item);
+		}
+	}
+
+	for (SceneNode * child : node->children) {
+		flatten(child, trans, material, path);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Transforms an item's triangles into (x*t, y*t, t) space, clips them against the
+// t = EPSILON plane (the tracer ignores closer hits) and divides through.
+void Rasterizer::project(uint id, std::vector<ScreenTriangle> & out) const
+{
+	const Item & item = m_items[id];
+	glm::dvec3 eye(m_eye);
+
+	for (size_t tri = 0; 3*tri + 2 < item.triangles.size(); tri++) {
+		glm::dvec3 in[3];
+		int behind = 0;
+		for (int k = 0; k < 3; k++) {
+			glm::dvec3 p(item.trans * rvec4(rvec3(item.triangles[3*tri + k]), 1));
+			in[k] = m_project * (p - eye);
+			if (in[k].z < EPSILON) behind++;
+		}
+		if (behind == 3) continue;
+
+		// Sutherland-Hodgman against t >= EPSILON, at most 4 vertices come out
+		glm::dvec3 poly[4];
+		int n = 0;
+		for (int k = 0; k < 3; k++) {
+			const glm::dvec3 & a = in[k];
+			const glm::dvec3 & b = in[(k + 1) % 3];
+			bool aIn = a.z >= EPSILON;
+			bool bIn = b.z >= EPSILON;
+			if (aIn) poly[n++] = a;
+			if (aIn != bIn) {
+				double s = (EPSILON - a.z) / (b.z - a.z);
+				poly[n++] = a + s*(b - a);
+			}
+		}
+
+		for (int k = 0; k < n; k++) {
+			poly[k] = glm::dvec3(poly[k].x / poly[k].z, poly[k].y / poly[k].z, 1.0 / poly[k].z);
+		}
+
+		for (int k = 1; k + 1 < n; k++) {
+			ScreenTriangle st;
+			st.p[0] = poly[0];
+			st.p[1] = poly[k];
+			st.p[2] = poly[k + 1];
+			st.item = id;
+			st.tri = tri;
+			out.push_back(st);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+Ray Rasterizer::pixelRay(uint x, uint y) const
+{
+	glm::vec3 p_world = glm::vec3(m_toWorld * glm::vec4(x, y, 0, 1));
+	return Ray(rvec3(m_eye), rvec3(p_world - m_eye));
+}
+
+//---------------------------------------------------------------------------------------
+// Rasterizes one triangle into rows [y0, y1), sampling at integer pixel coordinates
+// (that is where A4_Render shoots its rays).
+void Rasterizer::rasterize(const ScreenTriangle & tri, int y0, int y1)
+{
+	const glm::dvec3 & a = tri.p[0];
+	const glm::dvec3 & b = tri.p[1];
+	const glm::dvec3 & c = tri.p[2];
+
+	double area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1e-12) return;
+	double sign = area < 0 ? -1.0 : 1.0;
+
+	int minX = std::max(0, (int)std::ceil(std::min(a.x, std::min(b.x, c.x))));
+	int maxX = std::min((int)m_width - 1, (int)std::floor(std::max(a.x, std::max(b.x, c.x))));
+	int minY = std::max(y0, (int)std::ceil(std::min(a.y, std::min(b.y, c.y))));
+	int maxY = std::min(y1 - 1, (int)std::floor(std::max(a.y, std::max(b.y, c.y))));
+
+	const Item & item = m_items[tri.item];
+
+	for (int y = minY; y <= maxY; y++) {
+		for (int x = minX; x <= maxX; x++) {
+			double w0 = sign*((c.x - b.x)*(y - b.y) - (c.y - b.y)*(x - b.x));
+			double w1 = sign*((a.x - c.x)*(y - c.y) - (a.y - c.y)*(x - c.x));
+			double w2 = sign*((b.x - a.x)*(y - a.y) - (b.y - a.y)*(x - a.x));
+			if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+
+			size_t pixel = (size_t)y*m_width + x;
+			Sample & sample = m_samples[pixel];
+
+			if (item.exact) {
+				double t = std::abs(area) / (w0*a.z + w1*b.z + w2*c.z);
+				if (t < sample.t) {
+					sample.t = t;
+					sample.item = tri.item;
+					sample.tri = tri.tri;
+				}
+			} else if (m_refined[pixel] != (int)tri.item) {
+				m_refined[pixel] = tri.item;
+
+				Ray local = pixelRay(x, y).transformed(item.invtrans);
+				Intersection i = item.node->m_primitive->intersect(&local);
+				if (i._hit && i._t >= EPSILON && i._t < sample.t) {
+					sample.t = i._t;
+					sample.item = tri.item;
+					sample.tri = -1;
+				}
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Rasterizer::render(uint numThreads)
+{
+	Sample empty;
+	empty.t = std::numeric_limits<double>::infinity();
+	empty.item = -1;
+	empty.tri = -1;
+	m_samples.assign((size_t)m_width*m_height, empty);
+	m_refined.assign((size_t)m_width*m_height, -1);
+
+	std::vector<std::vector<ScreenTriangle>> projected(m_items.size());
+	parallelFor(numThreads, m_items.size(), [&](size_t i) {
+		PerfScope trace(PerfPhase::Trace);
+		project(i, projected[i]);
+	});
+
+	m_triangles.clear();
+	for (const std::vector<ScreenTriangle> & tris : projected) {
+		m_triangles.insert(m_triangles.end(), tris.begin(), tris.end());
+	}
+
+	// bin by row band, in item order so that the result doesn't depend on threading
+	size_t numBands = (m_height + RASTER_BAND - 1) / RASTER_BAND;
+	std::vector<std::vector<uint>> bins(numBands);
+	for (uint i = 0; i < m_triangles.size(); i++) {
+		const ScreenTriangle & tri = m_triangles[i];
+		double lo = std::min(tri.p[0].y, std::min(tri.p[1].y, tri.p[2].y));
+		double hi = std::max(tri.p[0].y, std::max(tri.p[1].y, tri.p[2].y));
+		if (hi < 0 || lo > m_height - 1) continue;
+
+		size_t first = (size_t)std::max(0.0, std::ceil(lo)) / RASTER_BAND;
+		size_t last = (size_t)std::min((double)m_height - 1, std::floor(hi)) / RASTER_BAND;
+		for (size_t b = first; b <= last; b++) {
+			bins[b].push_back(i);
+		}
+	}
+
+	parallelFor(numThreads, numBands, [&](size_t b) {
+		PerfScope trace(PerfPhase::Trace);
+		int y0 = b*RASTER_BAND;
+		int y1 = std::min((int)m_height, y0 + RASTER_BAND);
+		for (uint i : bins[b]) {
+			rasterize(m_triangles[i], y0, y1);
+		}
+	});
+}
+
+//---------------------------------------------------------------------------------------
+Intersection Rasterizer::intersect(uint x, uint y, const Ray & ray) const
+{
+	Intersection intersection;
+	const Sample & sample = m_samples[(size_t)y*m_width + x];
+	if (sample.item < 0) return intersection;
+
+	const Item & item = m_items[sample.item];
+	Ray local = ray.transformed(item.invtrans);
+
+	if (item.exact) {
+		rvec3 p_0 = item.triangles[3*sample.tri];
+		rvec3 p_1 = item.triangles[3*sample.tri + 1];
+		rvec3 p_2 = item.triangles[3*sample.tri + 2];
+		const rvec3 & a = local._orig;
+		const rvec3 & b_a = local._dir;
+
+		// plane hit of the visible triangle, same t the tracer's Cramer solve gives
+		rvec3 n = glm::cross(p_1 - p_0, p_2 - p_0);
+		real denom = glm::dot(n, b_a);
+		real t = denom != 0 ? glm::dot(n, p_0 - a) / denom : real(sample.t);
+
+		intersection._hit = true;
+		intersection._t = t;
+		intersection._point = a + t*b_a;
+		intersection._normal = glm::normalize(n);
+	} else {
+		intersection = item.node->m_primitive->intersect(&local);
+		if (!intersection._hit) return Intersection();
+	}
+
+	intersection.transform(item.trans, item.invtrans);
+	intersection._material = item.material;
+	intersection._instance = item.instance;
+
+	return intersection;
+}
+
+//---------------------------------------------------------------------------------------
+size_t Rasterizer::numTriangles() const
+{
+	return m_triangles.size();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "SceneNode.hpp"
+#include "GeometryNode.hpp"
+
+typedef unsigned int uint;
+
+// Finds first hit visibility for the primary rays of A4_Render by rasterizing the
+// tessellated scene instead of tracing every pixel through the SceneNode tree.
+//
+// Primitives that tessellate exactly (meshes, boxes) are z-buffered directly.
+// Everything else (spheres) is rasterized as a bounding hull and each covered pixel
+// is refined with the primitive's own intersect().  The result is a visibility
+// buffer of (primitive, t) per pixel; intersect() turns one entry back into the
+// Intersection the ray tracer would have produced.
+class Rasterizer {
+public:
+	// to_world maps pixel coordinates (x, y, 0, 1) onto the image plane, exactly as
+	// A4_Render builds its primary rays.
+	Rasterizer(SceneNode * root, uint width, uint height,
+		const glm::vec3 & eye, const glm::mat4 & to_world);
+
+	// Fills the visibility buffer using numThreads workers.
+	void render(uint numThreads);
+
+	// First hit of the primary ray through pixel (x, y).
+	Intersection intersect(uint x, uint y, const Ray & ray) const;
+
+	size_t numTriangles() const;
+
+private:
+	// A GeometryNode flattened into world space.
+	struct Item {
+		GeometryNode * node;
+		rmat4 trans;
+		rmat4 invtrans;
+		Material * material;
+		uint64_t instance;
+		bool exact;
+		std::vector<glm::vec3> triangles;
+	};
+
+	// A (possibly near-clipped piece of a) triangle in pixel coordinates.
+	// z holds 1/t so it can be interpolated linearly across the screen.
+	struct ScreenTriangle {
+		glm::dvec3 p[3];
+		uint item;
+		uint tri;
+	};
+
+	struct Sample {
+		double t;
+		int item;
+		int tri;
+	};
+
+	void flatten(SceneNode * node, const rmat4 & parent, Material * material, uint64_t path);
+	void project(uint item, std::vector<ScreenTriangle> & out) const;
+	void rasterize(const ScreenTriangle & tri, int y0, int y1);
+	Ray pixelRay(uint x, uint y) const;
+
+	uint m_width;
+	uint m_height;
+	glm::vec3 m_eye;
+	glm::mat4 m_toWorld;
+
+	// world point - eye  ->  (x*t, y*t, t) for the pixel (x, y) whose ray hits it at t
+	glm::dmat3 m_project;
+
+	std::vector<Item> m_items;
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<Sample> m_samples;
+	std::vector<int> m_refined;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
+
+#include "SceneNode.hpp"
+
+// Ray-primitive kernels shared by the primitives, written once for any scalar type.
+// Everything inside a kernel stays in T, there are no round trips through double.
+
+// Ray-triangle intersection using Cramer's rule from the notes:
+//   a - p_0 = beta(p_1 - p_0) + gamma(p_2 - p_0) - t(b - a)
+// The 3x3 determinants are written as scalar triple products.  Rays (nearly)
+// parallel to the triangle's plane are rejected relative to the operands' size so
+// the test behaves the same in float and double.
+template <typename T>
+inline bool intersectTriangle(const TRay<T> & ray, const glm::tvec3<T> & p_0,
+	const glm::tvec3<T> & p_1, const glm::tvec3<T> & p_2, T & t, T & beta, T & gamma)
+{
+	glm::tvec3<T> e_1 = p_1 - p_0;
+	glm::tvec3<T> e_2 = p_2 - p_0;
+	glm::tvec3<T> R = ray._orig - p_0;
+
+	glm::tvec3<T> e_2xd = glm::cross(e_2, -ray._dir);
+	T D = glm::dot(e_1, e_2xd);
+
+	T scale = glm::length(e_1) * glm::length(e_2) * glm::length(ray._dir);
+	if (std::abs(D) <= std::numeric_limits<T>::epsilon() * scale) return false;
+
+	T invD = T(1) / D;
+	beta = glm::dot(R, e_2xd) * invD;
+	if (beta < 0 || beta > 1) return false;
+
+	gamma = glm::dot(e_1, glm::cross(R, -ray._dir)) * invD;
+	if (gamma < 0 || beta + gamma > 1) return false;
+
+	t = glm::dot(e_1, glm::cross(e_2, R)) * invD;
+	return true;
+}
+
+// Ray-sphere intersection, (a + t d - c).(a + t d - c) = r^2.  Returns the nearest
+// t >= 0 (the far root when the origin is inside).  The discriminant is computed
+// from the ray's closest approach to the centre instead of B^2 - 4AC, which loses
+// everything to cancellation in float once the sphere is far away.
+template <typename T>
+inline bool intersectSphere(const TRay<T> & ray, const glm::tvec3<T> & centre, T radius, T & t)
+{
+	glm::tvec3<T> a_c = ray._orig - centre;
+	T A = glm::dot(ray._dir, ray._dir);
+	T B = glm::dot(ray._dir, a_c); // half of the usual B
+	T C = glm::dot(a_c, a_c) - radius*radius;
+	if (A == 0) return false;
+
+	glm::tvec3<T> closest = a_c - (B / A) * ray._dir;
+	T D = A * (radius*radius - glm::dot(closest, closest));
+	if (D < 0) return false;
+
+	T q = -(B + std::copysign(std::sqrt(D), B));
+	T t_0 = q / A;
+	T t_1 = q != 0 ? C / q : t_0;
+
+	t = std::min(t_0, t_1);
+	if (t < 0) t = std::max(t_0, t_1);
+	return t >= 0;
+}
@@ -0,0 +1,148 @@
+#include "RenderQueue.hpp"
+#include "Denoiser.hpp"
+#include "A4.hpp"
+#include "PerfCounters.hpp"
+
+#include <list>
+
+// Set to true to run the edge-aware denoiser on every image before it is saved
+#define DENOISE_RENDER false
+
+// Set to true to copy pixels that cannot have changed from the previous frame
+// (see FrameHistory), for animations where most of the scene holds still
+#define TEMPORAL_REUSE false
+
+//---------------------------------------------------------------------------------------
+RenderJob::RenderJob()
+	: root(nullptr),
+	  width(0),
+	  height(0),
+	  fovy(0),
+	  done(false)
+{ }
+
+//---------------------------------------------------------------------------------------
+void RenderJob::trace(FrameHistory * history)
+{
+	std::list<Light *> lightList;
+	for (Light & light : lights) {
+		lightList.push_back(&light);
+	}
+
+	image = Image(width, height);
+	FeatureBuffers features( DENOISE_RENDER ? width : 0, DENOISE_RENDER ? height : 0 );
+	A4_Render(root, image, eye, view, up, fovy, ambient, lightList,
+		DENOISE_RENDER ? &features : nullptr, TEMPORAL_REUSE ? history : nullptr);
+	if (DENOISE_RENDER) {
+		denoise(image, features);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void RenderJob::save()
+{
+	PerfScope encode(PerfPhase::Encode);
+	image.savePng(filename);
+}
+
+//---------------------------------------------------------------------------------------
+RenderQueue::RenderQueue(size_t maxPending)
+	: m_maxPending(maxPending),
+	  m_pending(0),
+	  m_quit(false)
+{
+	m_tracer = std::thread(&RenderQueue::traceLoop, this);
+	m_encoder = std::thread(&RenderQueue::encodeLoop, this);
+}
+
+//---------------------------------------------------------------------------------------
+RenderQueue::~RenderQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_changed.notify_all();
+
+	// both loops drain their queues before returning
+	m_tracer.join();
+	m_encoder.join();
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::submit(const std::shared_ptr<RenderJob> & job)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [&] { return m_pending < m_maxPending; });
+
+	m_pending++;
+	m_toTrace.push_back(job);
+	m_changed.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::wait(const RenderJob & job)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [&] { return job.done; });
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::waitAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [&] { return m_pending == 0; });
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::traceLoop()
+{
+	for (;;) {
+		std::shared_ptr<RenderJob> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [&] { return m_quit || !m_toTrace.empty(); });
+			if (m_toTrace.empty()) {
+				// m_quit, tell the encoder nothing else is coming
+				m_toEncode.push_back(nullptr);
+				m_changed.notify_all();
+				return;
+			}
+			job = m_toTrace.front();
+			m_toTrace.pop_front();
+		}
+
+		job->trace(&m_history);
+
+		// the scene copy isn't needed for encoding
+		job->snapshot.reset();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_toEncode.push_back(job);
+		m_changed.notify_all();
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::encodeLoop()
+{
+	for (;;) {
+		std::shared_ptr<RenderJob> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [&] { return !m_toEncode.empty(); });
+			job = m_toEncode.front();
+			m_toEncode.pop_front();
+		}
+
+		if (!job) return;
+
+		job->save();
+		job->image = Image();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job->done = true;
+		m_pending--;
+		m_changed.notify_all();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SceneNode.hpp"
+#include "Light.hpp"
+#include "Image.hpp"
+#include "FrameHistory.hpp"
+
+// Everything gr.render needs to produce one PNG.
+struct RenderJob {
+	RenderJob();
+
+	// Traces (and optionally denoises) the frame into image.  history holds the
+	// previous frame of the same sequence, unchanged pixels are copied from it.
+	void trace(FrameHistory * history = nullptr);
+
+	// Encodes image to filename.
+	void save();
+
+	SceneNode * root;
+
+	// Set for queued jobs: a copy of the scene taken when the job was submitted,
+	// root points at it so the script can keep changing its nodes.
+	std::unique_ptr<SceneNode> snapshot;
+
+	std::string filename;
+	uint width;
+	uint height;
+	glm::vec3 eye;
+	glm::vec3 view;
+	glm::vec3 up;
+	double fovy;
+	glm::vec3 ambient;
+	std::vector<Light> lights;
+
+	Image image;
+	bool done; // guarded by the RenderQueue's mutex
+};
+
+// Renders frames on background threads, in submission order.  One thread traces,
+// a second encodes the PNGs so that writing frame N overlaps tracing frame N+1.
+class RenderQueue {
+public:
+	// submit() blocks while maxPending frames are unfinished, which bounds the memory
+	// held by snapshots and images when the script runs far ahead.
+	RenderQueue(size_t maxPending);
+
+	// Finishes every queued frame.
+	~RenderQueue();
+
+	void submit(const std::shared_ptr<RenderJob> & job);
+
+	// Blocks until job's PNG has been written.
+	void wait(const RenderJob & job);
+	void waitAll();
+
+private:
+	void traceLoop();
+	void encodeLoop();
+
+	size_t m_maxPending;
+	size_t m_pending;
+	bool m_quit;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::deque<std::shared_ptr<RenderJob>> m_toTrace;
+	std::deque<std::shared_ptr<RenderJob>> m_toEncode;
+
+	// frames are traced in order on one thread, so they form one sequence
+	FrameHistory m_history;
+
+	std::thread m_tracer;
+	std::thread m_encoder;
+};
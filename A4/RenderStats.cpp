@@ -0,0 +1,18 @@
+#include "RenderStats.hpp"
+
+//---------------------------------------------------------------------------------------
+std::ostream & operator << (std::ostream & os, const RenderStats & stats)
+{
+	// as a fraction of the rays that were blocked, unblocked rays can never hit
+	double hitRate = stats.shadowOccluded ? 100.0 * stats.shadowCacheHits / stats.shadowOccluded : 0.0;
+
+	os << "RenderStats{" << std::endl;
+	os << "\tshadow rays: " << stats.shadowRays << ", occluded: " << stats.shadowOccluded << std::endl;
+	os << "\tshadow cache hits: " << stats.shadowCacheHits << " (" << hitRate << "% of occluded)" << std::endl;
+	os << "\tshadow traversals: " << stats.shadowTraversals
+	   << ", nodes visited: " << stats.shadowNodesVisited << std::endl;
+	os << "\tpixels reused from the previous frame: " << stats.pixelsReused << std::endl;
+	os << "}";
+
+	return os;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+// Counters collected while shading.  Shading runs on one thread with its own
+// TraceContext, so nothing here needs to be atomic.
+struct RenderStats {
+	RenderStats()
+		: shadowRays(0),
+		  shadowOccluded(0),
+		  shadowCacheHits(0),
+		  shadowTraversals(0),
+		  shadowNodesVisited(0),
+		  pixelsReused(0)
+	{ }
+
+	uint64_t shadowRays;
+	uint64_t shadowOccluded;
+	uint64_t shadowCacheHits;     // shadow rays stopped by the cached last occluder
+	uint64_t shadowTraversals;    // shadow rays that had to walk the scene graph
+	uint64_t shadowNodesVisited;  // scene nodes visited by those walks
+	uint64_t pixelsReused;        // copied from the previous frame instead of traced
+};
+
+std::ostream & operator << (std::ostream & os, const RenderStats & stats);
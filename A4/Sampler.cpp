@@ -0,0 +1,65 @@
+#include "Sampler.hpp"
+
+//---------------------------------------------------------------------------------------
+// "lowbias32" integer hash (C. Wellons)
+static uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+//---------------------------------------------------------------------------------------
+static uint32_t hash(uint32_t a, uint32_t b)
+{
+	return hash(a ^ (hash(b) + 0x9e3779b9u + (a << 6) + (a >> 2)));
+}
+
+//---------------------------------------------------------------------------------------
+static uint32_t hash(uint32_t a, uint32_t b, uint32_t c)
+{
+	return hash(hash(a, b), c);
+}
+
+//---------------------------------------------------------------------------------------
+// top 24 bits to a float in [0, 1), exact
+static float toUnit(uint32_t x)
+{
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+//---------------------------------------------------------------------------------------
+Sampler::Sampler(uint32_t seed)
+	: m_seed(seed)
+{ }
+
+//---------------------------------------------------------------------------------------
+float Sampler::get(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension) const
+{
+	return toUnit(hash(hash(m_seed, x, y), index, dimension));
+}
+
+//---------------------------------------------------------------------------------------
+PixelSampler::PixelSampler(const Sampler & sampler, uint32_t x, uint32_t y, uint32_t index)
+	: m_sampler(sampler),
+	  m_x(x),
+	  m_y(y),
+	  m_index(index),
+	  m_dimension(0)
+{ }
+
+//---------------------------------------------------------------------------------------
+float PixelSampler::get1D()
+{
+	return m_sampler.get(m_x, m_y, m_index, m_dimension++);
+}
+
+//---------------------------------------------------------------------------------------
+glm::vec2 PixelSampler::get2D()
+{
+	float u = get1D();
+	return glm::vec2(u, get1D());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Deterministic random numbers for the renderer: a counter-based hash, so every value
+// is a pure function of (pixel, sample index, dimension, seed) and images don't depend
+// on how pixels are split between threads or in which order they are traced.
+class Sampler {
+public:
+	Sampler(uint32_t seed = 0);
+
+	// Value of the given dimension of sample `index` at pixel (x, y), in [0, 1).
+	float get(uint32_t x, uint32_t y, uint32_t index, uint32_t dimension) const;
+
+private:
+	uint32_t m_seed;
+};
+
+// The samples of one pixel, handing out consecutive dimensions.
+class PixelSampler {
+public:
+	PixelSampler(const Sampler & sampler, uint32_t x, uint32_t y, uint32_t index = 0);
+
+	float get1D();
+	glm::vec2 get2D();
+
+private:
+	const Sampler & m_sampler;
+	uint32_t m_x;
+	uint32_t m_y;
+	uint32_t m_index;
+	uint32_t m_dimension;
+};
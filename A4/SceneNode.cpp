@@ -21,8 +21,8 @@ unsigned int SceneNode::nodeInstanceCount = 0;
 SceneNode::SceneNode(const std::string& name)
   : m_name(name),
 	m_nodeType(NodeType::SceneNode),
-	trans(mat4()),
-	invtrans(mat4()),
+	trans(rmat4()),
+	invtrans(rmat4()),
 	m_nodeId(nodeInstanceCount++)
 {
 
@@ -34,13 +34,19 @@ SceneNode::SceneNode(const SceneNode & other)
 	: m_nodeType(other.m_nodeType),
 	  m_name(other.m_name),
 	  trans(other.trans),
-	  invtrans(other.invtrans)
+	  invtrans(other.invtrans),
+	  m_nodeId(other.m_nodeId)
 {
 	for(SceneNode * child : other.children) {
-		this->children.push_front(new SceneNode(*child));
+		this->children.push_back(child->clone());
 	}
 }
 
+//---------------------------------------------------------------------------------------
+SceneNode * SceneNode::clone() const {
+	return new SceneNode(*this);
+}
+
 //---------------------------------------------------------------------------------------
 SceneNode::~SceneNode() {
 	for(SceneNode * child : children) {
@@ -49,18 +55,18 @@ SceneNode::~SceneNode() {
 }
 
 //---------------------------------------------------------------------------------------
-void SceneNode::set_transform(const glm::mat4& m) {
+void SceneNode::set_transform(const rmat4& m) {
 	trans = m;
 	invtrans = glm::inverse(m);
 }
 
 //---------------------------------------------------------------------------------------
-const glm::mat4& SceneNode::get_transform() const {
+const rmat4& SceneNode::get_transform() const {
 	return trans;
 }
 
 //---------------------------------------------------------------------------------------
-const glm::mat4& SceneNode::get_inverse() const {
+const rmat4& SceneNode::get_inverse() const {
 	return invtrans;
 }
 
@@ -92,17 +98,17 @@ void SceneNode::rotate(char axis, float angle) {
 			break;
 	}
 	mat4 rot_matrix = glm::rotate(degreesToRadians(angle), rot_axis);
-	set_transform( rot_matrix * trans );
+	set_transform( rmat4(rot_matrix) * trans );
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::scale(const glm::vec3 & amount) {
-	set_transform( glm::scale(amount) * trans );
+	set_transform( rmat4(glm::scale(amount)) * trans );
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::translate(const glm::vec3& amount) {
-	set_transform( glm::translate(amount) * trans );
+	set_transform( rmat4(glm::translate(amount)) * trans );
 }
 
 
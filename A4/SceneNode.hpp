@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Material.hpp"
+#include "Precision.hpp"
 
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <limits>
 #include <list>
 #include <string>
 #include <iostream>
@@ -14,25 +17,42 @@ enum class NodeType {
 	JointNode
 };
 
-class Ray {
+template <typename T>
+class TRay {
 public:
-	glm::vec3 _dir;
-	glm::vec3 _orig;
-	Ray(glm::vec3 orig, glm::vec3 dir) : _orig(orig), _dir(dir) { }
-	Ray() : _orig(glm::vec3()), _dir(glm::vec3()){ }
+	glm::tvec3<T> _dir;
+	glm::tvec3<T> _orig;
+	TRay(glm::tvec3<T> orig, glm::tvec3<T> dir) : _orig(orig), _dir(dir) { }
+	TRay() : _orig(glm::tvec3<T>()), _dir(glm::tvec3<T>()){ }
+
+	//the same ray in the space m maps into, t is preserved
+	TRay transformed(const glm::tmat4x4<T> & m) const {
+		return TRay(glm::tvec3<T>(m * glm::tvec4<T>(_orig, 1)), glm::tvec3<T>(m * glm::tvec4<T>(_dir, 0)));
+	}
 };
 
-class Intersection {
+template <typename T>
+class TIntersection {
 public:
-	glm::vec3 _point;
-	glm::vec3 _normal;
+	glm::tvec3<T> _point;
+	glm::tvec3<T> _normal;
 	Material *_material;
-	double _t;
+	T _t;
 	bool _hit;
-	Intersection() : _hit(false), _t(std::numeric_limits<double>::infinity()){ }
+	uint64_t _instance; // instancePath of the GeometryNode that was hit
+	TIntersection() : _material(nullptr), _hit(false), _t(std::numeric_limits<T>::infinity()), _instance(0){ }
+
+	//moves the hit point and normal into the space m maps into, inv is m's inverse
+	void transform(const glm::tmat4x4<T> & m, const glm::tmat4x4<T> & inv) {
+		_point = glm::tvec3<T>(m * glm::tvec4<T>(_point, 1));
+		_normal = glm::normalize(glm::transpose(glm::tmat3x3<T>(inv)) * _normal);
+	}
 
 };
 
+typedef TRay<real> Ray;
+typedef TIntersection<real> Intersection;
+
 class SceneNode {
 public:
     SceneNode(const std::string & name);
@@ -40,13 +60,17 @@ public:
 	SceneNode(const SceneNode & other);
 
     virtual ~SceneNode();
+
+	// Copies this node and its subtree.  Primitives and materials are shared with
+	// the original, only the nodes themselves (transforms, structure) are copied.
+	virtual SceneNode * clone() const;
     
 	int totalSceneNodes() const;
     
-    const glm::mat4& get_transform() const;
-    const glm::mat4& get_inverse() const;
+    const rmat4& get_transform() const;
+    const rmat4& get_inverse() const;
     
-    void set_transform(const glm::mat4& m);
+    void set_transform(const rmat4& m);
     
     void add_child(SceneNode* child);
     
@@ -60,9 +84,9 @@ public:
 
 	friend std::ostream & operator << (std::ostream & os, const SceneNode & node);
 
-    // Transformations
-    glm::mat4 trans;
-    glm::mat4 invtrans;
+    // Transformations, in the tracer's precision so the inverse is too
+    rmat4 trans;
+    rmat4 invtrans;
     
     std::list<SceneNode*> children;
 
@@ -0,0 +1,505 @@
+// Microbenchmarks for the ray-primitive kernels and the polynomial root solvers.
+//
+// Each kernel is timed on randomized ray sets (mostly hits, mostly misses, and
+// rays grazing the surface) and checked against a straightforward long double
+// reference, so a rewrite of a kernel can be validated as well as timed:
+//
+//   ./A4-bench [mesh.obj]      (from Assets, like A4)
+//
+// Everything is seeded, runs are repeatable.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "A4.hpp"
+#include "Primitive.hpp"
+#include "Mesh.hpp"
+#include "polyroots.hpp"
+
+typedef long double ldouble;
+typedef glm::tvec3<ldouble> lvec3;
+
+// minimum time spent timing each case
+#define BENCH_MIN_MS 200
+
+// relative size of the jitter around the surface for grazing rays
+#define GRAZE_EPSILON 1e-4
+
+static std::mt19937 rng(488);
+
+//---------------------------------------------------------------------------------------
+static double uniform(double lo, double hi)
+{
+	return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+//---------------------------------------------------------------------------------------
+static glm::dvec3 randomDirection()
+{
+	for (;;) {
+		glm::dvec3 v(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+		double l = glm::length(v);
+		if (l > 1e-3 && l <= 1) return v / l;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Runs body(i) over [0, count) until BENCH_MIN_MS have passed, returns ns per call.
+static double nsPerCall(size_t count, const std::function<void(size_t)> & body)
+{
+	typedef std::chrono::steady_clock clock;
+
+	size_t calls = 0;
+	auto start = clock::now();
+	std::chrono::nanoseconds elapsed(0);
+	do {
+		for (size_t i = 0; i < count; i++) {
+			body(i);
+		}
+		calls += count;
+		elapsed = clock::now() - start;
+	} while (elapsed < std::chrono::milliseconds(BENCH_MIN_MS));
+
+	return (double)elapsed.count() / calls;
+}
+
+//---------------------------------------------------------------------------------------
+// Ray tests
+//---------------------------------------------------------------------------------------
+
+// Returns the nearest t >= 0 along (orig, dir).
+typedef std::function<bool(const lvec3 & orig, const lvec3 & dir, ldouble & t)> Reference;
+
+// Picks the point a ray from the given origin is aimed at.
+typedef std::function<glm::dvec3(const glm::dvec3 & orig)> Target;
+
+struct RaySet {
+	std::string name;
+	std::vector<Ray> rays;
+};
+
+//---------------------------------------------------------------------------------------
+// Rays start on a sphere 4x the object's bound and are left unnormalized, like the
+// renderer's primary rays.
+static RaySet makeRays(const std::string & name, size_t count,
+	const glm::dvec3 & centre, double radius, const Target & target)
+{
+	RaySet set;
+	set.name = name;
+	for (size_t i = 0; i < count; i++) {
+		glm::dvec3 orig = centre + 4*radius*randomDirection();
+		set.rays.emplace_back(rvec3(orig), rvec3(target(orig) - orig));
+	}
+	return set;
+}
+
+//---------------------------------------------------------------------------------------
+// A point beside the centre, in the plane facing orig, placed so the line from
+// orig passes at exactly `distance` from the centre.
+static glm::dvec3 beside(const glm::dvec3 & orig, const glm::dvec3 & centre, double distance)
+{
+	glm::dvec3 axis = centre - orig;
+	double L = glm::length(axis);
+	glm::dvec3 u;
+	do {
+		u = randomDirection();
+		u -= glm::dot(u, axis) / (L*L) * axis;
+	} while (glm::length(u) < 1e-3);
+
+	double offset = distance * L / std::sqrt(L*L - distance*distance);
+	return centre + offset * glm::normalize(u);
+}
+
+//---------------------------------------------------------------------------------------
+static void benchPrimitive(const std::string & name, Primitive & primitive,
+	const std::vector<RaySet> & sets, const Reference & reference)
+{
+	std::cout << name << std::endl;
+
+	for (const RaySet & set : sets) {
+		const std::vector<Ray> & rays = set.rays;
+
+		size_t agree = 0, hits = 0, refHits = 0;
+		double maxError = 0;
+		for (const Ray & ray : rays) {
+			Ray r = ray;
+			Intersection inter = primitive.intersect(&r);
+
+			ldouble t = 0;
+			bool refHit = reference(lvec3(ray._orig), lvec3(ray._dir), t);
+
+			hits += inter._hit;
+			refHits += refHit;
+			if (inter._hit == refHit) agree++;
+			if (inter._hit && refHit) {
+				maxError = std::max(maxError, (double)(std::abs(inter._t - t) / std::max(t, ldouble(1e-30))));
+			}
+		}
+
+		volatile real sink = 0;
+		double ns = nsPerCall(rays.size(), [&](size_t i) {
+			Ray r = rays[i];
+			Intersection inter = primitive.intersect(&r);
+			if (inter._hit) sink = sink + inter._t;
+		});
+
+		std::cout << "  " << std::left << std::setw(8) << set.name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << ns << " ns/ray"
+			<< "   hits " << std::setw(5) << 100.0*hits/rays.size() << "%"
+			<< " (ref " << std::setw(5) << 100.0*refHits/rays.size() << "%)"
+			<< "   agree " << std::setprecision(2) << std::setw(6) << 100.0*agree/rays.size() << "%"
+			<< "   max rel t error " << std::scientific << std::setprecision(1) << maxError
+			<< std::defaultfloat << std::endl;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+static bool referenceSphere(const lvec3 & centre, ldouble radius,
+	const lvec3 & orig, const lvec3 & dir, ldouble & t)
+{
+	lvec3 oc = orig - centre;
+	ldouble A = glm::dot(dir, dir);
+	ldouble B = 2*glm::dot(dir, oc);
+	ldouble C = glm::dot(oc, oc) - radius*radius;
+	ldouble D = B*B - 4*A*C;
+	if (D < 0) return false;
+
+	ldouble t_0 = (-B - std::sqrt(D)) / (2*A);
+	ldouble t_1 = (-B + std::sqrt(D)) / (2*A);
+	t = t_0 >= 0 ? t_0 : t_1;
+	return t >= 0;
+}
+
+//---------------------------------------------------------------------------------------
+static bool referenceBox(const lvec3 & lo, const lvec3 & hi,
+	const lvec3 & orig, const lvec3 & dir, ldouble & t)
+{
+	ldouble t_near = -INFINITY, t_far = INFINITY;
+	for (int k = 0; k < 3; k++) {
+		if (dir[k] == 0) {
+			if (orig[k] < lo[k] || orig[k] > hi[k]) return false;
+			continue;
+		}
+		ldouble t_0 = (lo[k] - orig[k]) / dir[k];
+		ldouble t_1 = (hi[k] - orig[k]) / dir[k];
+		t_near = std::max(t_near, std::min(t_0, t_1));
+		t_far = std::min(t_far, std::max(t_0, t_1));
+	}
+	if (t_near > t_far || t_far < 0) return false;
+
+	t = t_near >= 0 ? t_near : t_far;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Moller-Trumbore over every triangle, no bounding volume.
+static bool referenceMesh(const std::vector<lvec3> & vertices, const std::vector<glm::ivec3> & faces,
+	const lvec3 & orig, const lvec3 & dir, ldouble & t)
+{
+	bool hit = false;
+	for (const glm::ivec3 & f : faces) {
+		lvec3 e_1 = vertices[f[1]] - vertices[f[0]];
+		lvec3 e_2 = vertices[f[2]] - vertices[f[0]];
+		lvec3 p = glm::cross(dir, e_2);
+		ldouble det = glm::dot(e_1, p);
+		if (det == 0) continue;
+
+		lvec3 s = orig - vertices[f[0]];
+		ldouble u = glm::dot(s, p) / det;
+		if (u < 0 || u > 1) continue;
+
+		lvec3 q = glm::cross(s, e_1);
+		ldouble v = glm::dot(dir, q) / det;
+		if (v < 0 || u + v > 1) continue;
+
+		ldouble t_f = glm::dot(e_2, q) / det;
+		if (t_f >= 0 && (!hit || t_f < t)) {
+			hit = true;
+			t = t_f;
+		}
+	}
+	return hit;
+}
+
+//---------------------------------------------------------------------------------------
+static void benchSphere()
+{
+	glm::dvec3 centre(0.5, -2, 7);
+	double radius = 3;
+	NonhierSphere sphere(centre, radius);
+
+	std::vector<RaySet> sets;
+	sets.push_back(makeRays("hit", 4096, centre, radius, [&](const glm::dvec3 &) {
+		return centre + 0.9*radius*std::cbrt(uniform(0, 1))*randomDirection();
+	}));
+	sets.push_back(makeRays("miss", 4096, centre, radius, [&](const glm::dvec3 & orig) {
+		return beside(orig, centre, radius*uniform(1.2, 3));
+	}));
+	sets.push_back(makeRays("grazing", 4096, centre, radius, [&](const glm::dvec3 & orig) {
+		return beside(orig, centre, radius*(1 + uniform(-GRAZE_EPSILON, GRAZE_EPSILON)));
+	}));
+
+	lvec3 c(centre);
+	benchPrimitive("NonhierSphere::intersect", sphere, sets,
+		[&](const lvec3 & orig, const lvec3 & dir, ldouble & t) {
+			return referenceSphere(c, radius, orig, dir, t);
+		});
+}
+
+//---------------------------------------------------------------------------------------
+static void benchBox()
+{
+	glm::dvec3 pos(-1, 2, -5);
+	double size = 2.5;
+	NonhierBox box(pos, size);
+
+	glm::dvec3 centre = pos + glm::dvec3(size/2);
+	double radius = size*std::sqrt(3.0)/2;
+
+	std::vector<RaySet> sets;
+	sets.push_back(makeRays("hit", 4096, centre, radius, [&](const glm::dvec3 &) {
+		return centre + 0.45*size*glm::dvec3(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+	}));
+	sets.push_back(makeRays("miss", 4096, centre, radius, [&](const glm::dvec3 & orig) {
+		return beside(orig, centre, radius*uniform(1.2, 3));
+	}));
+	sets.push_back(makeRays("grazing", 4096, centre, radius, [&](const glm::dvec3 &) {
+		// a point on a random edge, pushed slightly off it
+		glm::dvec3 p(std::uniform_int_distribution<int>(0, 1)(rng),
+			std::uniform_int_distribution<int>(0, 1)(rng),
+			std::uniform_int_distribution<int>(0, 1)(rng));
+		p[std::uniform_int_distribution<int>(0, 2)(rng)] = uniform(0, 1);
+		return pos + size*p + GRAZE_EPSILON*size*randomDirection();
+	}));
+
+	lvec3 lo(pos), hi(pos + glm::dvec3(size));
+	benchPrimitive("NonhierBox::intersect", box, sets,
+		[&](const lvec3 & orig, const lvec3 & dir, ldouble & t) {
+			return referenceBox(lo, hi, orig, dir, t);
+		});
+}
+
+//---------------------------------------------------------------------------------------
+static void benchMesh(const std::string & filename)
+{
+	// read the same v/f records Mesh does, for the reference and the ray targets
+	std::vector<glm::dvec3> vertices;
+	std::vector<glm::ivec3> faces;
+	{
+		std::ifstream ifs(filename.c_str());
+		std::string code;
+		while (ifs >> code) {
+			if (code == "v") {
+				glm::dvec3 v;
+				ifs >> v.x >> v.y >> v.z;
+				vertices.push_back(v);
+			} else if (code == "f") {
+				glm::ivec3 f;
+				ifs >> f.x >> f.y >> f.z;
+				faces.push_back(f - glm::ivec3(1));
+			}
+		}
+	}
+	if (faces.empty()) {
+		std::cout << "Mesh::intersect: no faces in " << filename << ", skipped" << std::endl;
+		return;
+	}
+
+	Mesh mesh(filename);
+
+	glm::dvec3 lo = vertices[0], hi = vertices[0];
+	for (const glm::dvec3 & v : vertices) {
+		lo = glm::min(lo, v);
+		hi = glm::max(hi, v);
+	}
+	glm::dvec3 centre = (lo + hi) / 2.0;
+	double radius = 0;
+	for (const glm::dvec3 & v : vertices) {
+		radius = std::max(radius, glm::length(v - centre));
+	}
+
+	std::uniform_int_distribution<size_t> anyFace(0, faces.size() - 1);
+	auto onFace = [&](const glm::ivec3 & f, double beta, double gamma) {
+		return vertices[f[0]] + beta*(vertices[f[1]] - vertices[f[0]]) + gamma*(vertices[f[2]] - vertices[f[0]]);
+	};
+
+	// the reference is brute force, keep the sets small
+	std::vector<RaySet> sets;
+	sets.push_back(makeRays("hit", 512, centre, radius, [&](const glm::dvec3 &) {
+		double beta = uniform(0, 1), gamma = uniform(0, 1);
+		if (beta + gamma > 1) {
+			beta = 1 - beta;
+			gamma = 1 - gamma;
+		}
+		return onFace(faces[anyFace(rng)], beta, gamma);
+	}));
+	sets.push_back(makeRays("miss", 512, centre, radius, [&](const glm::dvec3 & orig) {
+		return beside(orig, centre, radius*uniform(1.2, 3));
+	}));
+	sets.push_back(makeRays("grazing", 512, centre, radius, [&](const glm::dvec3 &) {
+		// a point on a random edge, pushed slightly off it
+		double s = uniform(0, 1);
+		return onFace(faces[anyFace(rng)], s, 0) + GRAZE_EPSILON*radius*randomDirection();
+	}));
+
+	std::vector<lvec3> lvertices(vertices.begin(), vertices.end());
+	benchPrimitive("Mesh::intersect (" + filename + ", " + std::to_string(faces.size()) + " faces)",
+		mesh, sets,
+		[&](const lvec3 & orig, const lvec3 & dir, ldouble & t) {
+			return referenceMesh(lvertices, faces, orig, dir, t);
+		});
+}
+
+//---------------------------------------------------------------------------------------
+// Root solvers
+//---------------------------------------------------------------------------------------
+
+// A polynomial built from known roots, coefficients as the solver takes them.
+struct Polynomial {
+	double coefficients[4];
+	std::vector<double> realRoots;
+};
+
+//---------------------------------------------------------------------------------------
+// Multiplies out prod(x - r_i) * (x^2 + p x + q)^pairs, monic, highest power first.
+static std::vector<ldouble> expand(const std::vector<double> & roots, int pairs, double p, double q)
+{
+	std::vector<ldouble> poly(1, 1);
+	auto multiply = [&](const std::vector<ldouble> & factor) {
+		std::vector<ldouble> product(poly.size() + factor.size() - 1, 0);
+		for (size_t i = 0; i < poly.size(); i++) {
+			for (size_t j = 0; j < factor.size(); j++) {
+				product[i + j] += poly[i] * factor[j];
+			}
+		}
+		poly = product;
+	};
+	for (double r : roots) multiply({ 1, -r });
+	for (int i = 0; i < pairs; i++) multiply({ 1, p, q });
+	return poly;
+}
+
+//---------------------------------------------------------------------------------------
+// degree 2..4, `kind` is "separated", "clustered" (all real roots within 1e-3 of
+// each other) or "complex" (one conjugate pair, the rest real).
+static Polynomial makePolynomial(int degree, const std::string & kind)
+{
+	std::vector<double> roots;
+	int pairs = 0;
+	double p = 0, q = 0;
+
+	if (kind == "complex") {
+		pairs = 1;
+		double re = uniform(-5, 5), im = uniform(0.1, 5);
+		p = -2*re;
+		q = re*re + im*im;
+	}
+
+	double base = uniform(-10, 10);
+	for (int i = 0; i < degree - 2*pairs; i++) {
+		roots.push_back(kind == "clustered" ? base + uniform(-5e-4, 5e-4) : uniform(-10, 10));
+	}
+
+	std::vector<ldouble> poly = expand(roots, pairs, p, q);
+
+	Polynomial polynomial;
+	if (degree == 2) {
+		// quadraticRoots takes A x^2 + B x + C, scale it to check that too
+		double A = uniform(0.1, 10);
+		for (int i = 0; i < 3; i++) polynomial.coefficients[i] = (double)(A * poly[i]);
+	} else {
+		// cubicRoots and quarticRoots take the monic polynomial without its leading 1
+		for (int i = 0; i < degree; i++) polynomial.coefficients[i] = (double)poly[i + 1];
+	}
+	std::sort(roots.begin(), roots.end());
+	polynomial.realRoots = roots;
+	return polynomial;
+}
+
+//---------------------------------------------------------------------------------------
+static size_t solve(int degree, const double * c, double * roots)
+{
+	switch (degree) {
+		case 2: return quadraticRoots(c[0], c[1], c[2], roots);
+		case 3: return cubicRoots(c[0], c[1], c[2], roots);
+		default: return quarticRoots(c[0], c[1], c[2], c[3], roots);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+static void benchRoots(int degree, const std::string & name)
+{
+	std::cout << name << std::endl;
+
+	const char * kinds[3] = { "separated", "clustered", "complex" };
+	for (const char * kind : kinds) {
+		std::vector<Polynomial> polys;
+		for (int i = 0; i < 4096; i++) {
+			polys.push_back(makePolynomial(degree, kind));
+		}
+
+		// count agreement, and the distance from each true root to the nearest
+		// one found, relative to the root's size
+		size_t countAgree = 0;
+		double maxError = 0;
+		for (const Polynomial & poly : polys) {
+			double roots[4];
+			size_t n = solve(degree, poly.coefficients, roots);
+			if (n == poly.realRoots.size()) countAgree++;
+			if (n == 0) continue;
+
+			for (double r : poly.realRoots) {
+				double nearest = INFINITY;
+				for (size_t i = 0; i < n; i++) {
+					nearest = std::min(nearest, std::abs(roots[i] - r));
+				}
+				maxError = std::max(maxError, nearest / std::max(1.0, std::abs(r)));
+			}
+		}
+
+		volatile double sink = 0;
+		double ns = nsPerCall(polys.size(), [&](size_t i) {
+			double roots[4];
+			sink = sink + solve(degree, polys[i].coefficients, roots);
+		});
+
+		std::cout << "  " << std::left << std::setw(10) << kind << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << ns << " ns/call"
+			<< "   root count agrees " << std::setprecision(2) << std::setw(6) << 100.0*countAgree/polys.size() << "%"
+			<< "   max rel root error " << std::scientific << std::setprecision(1) << maxError
+			<< std::defaultfloat << std::endl;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+int main(int argc, char ** argv)
+{
+	std::string mesh = "cow.obj";
+	if (argc >= 2) {
+		mesh = argv[1];
+	}
+
+	std::cout << "real is " << (sizeof(real) == sizeof(double) ? "double" : "float")
+		<< ", reference is long double" << std::endl << std::endl;
+
+	benchSphere();
+	benchBox();
+	benchMesh(mesh);
+	std::cout << std::endl;
+
+	benchRoots(2, "quadraticRoots");
+	benchRoots(3, "cubicRoots");
+	benchRoots(4, "quarticRoots");
+}
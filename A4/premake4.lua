@@ -48,6 +48,11 @@ end
 
 buildOptions = {"-std=c++11"}
 
+newoption {
+    trigger = "double-precision",
+    description = "Trace rays in double instead of single precision"
+}
+
 solution "CS488-Projects"
     configurations { "Debug", "Release" }
 
@@ -64,6 +69,30 @@ solution "CS488-Projects"
         includedirs (includeDirList)
         files { "*.cpp" }
 
+        if _OPTIONS["double-precision"] then
+            defines { "A4_DOUBLE_PRECISION" }
+        end
+
+    -- kernel and root solver microbenchmarks, see bench/Bench.cpp
+    project "A4-bench"
+        kind "ConsoleApp"
+        language "C++"
+        location "build"
+        objdir "build/bench"
+        targetdir "."
+        buildoptions (buildOptions)
+        libdirs (libDirectories)
+        links (linkLibs)
+        linkoptions (linkOptionList)
+        includedirs (includeDirList)
+        includedirs { "." }
+        files { "*.cpp", "bench/*.cpp" }
+        excludes { "Main.cpp" }
+
+        if _OPTIONS["double-precision"] then
+            defines { "A4_DOUBLE_PRECISION" }
+        end
+
     configuration "Debug"
         defines { "DEBUG" }
         flags { "Symbols" }
@@ -71,3 +100,6 @@ solution "CS488-Projects"
     configuration "Release"
         defines { "NDEBUG" }
         flags { "Optimize" }
+        -- GCC 12+ at -O2 only vectorises loops whose trip count is known, this lets
+        -- the denoiser's row loops vectorise too
+        buildoptions { "-ftree-vectorize" }
@@ -54,10 +54,22 @@
 #include "Material.hpp"
 #include "PhongMaterial.hpp"
 #include "A4.hpp"
+#include "RenderQueue.hpp"
+#include "PerfCounters.hpp"
+
+// How many gr.render_async frames may be queued or in flight before the script
+// is made to wait.  Each one holds a copy of the scene graph and an image.
+#define MAX_QUEUED_FRAMES 4
 
 typedef std::map<std::string,Mesh*> MeshMap;
 static MeshMap mesh_map;
 
+// Created by the first gr.render_async call, finished when the script ends.
+static RenderQueue* render_queue = 0;
+
+// Previous gr.render frame, for reusing unchanged pixels.
+static FrameHistory render_history;
+
 // Uncomment the following line to enable debugging messages
 // #define GRLUA_ENABLE_DEBUG
 
@@ -100,6 +112,13 @@ struct gr_light_ud {
   Light* light;
 };
 
+// The "userdata" type for a frame queued with gr.render_async. The
+// job is shared with the render queue, which may finish it after Lua
+// has dropped the handle.
+struct gr_job_ud {
+  std::shared_ptr<RenderJob>* job;
+};
+
 // Useful function to retrieve and check an n-tuple of numbers.
 template<typename T>
 void get_tuple(lua_State* L, int arg, T* data, int n)
@@ -262,6 +281,7 @@ int gr_mesh_cmd(lua_State* L)
 	Mesh *mesh = nullptr;
 
 	if( i == mesh_map.end() ) {
+		PerfScope load(PerfPhase::Load);
 		mesh = new Mesh( obj_fname );
 	} else {
 		mesh = i->second;
@@ -302,52 +322,127 @@ int gr_light_cmd(lua_State* L)
   return 1;
 }
 
-// Render a scene
-extern "C"
-int gr_render_cmd(lua_State* L)
+// Read the arguments shared by gr.render and gr.render_async into job.
+static void get_render_args(lua_State* L, RenderJob& job)
 {
-  GRLUA_DEBUG_CALL;
-  
   gr_node_ud* root = (gr_node_ud*)luaL_checkudata(L, 1, "gr.node");
   luaL_argcheck(L, root != 0, 1, "Root node expected");
+  job.root = root->node;
 
-  const char* filename = luaL_checkstring(L, 2);
+  job.filename = luaL_checkstring(L, 2);
 
-  int width = luaL_checknumber(L, 3);
-  int height = luaL_checknumber(L, 4);
+  job.width = luaL_checknumber(L, 3);
+  job.height = luaL_checknumber(L, 4);
 
-  glm::vec3 eye;
-  glm::vec3 view, up;
-  
-  get_tuple(L, 5, &eye[0], 3);
-  get_tuple(L, 6, &view[0], 3);
-  get_tuple(L, 7, &up[0], 3);
+  get_tuple(L, 5, &job.eye[0], 3);
+  get_tuple(L, 6, &job.view[0], 3);
+  get_tuple(L, 7, &job.up[0], 3);
 
-  double fov = luaL_checknumber(L, 8);
+  job.fovy = luaL_checknumber(L, 8);
 
   double ambient_data[3];
   get_tuple(L, 9, ambient_data, 3);
-  glm::vec3 ambient(ambient_data[0], ambient_data[1], ambient_data[2]);
+  job.ambient = glm::vec3(ambient_data[0], ambient_data[1], ambient_data[2]);
 
   luaL_checktype(L, 10, LUA_TTABLE);
   int light_count = int(lua_rawlen(L, 10));
   
   luaL_argcheck(L, light_count >= 1, 10, "Tuple of lights expected");
-  std::list<Light*> lights;
   for (int i = 1; i <= light_count; i++) {
     lua_rawgeti(L, 10, i);
     gr_light_ud* ldata = (gr_light_ud*)luaL_checkudata(L, -1, "gr.light");
     luaL_argcheck(L, ldata != 0, 10, "Light expected");
 
-    lights.push_back(ldata->light);
+    job.lights.push_back(*ldata->light);
     lua_pop(L, 1);
   }
+}
+
+// Render a scene
+extern "C"
+int gr_render_cmd(lua_State* L)
+{
+  GRLUA_DEBUG_CALL;
+  
+  RenderJob job;
+  get_render_args(L, job);
 
-	Image im( width, height);
-	A4_Render(root->node, im, eye, view, up, fov, ambient, lights);
-    im.savePng( filename );
+  job.trace(&render_history);
+  job.save();
 
-	return 0;
+  return 0;
+}
+
+// Queue a scene to be rendered in the background. The nodes are
+// copied, so the script may change them as soon as this returns.
+// Returns a handle whose wait() blocks until the PNG is written.
+extern "C"
+int gr_render_async_cmd(lua_State* L)
+{
+  GRLUA_DEBUG_CALL;
+
+  std::shared_ptr<RenderJob> job = std::make_shared<RenderJob>();
+  get_render_args(L, *job);
+
+  job->snapshot.reset(job->root->clone());
+  job->root = job->snapshot.get();
+
+  if (!render_queue) {
+    render_queue = new RenderQueue(MAX_QUEUED_FRAMES);
+  }
+
+  gr_job_ud* data = (gr_job_ud*)lua_newuserdata(L, sizeof(gr_job_ud));
+  data->job = new std::shared_ptr<RenderJob>(job);
+
+  luaL_getmetatable(L, "gr.job");
+  lua_setmetatable(L, -2);
+
+  render_queue->submit(job);
+
+  return 1;
+}
+
+// Wait for every frame queued with gr.render_async.
+extern "C"
+int gr_wait_all_cmd(lua_State*)
+{
+  GRLUA_DEBUG_CALL;
+
+  if (render_queue) {
+    render_queue->waitAll();
+  }
+
+  return 0;
+}
+
+// Wait for one queued frame.
+extern "C"
+int gr_job_wait_cmd(lua_State* L)
+{
+  GRLUA_DEBUG_CALL;
+
+  gr_job_ud* data = (gr_job_ud*)luaL_checkudata(L, 1, "gr.job");
+  luaL_argcheck(L, data != 0 && data->job != 0, 1, "Render job expected");
+
+  render_queue->wait(**data->job);
+
+  return 0;
+}
+
+// Garbage collection function for render jobs. Dropping the handle
+// doesn't cancel the frame.
+extern "C"
+int gr_job_gc_cmd(lua_State* L)
+{
+  GRLUA_DEBUG_CALL;
+
+  gr_job_ud* data = (gr_job_ud*)luaL_checkudata(L, 1, "gr.job");
+  luaL_argcheck(L, data != 0, 1, "Render job expected");
+
+  delete data->job;
+  data->job = 0;
+
+  return 0;
 }
 
 // Create a material
@@ -525,6 +620,15 @@ static const luaL_Reg grlib_functions[] = {
   {"mesh", gr_mesh_cmd},
   {"light", gr_light_cmd},
   {"render", gr_render_cmd},
+  {"render_async", gr_render_async_cmd},
+  {"wait_all", gr_wait_all_cmd},
+  {0, 0}
+};
+
+// Member functions for the handles returned by gr.render_async.
+static const luaL_Reg grlib_job_methods[] = {
+  {"__gc", gr_job_gc_cmd},
+  {"wait", gr_job_wait_cmd},
   {0, 0}
 };
 
@@ -567,6 +671,14 @@ bool run_lua(const std::string& filename)
 
   GRLUA_DEBUG("Setting up our functions");
 
+  // Set up the metatable for gr.render_async handles
+  luaL_newmetatable(L, "gr.job");
+  lua_pushstring(L, "__index");
+  lua_pushvalue(L, -2);
+  lua_settable(L, -3);
+  luaL_setfuncs( L, grlib_job_methods, 0 );
+  lua_pop(L, 1);
+
   // Set up the metatable for gr.node
   luaL_newmetatable(L, "gr.node");
   lua_pushstring(L, "__index");
@@ -582,8 +694,20 @@ bool run_lua(const std::string& filename)
 
   GRLUA_DEBUG("Parsing the scene");
   // Now parse the actual scene
+  bool ok = true;
   if (luaL_loadfile(L, filename.c_str()) || lua_pcall(L, 0, 0, 0)) {
     std::cerr << "Error loading " << filename << ": " << lua_tostring(L, -1) << std::endl;
+    ok = false;
+  }
+
+  // Finish any frames still queued by gr.render_async
+  delete render_queue;
+  render_queue = 0;
+
+  // totals for the whole run, now including the last frames' encoding
+  perfReport(std::cout);
+
+  if (!ok) {
     return false;
   }
   GRLUA_DEBUG("Closing the interpreter");
@@ -5,6 +5,15 @@ struct LightSource {
     vec3 rgbIntensity;
 };
 
+// Set once per frame, shared by every program that declares it.
+layout(std140) uniform FrameData {
+	mat4 Perspective;
+	mat4 View;
+	mat4 DepthBias; // light's biased view-projection, for shadow map lookups
+	LightSource light;
+	vec3 ambientIntensity; // Ambient light intensity for each RGB component.
+};
+
 in VsOutFsIn {
 	vec3 position_ES; // Eye-space position
 	vec3 normal_ES;   // Eye-space normal
@@ -22,17 +31,29 @@ struct Material {
     float shininess;
     float alpha;
 };
-uniform Material material;
+
+// Set per draw, from a range of a ring buffer.
+layout(std140) uniform DrawData {
+	mat4 ModelView;
+	mat4 nextModelView;
+	mat4 Model;
+	// Remember, this is transpose(inverse(ModelView)).  Normals should be
+	// transformed using this matrix instead of the ModelView matrix.
+	mat3 NormalMatrix;
+	Material material;
+	float time0;
+	float time1;
+	float curTime;
+	bool instanced;
+};
 
 uniform bool picking;
 
 uniform bool drawShadows;
 uniform bool drawTexture;
 
-// Ambient light intensity for each RGB component.
-uniform vec3 ambientIntensity;
-
 uniform sampler2D textureSampler;
+uniform vec4 textureRect; // where the texture sits in textureSampler, offset xy and scale zw
 uniform sampler2DShadow shadowMap; 
 
 
@@ -63,7 +84,7 @@ vec3 phongModel(vec3 fragPosition, vec3 fragNormal) {
     vec3 t = vec3(1.0f);
 
     if (drawTexture){
-        t = texture(textureSampler, UV).rgb;
+        t = texture(textureSampler, textureRect.xy + UV * textureRect.zw).rgb;
     }
 
     float bias = 0.005;
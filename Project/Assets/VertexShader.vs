@@ -5,22 +5,44 @@ in vec3 position;
 in vec3 normal;
 in vec2 uv;
 
+// Per instance, for instanced draws only: the model matrix, after Model
+layout(location = 8) in mat4 instanceModel;
+
 struct LightSource {
     vec3 position;
     vec3 rgbIntensity;
 };
-uniform LightSource light;
 
-uniform mat4 ModelView;
-uniform mat4 nextModelView;
-uniform float time0;
-uniform float time1;
-uniform float curTime;
-uniform mat4 Perspective;
+// Set once per frame, shared by every program that declares it.
+layout(std140) uniform FrameData {
+	mat4 Perspective;
+	mat4 View;
+	mat4 DepthBias; // light's biased view-projection, for shadow map lookups
+	LightSource light;
+	vec3 ambientIntensity; // Ambient light intensity for each RGB component.
+};
 
-// Remember, this is transpose(inverse(ModelView)).  Normals should be
-// transformed using this matrix instead of the ModelView matrix.
-uniform mat3 NormalMatrix;
+struct Material {
+    vec3 kd;
+    vec3 ks;
+    float shininess;
+    float alpha;
+};
+
+// Set per draw, from a range of a ring buffer.
+layout(std140) uniform DrawData {
+	mat4 ModelView;
+	mat4 nextModelView;
+	mat4 Model;
+	// Remember, this is transpose(inverse(ModelView)).  Normals should be
+	// transformed using this matrix instead of the ModelView matrix.
+	mat3 NormalMatrix;
+	Material material;
+	float time0;
+	float time1;
+	float curTime;
+	bool instanced;
+};
 
 out VsOutFsIn {
 	vec3 position_ES; // Eye-space position
@@ -31,8 +53,6 @@ out VsOutFsIn {
 out vec4 ShadowCoord;
 out vec2 UV;
 
-uniform mat4 depthBiasMVP;
-
 vec4 lerp(float curTime, float time0, vec4 p0, float time1, vec4 p1){
 	float epsilon = 0.001f;
 
@@ -49,16 +69,25 @@ vec4 lerp(float curTime, float time0, vec4 p0, float time1, vec4 p1){
 void main() {
 	vec4 pos4 = vec4(position, 1.0);
 
+	mat4 modelView = ModelView;
+	mat4 model = Model;
+	mat3 normalMatrix = NormalMatrix;
+	if (instanced) {
+		modelView = ModelView * instanceModel;
+		model = Model * instanceModel;
+		normalMatrix = transpose(inverse(mat3(modelView)));
+	}
+
 	//-- Convert position and normal to Eye-Space:
-	vs_out.position_ES = (ModelView * pos4).xyz;
-	vs_out.normal_ES = normalize(NormalMatrix * normal);
+	vs_out.position_ES = (modelView * pos4).xyz;
+	vs_out.normal_ES = normalize(normalMatrix * normal);
 
 	vs_out.light = light;
 
-	ShadowCoord =  (depthBiasMVP * pos4);//* vec4(position,1);
+	ShadowCoord =  (DepthBias * model * pos4);//* vec4(position,1);
 
-	vec4 p0 = ModelView * pos4;
-	vec4 p1 = nextModelView * pos4;
+	vec4 p0 = modelView * pos4;
+	vec4 p1 = instanced ? p0 : nextModelView * pos4;
 
 	gl_Position = Perspective * lerp(curTime, time0, p0, time1, p1);//vec4(position, 1.0);
 
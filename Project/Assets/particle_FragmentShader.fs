@@ -0,0 +1,40 @@
+#version 330
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+
+// Set once per frame, shared by every program that declares it.
+layout(std140) uniform FrameData {
+	mat4 Perspective;
+	mat4 View;
+	mat4 DepthBias; // light's biased view-projection, for shadow map lookups
+	LightSource light;
+	vec3 ambientIntensity; // Ambient light intensity for each RGB component.
+};
+
+in vec3 position_ES;
+in vec3 normal_ES;
+
+out vec4 fragColour;
+
+uniform vec3 colour;
+uniform float shininess;
+
+void main() {
+    vec3 n = normalize(normal_ES);
+    vec3 l = normalize(light.position - position_ES);
+    vec3 v = normalize(-position_ES);
+
+    float n_dot_l = max(dot(n, l), 0.0);
+
+    // same colour for the diffuse and specular terms
+    vec3 specular = vec3(0.0);
+    if (n_dot_l > 0.0) {
+        vec3 h = normalize(v + l);
+        specular = colour * pow(max(dot(n, h), 0.0), shininess);
+    }
+
+    fragColour = vec4(ambientIntensity + light.rgbIntensity * (colour * n_dot_l + specular), 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330
+
+// Model-Space coordinates of the particle cube
+in vec3 position;
+in vec3 normal;
+
+// Per instance: world-space centre, size
+in vec4 instance;
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+
+// Set once per frame, shared by every program that declares it.
+layout(std140) uniform FrameData {
+	mat4 Perspective;
+	mat4 View;
+	mat4 DepthBias; // light's biased view-projection, for shadow map lookups
+	LightSource light;
+	vec3 ambientIntensity; // Ambient light intensity for each RGB component.
+};
+
+out vec3 position_ES; // Eye-space position
+out vec3 normal_ES;   // Eye-space normal
+
+void main() {
+	// particles are only translated and uniformly scaled, so the view's rotation
+	// is all the normals need
+	vec4 pos4 = View * vec4(instance.xyz + instance.w * position, 1.0);
+
+	position_ES = pos4.xyz;
+	normal_ES = normalize(mat3(View) * normal);
+
+	gl_Position = Perspective * pos4;
+}
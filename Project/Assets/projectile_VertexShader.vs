@@ -0,0 +1,44 @@
+#version 330
+
+// Model-Space coordinates of the shot's plane
+in vec3 position;
+in vec3 normal;
+
+// Per instance: world-space position and size, velocity and owner
+in vec4 instance;
+in vec4 instanceVelocity;
+
+struct LightSource {
+    vec3 position;
+    vec3 rgbIntensity;
+};
+
+// Set once per frame, shared by every program that declares it.
+layout(std140) uniform FrameData {
+	mat4 Perspective;
+	mat4 View;
+	mat4 DepthBias; // light's biased view-projection, for shadow map lookups
+	LightSource light;
+	vec3 ambientIntensity; // Ambient light intensity for each RGB component.
+};
+uniform vec3 colours[2]; // player's shots, enemies' shots
+
+out vec3 position_ES; // Eye-space position
+out vec3 normal_ES;   // Eye-space normal
+out vec3 colour;
+
+void main() {
+	// the shot's -z points along its velocity in the xz plane, as it left its shooter
+	vec3 forward = vec3(instanceVelocity.x, 0.0, instanceVelocity.z);
+	forward = dot(forward, forward) > 0.0 ? normalize(forward) : vec3(0.0, 0.0, -1.0);
+	mat3 orientation = mat3(cross(forward, vec3(0.0, 1.0, 0.0)), vec3(0.0, 1.0, 0.0), -forward);
+
+	vec3 shape = vec3(0.05, 1.0, 0.2) * (position + vec3(0.0, -0.1, 0.0));
+	vec4 pos4 = View * vec4(instance.xyz + instance.w * (orientation * shape), 1.0);
+
+	position_ES = pos4.xyz;
+	normal_ES = normalize(mat3(View) * orientation * normal);
+	colour = colours[int(instanceVelocity.w)];
+
+	gl_Position = Perspective * pos4;
+}
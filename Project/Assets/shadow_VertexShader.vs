@@ -1,15 +1,20 @@
-#version 330 core
-
-//code from http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-16-shadow-mapping/
-
-// Input vertex data, different for all executions of this shader.
-//layout(location = 0) in vec3 vertexPosition_modelspace;
-
-in vec3 position;
-
-// Values that stay constant for the whole mesh.
-uniform mat4 ModelView;
-
-void main(){
- gl_Position =  ModelView * vec4(position,1.0);
+#version 330 core
+
+//code from http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-16-shadow-mapping/
+
+// Input vertex data, different for all executions of this shader.
+//layout(location = 0) in vec3 vertexPosition_modelspace;
+
+in vec3 position;
+
+// Per instance, for instanced draws only: the model matrix, after ModelView
+layout(location = 8) in mat4 instanceModel;
+
+// Values that stay constant for the whole mesh.
+uniform mat4 ModelView;
+uniform bool instanced;
+
+void main(){
+ mat4 modelView = instanced ? ModelView * instanceModel : ModelView;
+ gl_Position =  modelView * vec4(position,1.0);
 }
\ No newline at end of file
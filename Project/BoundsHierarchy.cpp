@@ -0,0 +1,190 @@
+#include "BoundsHierarchy.hpp"
+
+#include <algorithm>
+
+// boxes per leaf
+#define BOUNDS_LEAF_SIZE 4
+
+//---------------------------------------------------------------------------------------
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++) {
+		m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Gribb and Hartmann: each plane is the last row of the matrix plus or minus another.
+Frustum::Frustum(const glm::mat4 & viewProjection)
+{
+	glm::mat4 m = glm::transpose(viewProjection);
+	m_planes[0] = m[3] + m[0];
+	m_planes[1] = m[3] - m[0];
+	m_planes[2] = m[3] + m[1];
+	m_planes[3] = m[3] - m[1];
+	m_planes[4] = m[3] + m[2];
+	m_planes[5] = m[3] - m[2];
+	for (int i = 0; i < 6; i++) {
+		m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+	}
+}
+
+//---------------------------------------------------------------------------------------
+Frustum::Test Frustum::test(const glm::vec3 & min, const glm::vec3 & max) const
+{
+	glm::vec3 centre = 0.5f * (min + max);
+	glm::vec3 half = 0.5f * (max - min);
+
+	Test result = Inside;
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 normal(m_planes[i]);
+		float distance = glm::dot(normal, centre) + m_planes[i].w;
+		float radius = glm::dot(half, glm::abs(normal));
+		if (distance < -radius) return Outside;
+		if (distance < radius) result = Intersects;
+	}
+	return result;
+}
+
+//---------------------------------------------------------------------------------------
+BoundsHierarchy::BoundsHierarchy()
+{
+}
+
+//---------------------------------------------------------------------------------------
+void BoundsHierarchy::build(const std::vector<glm::vec3> & mins, const std::vector<glm::vec3> & maxs)
+{
+	m_mins = mins;
+	m_maxs = maxs;
+	m_items.resize(mins.size());
+	for (uint32_t i = 0; i < m_items.size(); i++) {
+		m_items[i] = i;
+	}
+	m_nodes.clear();
+	if (!m_items.empty()) {
+		m_nodes.reserve(2*m_items.size() / BOUNDS_LEAF_SIZE + 1);
+		buildNode(0, m_items.size());
+	}
+}
+
+//---------------------------------------------------------------------------------------
+uint32_t BoundsHierarchy::buildNode(uint32_t first, uint32_t count)
+{
+	uint32_t index = m_nodes.size();
+	m_nodes.push_back(Node());
+
+	glm::vec3 min(m_mins[m_items[first]]), max(m_maxs[m_items[first]]);
+	glm::vec3 centreMin(min + max), centreMax(min + max);
+	for (uint32_t i = first; i < first + count; i++) {
+		uint32_t item = m_items[i];
+		min = glm::min(min, m_mins[item]);
+		max = glm::max(max, m_maxs[item]);
+		centreMin = glm::min(centreMin, m_mins[item] + m_maxs[item]);
+		centreMax = glm::max(centreMax, m_mins[item] + m_maxs[item]);
+	}
+	m_nodes[index].min = min;
+	m_nodes[index].max = max;
+
+	if (count <= BOUNDS_LEAF_SIZE) {
+		m_nodes[index].first = first;
+		m_nodes[index].count = count;
+		return index;
+	}
+
+	glm::vec3 extent = centreMax - centreMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(m_items.begin() + first, m_items.begin() + first + half, m_items.begin() + first + count,
+		[&](uint32_t a, uint32_t b) {
+			return m_mins[a][axis] + m_maxs[a][axis] < m_mins[b][axis] + m_maxs[b][axis];
+		});
+
+	buildNode(first, half);
+	uint32_t right = buildNode(first + half, count - half);
+	m_nodes[index].first = right;
+	m_nodes[index].count = 0;
+	return index;
+}
+
+//---------------------------------------------------------------------------------------
+void BoundsHierarchy::refit(const std::vector<glm::vec3> & mins, const std::vector<glm::vec3> & maxs)
+{
+	m_mins = mins;
+	m_maxs = maxs;
+
+	// children always come after their parent
+	for (size_t n = m_nodes.size(); n-- > 0; ) {
+		Node & node = m_nodes[n];
+		if (node.count > 0) {
+			node.min = m_mins[m_items[node.first]];
+			node.max = m_maxs[m_items[node.first]];
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				node.min = glm::min(node.min, m_mins[m_items[i]]);
+				node.max = glm::max(node.max, m_maxs[m_items[i]]);
+			}
+		} else {
+			const Node & left = m_nodes[n + 1];
+			const Node & right = m_nodes[node.first];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+size_t BoundsHierarchy::cull(const Frustum & frustum, std::vector<uint8_t> & visible) const
+{
+	visible.assign(m_mins.size(), 0);
+	size_t count = 0;
+	if (m_nodes.empty()) return 0;
+
+	uint32_t stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t n = stack[--top];
+		const Node & node = m_nodes[n];
+
+		Frustum::Test test = frustum.test(node.min, node.max);
+		if (test == Frustum::Outside) continue;
+		if (test == Frustum::Inside) {
+			markAll(n, visible, count);
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				uint32_t item = m_items[i];
+				if (frustum.test(m_mins[item], m_maxs[item]) != Frustum::Outside) {
+					visible[item] = 1;
+					count++;
+				}
+			}
+		} else {
+			stack[top++] = node.first;
+			stack[top++] = n + 1;
+		}
+	}
+	return count;
+}
+
+//---------------------------------------------------------------------------------------
+void BoundsHierarchy::markAll(uint32_t n, std::vector<uint8_t> & visible, size_t & count) const
+{
+	const Node & node = m_nodes[n];
+	if (node.count > 0) {
+		for (uint32_t i = node.first; i < node.first + node.count; i++) {
+			visible[m_items[i]] = 1;
+		}
+		count += node.count;
+	} else {
+		markAll(n + 1, visible, count);
+		markAll(node.first, visible, count);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+size_t BoundsHierarchy::size() const
+{
+	return m_mins.size();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// The six planes of a view volume, pulled out of its view-projection matrix.  Works
+// the same for the perspective camera and the orthographic light.
+class Frustum {
+public:
+	enum Test {
+		Outside,
+		Intersects,
+		Inside
+	};
+
+	Frustum();
+	explicit Frustum(const glm::mat4 & viewProjection);
+
+	Test test(const glm::vec3 & min, const glm::vec3 & max) const;
+
+private:
+	glm::vec4 m_planes[6]; // xyz inward normal, w distance
+};
+
+// Bounding-volume hierarchy over a list of world-space boxes, for culling them against
+// frusta.  Built top down by splitting at the median of the longest axis.  While the
+// boxes only move, refit() updates it in place instead of building it again.
+class BoundsHierarchy {
+public:
+	BoundsHierarchy();
+
+	void build(const std::vector<glm::vec3> & mins, const std::vector<glm::vec3> & maxs);
+
+	// Same boxes as the last build(), in the same order, in their new places.
+	void refit(const std::vector<glm::vec3> & mins, const std::vector<glm::vec3> & maxs);
+
+	// Sets visible[i] to whether box i is at least partly inside frustum, returns how
+	// many are.
+	size_t cull(const Frustum & frustum, std::vector<uint8_t> & visible) const;
+
+	size_t size() const;
+
+private:
+	struct Node {
+		glm::vec3 min;
+		glm::vec3 max;
+		uint32_t first; // leaf: first of m_items, interior: right child
+		uint32_t count; // leaf: boxes in it, interior: 0, the left child follows it
+	};
+
+	uint32_t buildNode(uint32_t first, uint32_t count);
+	void markAll(uint32_t node, std::vector<uint8_t> & visible, size_t & count) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_items;
+	std::vector<glm::vec3> m_mins;
+	std::vector<glm::vec3> m_maxs;
+};
@@ -0,0 +1,324 @@
+#include "Broadphase.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// side of a grid cell, and how far past the static nodes the grid reaches
+#define BROADPHASE_CELL_SIZE 2.0f
+#define BROADPHASE_MARGIN 4.0f
+#define BROADPHASE_MAX_CELLS 256
+
+//---------------------------------------------------------------------------------------
+static void collectGeometry(SceneNode* root, std::vector<GeometryNode*> & nodes)
+{
+	if (root->m_nodeType == NodeType::GeometryNode) {
+		nodes.push_back(static_cast<GeometryNode *>(root));
+	}
+	for (SceneNode *child : root->children) {
+		collectGeometry(child, nodes);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+Broadphase::Broadphase()
+	: m_time(0),
+	  m_gridMin(0.0f),
+	  m_inverseCellSize(1.0f / BROADPHASE_CELL_SIZE),
+	  m_gridWidth(1),
+	  m_gridDepth(1),
+	  m_query(0)
+{ }
+
+//---------------------------------------------------------------------------------------
+void Broadphase::bounds(GeometryNode* node, glm::vec2 & min, glm::vec2 & max) const
+{
+	glm::dvec3 origin = node->getHitboxOrigin(m_time);
+	glm::dvec3 halfSize = 0.5 * node->hitbox->_maxXYZ;
+	min = glm::vec2(origin.x - halfSize.x, origin.z - halfSize.z);
+	max = glm::vec2(origin.x + halfSize.x, origin.z + halfSize.z);
+}
+
+//---------------------------------------------------------------------------------------
+// Anything past the edge of the grid goes in the edge cells.
+void Broadphase::cellRange(const glm::vec2 & min, const glm::vec2 & max, int & x0, int & z0, int & x1, int & z1) const
+{
+	glm::vec2 a = glm::floor((min - m_gridMin) * m_inverseCellSize);
+	glm::vec2 b = glm::floor((max - m_gridMin) * m_inverseCellSize);
+	x0 = (int)glm::clamp(a.x, 0.0f, (float)(m_gridWidth - 1));
+	z0 = (int)glm::clamp(a.y, 0.0f, (float)(m_gridDepth - 1));
+	x1 = (int)glm::clamp(b.x, 0.0f, (float)(m_gridWidth - 1));
+	z1 = (int)glm::clamp(b.y, 0.0f, (float)(m_gridDepth - 1));
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::build(SceneNode* root, const std::vector<GeometryNode*> & dynamicNodes, float curtime)
+{
+	m_time = curtime;
+	m_static.clear();
+	m_dynamic.clear();
+	m_staticIndex.clear();
+	m_dynamicIndex.clear();
+
+	std::vector<GeometryNode*> nodes;
+	collectGeometry(root, nodes);
+
+	std::vector<glm::vec2> staticMin, staticMax;
+	for (GeometryNode* node : nodes) {
+		Entry entry;
+		entry.node = node;
+		entry.live = true;
+
+		bool dynamic = node->hasAnimation() ||
+			std::find(dynamicNodes.begin(), dynamicNodes.end(), node) != dynamicNodes.end();
+		if (dynamic) {
+			m_dynamicIndex[node] = m_dynamic.size();
+			m_dynamic.push_back(entry);
+		} else {
+			m_staticIndex[node] = m_static.size();
+			m_static.push_back(entry);
+			glm::vec2 min, max;
+			bounds(node, min, max);
+			staticMin.push_back(min);
+			staticMax.push_back(max);
+		}
+	}
+
+	// the grid covers the static nodes, which bound where anything else can go
+	glm::vec2 lo(0.0f), hi(0.0f);
+	if (!m_static.empty()) {
+		lo = glm::vec2(INFINITY);
+		hi = glm::vec2(-INFINITY);
+		for (size_t i = 0; i < m_static.size(); i++) {
+			lo = glm::min(lo, staticMin[i]);
+			hi = glm::max(hi, staticMax[i]);
+		}
+	}
+	lo -= glm::vec2(BROADPHASE_MARGIN);
+	hi += glm::vec2(BROADPHASE_MARGIN);
+
+	glm::vec2 extent = hi - lo;
+	float cellSize = std::max(BROADPHASE_CELL_SIZE, std::max(extent.x, extent.y) / BROADPHASE_MAX_CELLS);
+	m_gridMin = lo;
+	m_inverseCellSize = 1.0f / cellSize;
+	m_gridWidth = std::max(1, (int)std::ceil(extent.x * m_inverseCellSize));
+	m_gridDepth = std::max(1, (int)std::ceil(extent.y * m_inverseCellSize));
+	int cells = m_gridWidth*m_gridDepth;
+
+	// static nodes: counting sort into cells, never touched again
+	m_staticStart.assign(cells + 1, 0);
+	for (size_t i = 0; i < m_static.size(); i++) {
+		Entry & entry = m_static[i];
+		cellRange(staticMin[i], staticMax[i], entry.x0, entry.z0, entry.x1, entry.z1);
+		for (int z = entry.z0; z <= entry.z1; z++) {
+			for (int x = entry.x0; x <= entry.x1; x++) {
+				m_staticStart[z*m_gridWidth + x + 1]++;
+			}
+		}
+	}
+	for (int c = 0; c < cells; c++) {
+		m_staticStart[c + 1] += m_staticStart[c];
+	}
+
+	size_t total = m_staticStart[cells];
+	m_staticCells.resize(total);
+	m_staticMinX.resize(total);
+	m_staticMaxX.resize(total);
+	m_staticMinZ.resize(total);
+	m_staticMaxZ.resize(total);
+	std::vector<uint32_t> fill(m_staticStart.begin(), m_staticStart.end() - 1);
+	for (uint32_t i = 0; i < m_static.size(); i++) {
+		const Entry & entry = m_static[i];
+		for (int z = entry.z0; z <= entry.z1; z++) {
+			for (int x = entry.x0; x <= entry.x1; x++) {
+				uint32_t k = fill[z*m_gridWidth + x]++;
+				m_staticCells[k] = i;
+				m_staticMinX[k] = staticMin[i].x;
+				m_staticMaxX[k] = staticMax[i].x;
+				m_staticMinZ[k] = staticMin[i].y;
+				m_staticMaxZ[k] = staticMax[i].y;
+			}
+		}
+	}
+
+	size_t n = m_dynamic.size();
+	m_dynamicMinX.resize(n);
+	m_dynamicMaxX.resize(n);
+	m_dynamicMinZ.resize(n);
+	m_dynamicMaxZ.resize(n);
+	m_dynamicCells.assign(cells, std::vector<uint32_t>());
+	m_moverOf.assign(n, -1);
+	m_visited.assign(n, 0);
+	m_query = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		Entry & entry = m_dynamic[i];
+		updateBounds(i);
+		cellRange(glm::vec2(m_dynamicMinX[i], m_dynamicMinZ[i]), glm::vec2(m_dynamicMaxX[i], m_dynamicMaxZ[i]),
+			entry.x0, entry.z0, entry.x1, entry.z1);
+		insertDynamic(i);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::updateBounds(uint32_t index)
+{
+	glm::vec2 min, max;
+	bounds(m_dynamic[index].node, min, max);
+	m_dynamicMinX[index] = min.x;
+	m_dynamicMaxX[index] = max.x;
+	m_dynamicMinZ[index] = min.y;
+	m_dynamicMaxZ[index] = max.y;
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::insertDynamic(uint32_t index)
+{
+	const Entry & entry = m_dynamic[index];
+	for (int z = entry.z0; z <= entry.z1; z++) {
+		for (int x = entry.x0; x <= entry.x1; x++) {
+			m_dynamicCells[z*m_gridWidth + x].push_back(index);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::removeDynamic(uint32_t index)
+{
+	const Entry & entry = m_dynamic[index];
+	for (int z = entry.z0; z <= entry.z1; z++) {
+		for (int x = entry.x0; x <= entry.x1; x++) {
+			std::vector<uint32_t> & cell = m_dynamicCells[z*m_gridWidth + x];
+			auto it = std::find(cell.begin(), cell.end(), index);
+			if (it != cell.end()) {
+				*it = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Moves an entry to the cells under its current bounds, if they changed.
+void Broadphase::rebucket(uint32_t index)
+{
+	Entry & entry = m_dynamic[index];
+	int x0, z0, x1, z1;
+	cellRange(glm::vec2(m_dynamicMinX[index], m_dynamicMinZ[index]), glm::vec2(m_dynamicMaxX[index], m_dynamicMaxZ[index]),
+		x0, z0, x1, z1);
+	if (x0 == entry.x0 && z0 == entry.z0 && x1 == entry.x1 && z1 == entry.z1) return;
+
+	removeDynamic(index);
+	entry.x0 = x0;
+	entry.z0 = z0;
+	entry.x1 = x1;
+	entry.z1 = z1;
+	insertDynamic(index);
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::update(float curtime)
+{
+	m_time = curtime;
+	for (uint32_t i = 0; i < m_dynamic.size(); i++) {
+		if (!m_dynamic[i].live) continue;
+		updateBounds(i);
+		rebucket(i);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::remove(GeometryNode* node)
+{
+	auto found = m_dynamicIndex.find(node);
+	if (found != m_dynamicIndex.end()) {
+		if (m_dynamic[found->second].live) removeDynamic(found->second);
+		m_dynamic[found->second].live = false;
+		return;
+	}
+
+	// static cells are left alone, the entry is just skipped
+	found = m_staticIndex.find(node);
+	if (found != m_staticIndex.end()) {
+		m_static[found->second].live = false;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void Broadphase::findPairs(const std::vector<GeometryNode*> & movers, std::vector<BroadphasePair> & pairs)
+{
+	// every moving node's bounds once, then the movers into the cells they're in now
+	for (uint32_t i = 0; i < m_dynamic.size(); i++) {
+		if (m_dynamic[i].live) updateBounds(i);
+	}
+	std::vector<uint32_t> moverEntries;
+	moverEntries.reserve(movers.size());
+	for (uint32_t m = 0; m < movers.size(); m++) {
+		auto found = m_dynamicIndex.find(movers[m]);
+		uint32_t index = found == m_dynamicIndex.end() ? UINT32_MAX : found->second;
+		if (index != UINT32_MAX && m_dynamic[index].live) {
+			m_moverOf[index] = m;
+			rebucket(index);
+		}
+		moverEntries.push_back(index);
+	}
+
+	for (uint32_t m = 0; m < movers.size(); m++) {
+		uint32_t self = moverEntries[m];
+		if (self == UINT32_MAX || !m_dynamic[self].live) continue;
+
+		const Entry & entry = m_dynamic[self];
+		float minX = m_dynamicMinX[self], maxX = m_dynamicMaxX[self];
+		float minZ = m_dynamicMinZ[self], maxZ = m_dynamicMaxZ[self];
+
+		// a node spanning several cells is only reported once
+		if (++m_query == 0) {
+			std::fill(m_visited.begin(), m_visited.end(), 0);
+			m_query = 1;
+		}
+		m_visited[self] = m_query;
+
+		for (int z = entry.z0; z <= entry.z1; z++) {
+			for (int x = entry.x0; x <= entry.x1; x++) {
+				int c = z*m_gridWidth + x;
+
+				// the whole cell's static bounds in one straight loop, then the hits
+				uint32_t k0 = m_staticStart[c];
+				uint32_t count = m_staticStart[c + 1] - k0;
+				if (m_hits.size() < count) m_hits.resize(count);
+				const float * sMinX = m_staticMinX.data() + k0;
+				const float * sMaxX = m_staticMaxX.data() + k0;
+				const float * sMinZ = m_staticMinZ.data() + k0;
+				const float * sMaxZ = m_staticMaxZ.data() + k0;
+				uint8_t * hits = m_hits.data();
+				for (uint32_t k = 0; k < count; k++) {
+					hits[k] = (sMinX[k] < maxX) & (sMaxX[k] > minX) & (sMinZ[k] < maxZ) & (sMaxZ[k] > minZ);
+				}
+				for (uint32_t k = 0; k < count; k++) {
+					if (!hits[k]) continue;
+					const Entry & other = m_static[m_staticCells[k0 + k]];
+					if (!other.live) continue;
+					// only report a static node from the first cell both cover
+					if (x != std::max(entry.x0, other.x0) || z != std::max(entry.z0, other.z0)) continue;
+					pairs.push_back({ m, other.node, -1 });
+				}
+
+				for (uint32_t index : m_dynamicCells[c]) {
+					if (m_visited[index] == m_query) continue;
+					m_visited[index] = m_query;
+
+					// pairs of movers come from the lower numbered one
+					int otherMover = m_moverOf[index];
+					if (otherMover >= 0 && otherMover < (int)m) continue;
+
+					if (m_dynamicMinX[index] < maxX && m_dynamicMaxX[index] > minX &&
+						m_dynamicMinZ[index] < maxZ && m_dynamicMaxZ[index] > minZ) {
+						pairs.push_back({ m, m_dynamic[index].node, otherMover });
+					}
+				}
+			}
+		}
+	}
+
+	for (uint32_t index : moverEntries) {
+		if (index != UINT32_MAX) m_moverOf[index] = -1;
+	}
+}
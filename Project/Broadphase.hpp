@@ -0,0 +1,81 @@
+#pragma once
+
+#include "GeometryNode.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Two nodes whose hitboxes overlap.  mover indexes the movers passed to findPairs,
+// otherMover too if the other node was one of them, -1 if not.
+struct BroadphasePair {
+	uint32_t mover;
+	GeometryNode* other;
+	int otherMover;
+};
+
+// Finds the nodes whose hitboxes overlap in the xz plane.  The walls and other static
+// nodes are sorted into a grid once, when the scene is loaded.  Nodes that move
+// (the player, enemies, anything animated) sit in a second grid over the same cells
+// and are only re-bucketed when they move into different cells.
+class Broadphase {
+public:
+	Broadphase();
+
+	// Starts over with the nodes under root.  dynamicNodes, and anything keyframed,
+	// go in the grid for moving nodes.
+	void build(SceneNode* root, const std::vector<GeometryNode*> & dynamicNodes, float curtime);
+
+	// Re-buckets every moving node at curtime, for the keyframed ones.
+	void update(float curtime);
+
+	void remove(GeometryNode* node);
+
+	// Every overlap involving one of movers, all found in one pass: each moving node's
+	// hitbox is computed once, the movers are re-bucketed, then tested against the
+	// cells they cover.  A pair of movers is reported once.
+	void findPairs(const std::vector<GeometryNode*> & movers, std::vector<BroadphasePair> & pairs);
+
+private:
+	struct Entry {
+		GeometryNode* node;
+		int x0, z0, x1, z1; // cells covered
+		bool live;
+	};
+
+	void bounds(GeometryNode* node, glm::vec2 & min, glm::vec2 & max) const;
+	void cellRange(const glm::vec2 & min, const glm::vec2 & max, int & x0, int & z0, int & x1, int & z1) const;
+	void updateBounds(uint32_t index);
+	void rebucket(uint32_t index);
+	void insertDynamic(uint32_t index);
+	void removeDynamic(uint32_t index);
+
+	float m_time;
+
+	glm::vec2 m_gridMin;
+	float m_inverseCellSize;
+	int m_gridWidth;
+	int m_gridDepth;
+
+	// static nodes by cell, cell c's are m_staticCells[m_staticStart[c] .. m_staticStart[c+1]),
+	// with their bounds alongside so a cell is tested in one straight loop
+	std::vector<Entry> m_static;
+	std::vector<uint32_t> m_staticStart;
+	std::vector<uint32_t> m_staticCells;
+	std::vector<float> m_staticMinX, m_staticMaxX, m_staticMinZ, m_staticMaxZ;
+
+	// moving nodes, bounds as of the last update() or findPairs()
+	std::vector<Entry> m_dynamic;
+	std::vector<float> m_dynamicMinX, m_dynamicMaxX, m_dynamicMinZ, m_dynamicMaxZ;
+	std::vector<std::vector<uint32_t>> m_dynamicCells;
+
+	std::vector<int> m_moverOf;      // per dynamic entry, its index in movers or -1
+	std::vector<uint32_t> m_visited; // per dynamic entry, the query that last saw it
+	uint32_t m_query;
+	std::vector<uint8_t> m_hits;
+
+	std::unordered_map<GeometryNode*, uint32_t> m_staticIndex;
+	std::unordered_map<GeometryNode*, uint32_t> m_dynamicIndex;
+};
@@ -0,0 +1,115 @@
+#include "EntityRegistry.hpp"
+
+//---------------------------------------------------------------------------------------
+EntityRegistry::EntityRegistry()
+{
+}
+
+//---------------------------------------------------------------------------------------
+EntityHandle EntityRegistry::add(GeometryNode* node, uint32_t tags)
+{
+	uint32_t slot;
+	if (!m_free.empty()) {
+		slot = m_free.back();
+		m_free.pop_back();
+	} else {
+		slot = m_denseOf.size();
+		m_denseOf.push_back(0);
+		m_generation.push_back(0);
+	}
+
+	m_denseOf[slot] = m_nodes.size();
+	m_nodes.push_back(node);
+	m_tags.push_back(tags);
+	m_slotOf.push_back(slot);
+	node->m_entity = slot;
+
+	return { slot, m_generation[slot] };
+}
+
+//---------------------------------------------------------------------------------------
+bool EntityRegistry::remove(EntityHandle handle)
+{
+	if (!valid(handle)) return false;
+
+	uint32_t dense = m_denseOf[handle.index];
+	GeometryNode* node = m_nodes[dense];
+	if (node->parent != nullptr) {
+		node->parent->remove_child(node);
+	}
+	node->m_entity = ENTITY_NONE;
+
+	// the last entity fills the hole
+	uint32_t last = m_nodes.size() - 1;
+	m_nodes[dense] = m_nodes[last];
+	m_tags[dense] = m_tags[last];
+	m_slotOf[dense] = m_slotOf[last];
+	m_denseOf[m_slotOf[dense]] = dense;
+	m_nodes.pop_back();
+	m_tags.pop_back();
+	m_slotOf.pop_back();
+
+	m_denseOf[handle.index] = ENTITY_NONE;
+	m_generation[handle.index]++;
+	m_free.push_back(handle.index);
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+bool EntityRegistry::valid(EntityHandle handle) const
+{
+	return handle.index < m_generation.size() && m_generation[handle.index] == handle.generation &&
+		m_denseOf[handle.index] != ENTITY_NONE;
+}
+
+//---------------------------------------------------------------------------------------
+GeometryNode* EntityRegistry::get(EntityHandle handle) const
+{
+	return valid(handle) ? m_nodes[m_denseOf[handle.index]] : nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+EntityHandle EntityRegistry::handleOf(const GeometryNode* node) const
+{
+	uint32_t slot = node->m_entity;
+	if (slot >= m_generation.size()) return { ENTITY_NONE, 0 };
+	return { slot, m_generation[slot] };
+}
+
+//---------------------------------------------------------------------------------------
+bool EntityRegistry::is(const GeometryNode* node, uint32_t tags) const
+{
+	EntityHandle handle = handleOf(node);
+	return valid(handle) && (m_tags[m_denseOf[handle.index]] & tags) != 0;
+}
+
+//---------------------------------------------------------------------------------------
+void EntityRegistry::collect(uint32_t tags, std::vector<GeometryNode*> & nodes) const
+{
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		if (m_tags[i] & tags) nodes.push_back(m_nodes[i]);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void EntityRegistry::clear()
+{
+	// the slots stay, with new generations, so handles from before don't resolve
+	// to whatever is added next
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		uint32_t slot = m_slotOf[i];
+		m_nodes[i]->m_entity = ENTITY_NONE;
+		m_denseOf[slot] = ENTITY_NONE;
+		m_generation[slot]++;
+		m_free.push_back(slot);
+	}
+	m_nodes.clear();
+	m_tags.clear();
+	m_slotOf.clear();
+}
+
+//---------------------------------------------------------------------------------------
+size_t EntityRegistry::size() const
+{
+	return m_nodes.size();
+}
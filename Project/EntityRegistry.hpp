@@ -0,0 +1,63 @@
+#pragma once
+
+#include "GeometryNode.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// What a node is to the game, as a bitmask so a query can ask for several at once.
+enum EntityTag : uint32_t {
+	ENTITY_PLAYER = 1 << 0,
+	ENTITY_ENEMY  = 1 << 1,
+	ENTITY_STATIC = 1 << 2  // walls, the plane, anything the game never moves
+};
+
+// Refers to a registered node.  A slot is reused after its node is removed, bumping
+// its generation, so a handle kept past the removal stops resolving instead of
+// pointing at whatever took the slot.
+struct EntityHandle {
+	uint32_t index;
+	uint32_t generation;
+};
+
+// The game's nodes and their tags, packed in dense arrays that are iterated by tag.
+// Add, remove and lookup are all O(1): removal swaps the last entity into the hole,
+// and each node remembers its slot (GeometryNode::m_entity).
+class EntityRegistry {
+public:
+	EntityRegistry();
+
+	EntityHandle add(GeometryNode* node, uint32_t tags);
+
+	// Forgets the node and unlinks it from its parent.  Returns false if the handle
+	// is stale.
+	bool remove(EntityHandle handle);
+
+	bool valid(EntityHandle handle) const;
+	GeometryNode* get(EntityHandle handle) const;
+
+	// The node's handle, or one that isn't valid if it was never added.
+	EntityHandle handleOf(const GeometryNode* node) const;
+
+	// Whether node is registered with any of tags.
+	bool is(const GeometryNode* node, uint32_t tags) const;
+
+	// Appends every node with any of tags to nodes.
+	void collect(uint32_t tags, std::vector<GeometryNode*> & nodes) const;
+
+	// Forgets every node, without unlinking them.  Handles from before stay stale.
+	void clear();
+
+	size_t size() const;
+
+private:
+	// dense, one entry per live entity
+	std::vector<GeometryNode*> m_nodes;
+	std::vector<uint32_t> m_tags;
+	std::vector<uint32_t> m_slotOf;
+
+	// by slot
+	std::vector<uint32_t> m_denseOf;
+	std::vector<uint32_t> m_generation;
+	std::vector<uint32_t> m_free;
+};
@@ -28,7 +28,11 @@ GeometryNode::GeometryNode(
 	  m_vertices(),
 	  m_faces(),
 	  loop(0),
-	  m_animationEnd(0)
+	  m_animationEnd(0),
+	  m_entity(ENTITY_NONE),
+	  m_texture(0),
+	  m_mesh(0),
+	  m_instanceGroup(INSTANCE_GROUP_NONE)
 {
 	m_nodeType = NodeType::GeometryNode;
 	hitbox->_pos = dvec3(0.0);
@@ -184,3 +188,18 @@ void GeometryNode::updateHitbox(float curtime){
 	vec4 lerp = p0 + (curtime - t)*(p1-p0);
 	hitbox->_pos = dvec3(get_inverse() * lerp);
 }
+
+glm::dvec3 GeometryNode::getHitboxOrigin(float curtime){
+	if (hasAnimation()){
+		int t = (int)curtime;
+		Keyframe* cur = getKeyframeAt(t);
+		Keyframe* next = getNextKeyframe(t);
+		vec4 p0 = cur->get_total_transform() * vec4(hitbox->_pos, 1);
+		vec4 p1 = next->get_total_transform() * vec4(hitbox->_pos, 1);
+		vec4 lerp = p0 + (curtime - t)*(p1-p0);
+		return dvec3(lerp);
+	}
+	// nodes with hitboxes hang off the root, so this is the world transform, and
+	// current even before update_world() catches up with this frame's moves
+	return dvec3(trans * vec4(vec3(hitbox->_pos), 1));
+}
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "SceneNode.hpp"
+#include <cstdint>
 #include <vector>
 #include <map>
 #include "Keyframe.hpp"
 
 class Keyframe;
 
+// GeometryNode::m_entity of a node that isn't in an EntityRegistry
+#define ENTITY_NONE UINT32_MAX
+
+// GeometryNode::m_instanceGroup of a node drawn on its own
+#define INSTANCE_GROUP_NONE UINT32_MAX
+
 //rectangular hitbox
 class Hitbox{
 public:
@@ -50,6 +57,8 @@ public:
 	bool hasAnimation();
 	void set_keyframe_parent_transform(const glm::mat4& parentTrans);
 	void updateHitbox(float curtime);
+	// centre of the hitbox, following the keyframes if animated
+	glm::dvec3 getHitboxOrigin(float curtime);
 
 
 	Keyframe* getKeyframeAt(int curtime);
@@ -79,5 +88,10 @@ public:
 
 	int loop;
 
+	uint32_t m_entity; // slot in the EntityRegistry
+	uint32_t m_texture; // handle from the TextureManager, 0 if untextured
+	uint32_t m_mesh;    // meshId's number in Project, 0 if there's no such mesh
+	uint32_t m_instanceGroup; // Project's instanced draw it's part of
+
 	//bool draw;
 };
@@ -0,0 +1,118 @@
+#include "ParticleSystem.hpp"
+
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+ParticleSystem::ParticleSystem(size_t capacity)
+	: m_capacity(capacity),
+	  m_end(0),
+	  m_alive(0),
+	  m_x(capacity), m_y(capacity), m_z(capacity),
+	  m_vx(capacity), m_vy(capacity), m_vz(capacity),
+	  m_size(capacity),
+	  m_life(capacity),
+	  m_live(capacity, 0)
+{
+	m_free.reserve(capacity);
+}
+
+//---------------------------------------------------------------------------------------
+bool ParticleSystem::emit(const glm::vec3 & position, const glm::vec3 & velocity, float size, int life)
+{
+	size_t i;
+	if (!m_free.empty()) {
+		i = m_free.back();
+		m_free.pop_back();
+	} else if (m_end < m_capacity) {
+		i = m_end++;
+	} else {
+		return false;
+	}
+
+	m_x[i] = position.x;
+	m_y[i] = position.y;
+	m_z[i] = position.z;
+	m_vx[i] = velocity.x;
+	m_vy[i] = velocity.y;
+	m_vz[i] = velocity.z;
+	m_size[i] = size;
+	m_life[i] = life;
+	m_live[i] = 1;
+	m_alive++;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void ParticleSystem::update(const glm::vec3 & acceleration, float killHeight)
+{
+	size_t n = m_end;
+
+	// free slots are integrated too, it's cheaper than branching around them
+	float * x = m_x.data();
+	float * y = m_y.data();
+	float * z = m_z.data();
+	float * vx = m_vx.data();
+	float * vy = m_vy.data();
+	float * vz = m_vz.data();
+	int * life = m_life.data();
+	for (size_t i = 0; i < n; i++) {
+		vx[i] += acceleration.x;
+		vy[i] += acceleration.y;
+		vz[i] += acceleration.z;
+		x[i] += vx[i];
+		y[i] += vy[i];
+		z[i] += vz[i];
+		life[i]--;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (m_live[i] && (life[i] <= 0 || y[i] < killHeight)) {
+			m_live[i] = 0;
+			m_free.push_back(i);
+			m_alive--;
+		}
+	}
+
+	// start over from the front once everything is dead
+	if (m_alive == 0) {
+		m_end = 0;
+		m_free.clear();
+	}
+}
+
+//---------------------------------------------------------------------------------------
+size_t ParticleSystem::gather(float * instances) const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_end; i++) {
+		if (!m_live[i]) continue;
+		float * instance = instances + count*PARTICLE_INSTANCE_FLOATS;
+		instance[0] = m_x[i];
+		instance[1] = m_y[i];
+		instance[2] = m_z[i];
+		instance[3] = m_size[i];
+		count++;
+	}
+	return count;
+}
+
+//---------------------------------------------------------------------------------------
+void ParticleSystem::clear()
+{
+	std::fill(m_live.begin(), m_live.begin() + m_end, 0);
+	m_free.clear();
+	m_end = 0;
+	m_alive = 0;
+}
+
+//---------------------------------------------------------------------------------------
+size_t ParticleSystem::size() const
+{
+	return m_alive;
+}
+
+//---------------------------------------------------------------------------------------
+size_t ParticleSystem::capacity() const
+{
+	return m_capacity;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Floats per instance handed to the GPU: world-space centre xyz, then cube size
+#define PARTICLE_INSTANCE_FLOATS 4
+
+// Fixed-capacity particle pool, stored as one array per attribute so the update is a
+// set of straight loops the compiler can vectorize.  Dead slots go on a free list and
+// are handed out again before the pool grows into fresh slots.
+class ParticleSystem {
+public:
+	ParticleSystem(size_t capacity);
+
+	// Returns false, dropping the particle, if every slot is taken.
+	bool emit(const glm::vec3 & position, const glm::vec3 & velocity, float size, int life);
+
+	// One frame: accelerate, move, age, then free the particles that died or fell
+	// below killHeight.
+	void update(const glm::vec3 & acceleration, float killHeight);
+
+	// Writes PARTICLE_INSTANCE_FLOATS floats per live particle, returns how many.
+	size_t gather(float * instances) const;
+
+	void clear();
+
+	size_t size() const;
+	size_t capacity() const;
+
+private:
+	size_t m_capacity;
+	size_t m_end;   // slots past this have never been used
+	size_t m_alive;
+
+	std::vector<float> m_x, m_y, m_z;
+	std::vector<float> m_vx, m_vy, m_vz;
+	std::vector<float> m_size;
+	std::vector<int> m_life;
+	std::vector<uint8_t> m_live;
+
+	std::vector<uint32_t> m_free;
+};
@@ -3,6 +3,7 @@
 using namespace std;
 
 #include "cs488-framework/GlErrorCheck.hpp"
+#include "cs488-framework/GlState.hpp"
 #include "cs488-framework/MathUtils.hpp"
 
 #include "JointNode.hpp"
@@ -18,9 +19,14 @@ using namespace std;
 #include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <cstddef>
 
 #define RENDER_HITBOX false
 
+// frames a particle lives, and the height it's dropped at if it falls that far first
+#define PARTICLE_LIFE 100000
+#define PARTICLE_KILL_HEIGHT -20.0f
+
 using namespace glm;
 
 static bool show_gui = true;
@@ -41,13 +47,10 @@ Project::Project(const std::string & luaSceneFile)
 	  m_normalAttribLocation(0), 
 	  m_textureAttrribLocation(0),
 	  m_vao_meshData(0),
-	  m_vbo_vertexPositions(0),
-	  m_vbo_vertexNormals(0),
-	  m_vbo_vertexUV(0),
+	  m_vbo_vertexData(0),
+	  m_ebo_meshIndices(0),
 	  m_vao_arcCircle(0),
 	  m_vbo_arcCircle(0),
-	  //m_vao_particle(0),
-	  //m_vbo_particle(0),
 	  m_mouseX(0.0),
 	  m_mouseY(0.0),
 	  m_zbuffer(true),
@@ -57,6 +60,7 @@ Project::Project(const std::string & luaSceneFile)
 	  lmb_down(false),
 	  mmb_down(false),
 	  rmb_down(false),
+	  m_shadowView(mat4()),
 	  m_translation(mat4()),
 	  m_rotation(mat4()),
 	  m_shotX(0),
@@ -66,25 +70,43 @@ Project::Project(const std::string & luaSceneFile)
 	  m_playerNode(nullptr),
 	  m_framebuffer(0),
 	  m_shadowMap(0),
-	  m_shadowView(mat4()),
+	  m_staticShadowFramebuffer(0),
+	  m_staticShadowMap(0),
+	  m_staticShadowsDirty(true),
+	  m_particles(MAX_PARTICLES),
+	  m_particleInstances(MAX_PARTICLES*PARTICLE_INSTANCE_FLOATS),
+	  m_vao_particles(0),
+	  m_vbo_particleInstances(0),
+	  m_particle_positionAttribLocation(0),
+	  m_particle_normalAttribLocation(0),
+	  m_particle_instanceAttribLocation(0),
+	  m_projectiles(MAX_PROJECTILES),
+	  m_projectileInstances(MAX_PROJECTILES*PROJECTILE_INSTANCE_FLOATS),
+	  m_vao_projectiles(0),
+	  m_vbo_projectileInstances(0),
+	  m_projectile_positionAttribLocation(0),
+	  m_projectile_normalAttribLocation(0),
+	  m_projectile_instanceAttribLocation(0),
+	  m_projectile_velocityAttribLocation(0),
+	  m_vao_instanced(0),
+	  m_vbo_instanceModels(0),
+	  m_instancesDirty(true),
 	  m_doShadowMapping(false),
 	  m_drawReflection(false),
 	  m_drawTexture(false),
 	  m_reflectedView(mat4()),
-	  m_texture(0),
 	  e(rd()),
 	  dis(0,2),
-	  shotId(0),
 	  lives(3),
 	  m_particles_on_all_collisions(false),
 	  danmaku(true),
 	  moving_enemies(false),
 	  m_shadow_positionAttribLocation(0)
-	  //particleCount(0),
-	  //lastUsedParticle(0)
-	  //particles(new Particle[MAX_PARTICLES]),
-	  //particle_positions(new float[3*MAX_PARTICLES])
 {
+	for (int i = 0; i < CULL_PASSES; i++){
+		m_drawnCount[i] = 0;
+		m_culledCount[i] = 0;
+	}
 
 }
 
@@ -106,9 +128,14 @@ void Project::init()
 
 	createShaderProgram();
 
+	m_frameData.create(FRAME_DATA_BINDING, sizeof(FrameData));
+	m_drawData.create(DRAW_DATA_BINDING, DRAW_DATA_RING_SIZE);
+
 	glGenVertexArrays(1, &m_vao_arcCircle);
 	glGenVertexArrays(1, &m_vao_meshData);
-//	glGenVertexArrays(1, &m_vao_particle);
+	glGenVertexArrays(1, &m_vao_particles);
+	glGenVertexArrays(1, &m_vao_projectiles);
+	glGenVertexArrays(1, &m_vao_instanced);
 	enableVertexShaderInputSlots();
 
 	processLuaSceneFile(m_luaSceneFile);
@@ -116,19 +143,27 @@ void Project::init()
 	// Load and decode all .obj files at once here.  You may add additional .obj files to
 	// this list in order to support rendering additional mesh types.  All vertex
 	// positions, and normals will be extracted and stored within the MeshConsolidator
-	// class.
-	unique_ptr<MeshConsolidator> meshConsolidator (new MeshConsolidator{
+	// class, welded into indexed meshes, ordered for the vertex cache and packed into
+	// one interleaved PackedVertex array.
+	unique_ptr<MeshConsolidator> meshConsolidator (new MeshConsolidator({
 			getAssetFilePath("cube.obj"),
 			getAssetFilePath("sphere.obj"),
 			getAssetFilePath("suzanne.obj"),
 			getAssetFilePath("plane.obj"),
 			getAssetFilePath("player.obj")
-	});
+	}, MESH_INDEXED | MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW | MESH_INTERLEAVED));
 
 
 	// Acquire the BatchInfoMap from the MeshConsolidator.
 	meshConsolidator->getBatchInfoMap(m_batchInfoMap);
 
+	// meshes by number for the render queue, 0 is for mesh ids with no .obj
+	m_meshes.assign(1, BatchInfo());
+	for (const auto & batch : m_batchInfoMap){
+		m_meshIndex[batch.first] = m_meshes.size();
+		m_meshes.push_back(batch.second);
+	}
+
 	// Take all vertex data within the MeshConsolidator and upload it to VBOs on the GPU.
 	uploadVertexDataToVbos(*meshConsolidator);
 
@@ -140,35 +175,15 @@ void Project::init()
 
 	initLightSources();
 
-	{
-		glGenFramebuffers(1, &m_framebuffer);
-		//glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
-		CHECK_GL_ERRORS;
-	}
+	initShadowMaps();
 
-	{
-		glGenTextures(1, &m_shadowMap);
-		//glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-		CHECK_GL_ERRORS;
-	}
+	registerEntities((SceneNode*)&*m_rootNode);
+	loadTextures();
 
-	{
-		glGenTextures(1, &m_texture);
-		//glBindTexture(GL_TEXTURE_2D, m_texture);
-		CHECK_GL_ERRORS;
-	}
-
-	findPlayerNode((SceneNode*)&*m_rootNode);
-
-	findPlaneNode((SceneNode*)&*m_rootNode);
-
-	findEnemyNodes((SceneNode*)&*m_rootNode);
-
-	findSpecialObjects((SceneNode*)&*m_rootNode);
-
-	Bounds bounds(m_plane->hitbox->_pos, m_plane->hitbox->_maxXYZ);
-	m_collisionTree = new CollisionTreeNode(bounds, 0);
-	m_collisionTree->construct((SceneNode*)&*m_rootNode);
+	m_rootNode->update_world();
+	buildBroadphase();
+	m_staticShadowsDirty = true;
+	m_instancesDirty = true;
 
 	m_start_time = clock();
 
@@ -215,10 +230,20 @@ void Project::createShaderProgram()
 	m_shader_shadow.attachFragmentShader( getAssetFilePath("shadow_FragmentShader.fs").c_str() );
 	m_shader_shadow.link();
 
-	/*m_particle_shader.generateProgramObject();
-	m_particle_shader.attachVertexShader( getAssetFilePath("particle_vs.vs").c_str());
-	m_particle_shader.attachFragmentShader( getAssetFilePath("particle_fs.fs").c_str() );
-	m_particle_shader.link();*/
+	m_shader_particles.generateProgramObject();
+	m_shader_particles.attachVertexShader( getAssetFilePath("particle_VertexShader.vs").c_str() );
+	m_shader_particles.attachFragmentShader( getAssetFilePath("particle_FragmentShader.fs").c_str() );
+	m_shader_particles.link();
+
+	m_shader_projectiles.generateProgramObject();
+	m_shader_projectiles.attachVertexShader( getAssetFilePath("projectile_VertexShader.vs").c_str() );
+	m_shader_projectiles.attachFragmentShader( getAssetFilePath("projectile_FragmentShader.fs").c_str() );
+	m_shader_projectiles.link();
+
+	m_shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	m_shader.bindUniformBlock("DrawData", DRAW_DATA_BINDING);
+	m_shader_particles.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	m_shader_projectiles.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
 }
 
 //----------------------------------------------------------------------------------------
@@ -226,7 +251,7 @@ void Project::enableVertexShaderInputSlots()
 {
 	//-- Enable input slots for m_vao_meshData:
 	{
-		glBindVertexArray(m_vao_meshData);
+		GlState::bindVertexArray(m_vao_meshData);
 
 		// Enable the vertex shader attribute location for "position" when rendering.
 		m_positionAttribLocation = m_shader.getAttribLocation("position");
@@ -250,7 +275,7 @@ void Project::enableVertexShaderInputSlots()
 
 	//-- Enable input slots for m_vao_arcCircle:
 	{
-		glBindVertexArray(m_vao_arcCircle);
+		GlState::bindVertexArray(m_vao_arcCircle);
 
 		// Enable the vertex shader attribute location for "position" when rendering.
 		m_arc_positionAttribLocation = m_shader_arcCircle.getAttribLocation("position");
@@ -259,65 +284,95 @@ void Project::enableVertexShaderInputSlots()
 		CHECK_GL_ERRORS;
 	}
 
-	/*{
-		glBindVertexArray(m_vao_particle);
+	//-- Enable input slots for m_vao_particles:
+	{
+		GlState::bindVertexArray(m_vao_particles);
 
-		m_particleAttrribLocation = m_particle_shader.getAttribLocation("position");
-		glEnableVertexAttribArray(m_particleAttrribLocation);
-		//bind stuff later
-	}*/
+		m_particle_positionAttribLocation = m_shader_particles.getAttribLocation("position");
+		glEnableVertexAttribArray(m_particle_positionAttribLocation);
 
-	// Restore defaults
-	glBindVertexArray(0);
-}
+		m_particle_normalAttribLocation = m_shader_particles.getAttribLocation("normal");
+		glEnableVertexAttribArray(m_particle_normalAttribLocation);
 
-//----------------------------------------------------------------------------------------
-void Project::uploadVertexDataToVbos (
-		const MeshConsolidator & meshConsolidator
-) {
-	// Generate VBO to store all vertex position data
+		m_particle_instanceAttribLocation = m_shader_particles.getAttribLocation("instance");
+		glEnableVertexAttribArray(m_particle_instanceAttribLocation);
+
+		CHECK_GL_ERRORS;
+	}
+
+	//-- Enable input slots for m_vao_projectiles:
 	{
-		glGenBuffers(1, &m_vbo_vertexPositions);
+		GlState::bindVertexArray(m_vao_projectiles);
 
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
+		m_projectile_positionAttribLocation = m_shader_projectiles.getAttribLocation("position");
+		glEnableVertexAttribArray(m_projectile_positionAttribLocation);
 
-		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumVertexPositionBytes(),
-				meshConsolidator.getVertexPositionDataPtr(), GL_STATIC_DRAW);
+		m_projectile_normalAttribLocation = m_shader_projectiles.getAttribLocation("normal");
+		glEnableVertexAttribArray(m_projectile_normalAttribLocation);
+
+		m_projectile_instanceAttribLocation = m_shader_projectiles.getAttribLocation("instance");
+		glEnableVertexAttribArray(m_projectile_instanceAttribLocation);
+
+		m_projectile_velocityAttribLocation = m_shader_projectiles.getAttribLocation("instanceVelocity");
+		glEnableVertexAttribArray(m_projectile_velocityAttribLocation);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
-	// Generate VBO to store all vertex normal data
+	//-- Enable input slots for m_vao_instanced, the mesh's plus a matrix per instance:
 	{
-		glGenBuffers(1, &m_vbo_vertexNormals);
+		GlState::bindVertexArray(m_vao_instanced);
+
+		glEnableVertexAttribArray(m_positionAttribLocation);
+		glEnableVertexAttribArray(m_shadow_positionAttribLocation);
+		glEnableVertexAttribArray(m_normalAttribLocation);
+		glEnableVertexAttribArray(m_textureAttrribLocation);
+		for (int i = 0; i < 4; i++){
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexNormals);
+		CHECK_GL_ERRORS;
+	}
 
-		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumVertexNormalBytes(),
-				meshConsolidator.getVertexNormalDataPtr(), GL_STATIC_DRAW);
+	// Restore defaults
+	GlState::bindVertexArray(0);
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+//----------------------------------------------------------------------------------------
+void Project::uploadVertexDataToVbos (
+		const MeshConsolidator & meshConsolidator
+) {
+	// Generate VBO to store all vertex data, interleaved as PackedVertex.
+	{
+		glGenBuffers(1, &m_vbo_vertexData);
+
+		GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexData);
+
+		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumPackedVertexBytes(),
+				meshConsolidator.getPackedVertexDataPtr(), GL_STATIC_DRAW);
+
+		GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
-	// Generate VBO to store all texture UV data
+	// Generate the index buffer.  It's filled through GL_ARRAY_BUFFER since there's no
+	// vertex array bound to hold a GL_ELEMENT_ARRAY_BUFFER binding yet.
 	{
-		glGenBuffers(1, &m_vbo_vertexUV);
+		glGenBuffers(1, &m_ebo_meshIndices);
 
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexUV);
+		GlState::bindBuffer(GL_ARRAY_BUFFER, m_ebo_meshIndices);
 
-		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumVertexUVBytes(),
-				meshConsolidator.getVertexUVDataPtr(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, meshConsolidator.getNumIndexBytes(),
+				meshConsolidator.getIndexDataPtr(), GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
 	// Generate VBO to store the trackball circle.
 	{
 		glGenBuffers( 1, &m_vbo_arcCircle );
-		glBindBuffer( GL_ARRAY_BUFFER, m_vbo_arcCircle );
+		GlState::bindBuffer( GL_ARRAY_BUFFER, m_vbo_arcCircle );
 
 		float *pts = new float[ 2 * CIRCLE_PTS ];
 		for( size_t idx = 0; idx < CIRCLE_PTS; ++idx ) {
@@ -328,72 +383,147 @@ void Project::uploadVertexDataToVbos (
 
 		glBufferData(GL_ARRAY_BUFFER, 2*CIRCLE_PTS*sizeof(float), pts, GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
 	}
 
-	// Generate VBO to store the particles.
-	/*{
-		glGenBuffers( 1, &m_vbo_particle );
-		glBindBuffer( GL_ARRAY_BUFFER, m_vbo_particle );
+	// Generate VBO for the particle instances, refilled every frame.
+	{
+		glGenBuffers( 1, &m_vbo_particleInstances );
+		GlState::bindBuffer( GL_ARRAY_BUFFER, m_vbo_particleInstances );
 
-		glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES*3*sizeof(float), NULL, GL_STREAM_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES*PARTICLE_INSTANCE_FLOATS*sizeof(float), NULL, GL_STREAM_DRAW);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 		CHECK_GL_ERRORS;
-	}*/
+	}
+
+	// Generate VBO for the shot instances, refilled every frame.
+	{
+		glGenBuffers( 1, &m_vbo_projectileInstances );
+		GlState::bindBuffer( GL_ARRAY_BUFFER, m_vbo_projectileInstances );
+
+		glBufferData(GL_ARRAY_BUFFER, MAX_PROJECTILES*PROJECTILE_INSTANCE_FLOATS*sizeof(float), NULL, GL_STREAM_DRAW);
+
+		GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERRORS;
+	}
+
+	// Generate VBO for the static instances, filled by buildInstanceGroups.
+	glGenBuffers( 1, &m_vbo_instanceModels );
+}
+
+//----------------------------------------------------------------------------------------
+// Points the given locations at the PackedVertex fields of the bound GL_ARRAY_BUFFER,
+// skipping any that are -1.
+static void mapPackedVertexAttribs(GLint position, GLint normal, GLint uv)
+{
+	GLsizei stride = sizeof(PackedVertex);
+	if (position != -1) {
+		glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, stride,
+				(void *)offsetof(PackedVertex, position));
+	}
+	if (normal != -1) {
+		glVertexAttribPointer(normal, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+				(void *)offsetof(PackedVertex, normal));
+	}
+	if (uv != -1) {
+		glVertexAttribPointer(uv, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+				(void *)offsetof(PackedVertex, uv));
+	}
 }
 
 //----------------------------------------------------------------------------------------
 void Project::mapVboDataToVertexShaderInputLocations()
 {
 	// Bind VAO in order to record the data mapping.
-	glBindVertexArray(m_vao_meshData);
-
-	// Tell GL how to map data from the vertex buffer "m_vbo_vertexPositions" into the
-	// "position" vertex attribute location for any bound vertex shader program.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
-	glVertexAttribPointer(m_positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	GlState::bindVertexArray(m_vao_meshData);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexPositions);
-	glVertexAttribPointer(m_shadow_positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	// Tell GL how to map data from the vertex buffer "m_vbo_vertexData" into the
+	// "position", "normal" and "uv" vertex attribute locations for any bound vertex
+	// shader program.
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexData);
+	mapPackedVertexAttribs(m_positionAttribLocation, m_normalAttribLocation, m_textureAttrribLocation);
+	mapPackedVertexAttribs(m_shadow_positionAttribLocation, -1, -1);
 
-	// Tell GL how to map data from the vertex buffer "m_vbo_vertexNormals" into the
-	// "normal" vertex attribute location for any bound vertex shader program.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexNormals);
-	glVertexAttribPointer(m_normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexUV);
-	glVertexAttribPointer(m_textureAttrribLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+	// the index buffer binding is part of the VAO
+	GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo_meshIndices);
 
 	//-- Unbind target, and restore default values:
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::bindVertexArray(0);
 
 	CHECK_GL_ERRORS;
 
 	// Bind VAO in order to record the data mapping.
-	glBindVertexArray(m_vao_arcCircle);
+	GlState::bindVertexArray(m_vao_arcCircle);
 
 	// Tell GL how to map data from the vertex buffer "m_vbo_arcCircle" into the
 	// "position" vertex attribute location for any bound vertex shader program.
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo_arcCircle);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_arcCircle);
 	glVertexAttribPointer(m_arc_positionAttribLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
 	//-- Unbind target, and restore default values:
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::bindVertexArray(0);
 
 	CHECK_GL_ERRORS;
 
-	/*glBindVertexArray(m_vao_particle);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vao_particle);
-	glVertexAttribPointer(m_particleAttrribLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	// Particles share the mesh VBOs, plus one instance attribute stepped per cube.
+	GlState::bindVertexArray(m_vao_particles);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexData);
+	mapPackedVertexAttribs(m_particle_positionAttribLocation, m_particle_normalAttribLocation, -1);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_particleInstances);
+	glVertexAttribPointer(m_particle_instanceAttribLocation, PARTICLE_INSTANCE_FLOATS, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glVertexAttribDivisor(m_particle_instanceAttribLocation, 1);
+
+	GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo_meshIndices);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::bindVertexArray(0);
+
+	CHECK_GL_ERRORS;
+
+	// Shots too, with two instance attributes interleaved in one buffer.
+	GlState::bindVertexArray(m_vao_projectiles);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexData);
+	mapPackedVertexAttribs(m_projectile_positionAttribLocation, m_projectile_normalAttribLocation, -1);
+
+	GLsizei stride = PROJECTILE_INSTANCE_FLOATS*sizeof(float);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_projectileInstances);
+	glVertexAttribPointer(m_projectile_instanceAttribLocation, 4, GL_FLOAT, GL_FALSE, stride, nullptr);
+	glVertexAttribDivisor(m_projectile_instanceAttribLocation, 1);
+	glVertexAttribPointer(m_projectile_velocityAttribLocation, 4, GL_FLOAT, GL_FALSE, stride, (void *)(4*sizeof(float)));
+	glVertexAttribDivisor(m_projectile_velocityAttribLocation, 1);
+
+	GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo_meshIndices);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::bindVertexArray(0);
+
+	CHECK_GL_ERRORS;
+
+	// Instanced static meshes share the mesh VBOs too, the matrices are pointed at
+	// each group's own by bindInstanceGroup.
+	GlState::bindVertexArray(m_vao_instanced);
+
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_vertexData);
+	mapPackedVertexAttribs(m_positionAttribLocation, m_normalAttribLocation, m_textureAttrribLocation);
+	mapPackedVertexAttribs(m_shadow_positionAttribLocation, -1, -1);
+
+	for (int i = 0; i < 4; i++){
+		glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+	}
+
+	GlState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo_meshIndices);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::bindVertexArray(0);
 
-	CHECK_GL_ERRORS;*/
+	CHECK_GL_ERRORS;
 
 }
 
@@ -426,41 +556,95 @@ void Project::initLightSources() {
 		m_light.position,
 		glm::vec3( 0.0f, 0.0f, 0.0f ),
 		glm::vec3( 0.0f, 1.0f, 0.0f ) );
+
+	mat4 ortho_mat = glm::ortho<float>(-20, 20, -25, 25, -25, 25); //glm::perspective(degreesToRadians(60.0f), aspect, 0.1f, 100.0f);
+	m_ortho_shadowView = ortho_mat * m_shadowView;// * mat4(1.0);
+	m_staticShadowsDirty = true;
+}
+
+//----------------------------------------------------------------------------------------
+// Two depth maps: walls and other static casters are drawn into the cached one only
+// when they or the light change, and each frame's shadow map starts as a copy of it.
+void Project::initShadowMaps() {
+	GLuint framebuffers[2];
+	GLuint textures[2];
+	glGenFramebuffers(2, framebuffers);
+	glGenTextures(2, textures);
+	m_framebuffer = framebuffers[0];
+	m_shadowMap = textures[0];
+	m_staticShadowFramebuffer = framebuffers[1];
+	m_staticShadowMap = textures[1];
+	CHECK_GL_ERRORS;
+
+	for (int i = 0; i < 2; i++){
+		GlState::bindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+		CHECK_GL_ERRORS;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		CHECK_GL_ERRORS;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[i], 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		CHECK_GL_ERRORS;
+	}
+	GlState::bindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 //----------------------------------------------------------------------------------------
 void Project::uploadCommonSceneUniforms() {
 	m_shader.enable();
 	{
-		//-- Set Perpsective matrix uniform for the scene:
-		GLint location = m_shader.getUniformLocation("Perspective");
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(m_perpsective));
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("picking");
+		GLint location = m_shader.getUniformLocation("picking");
 		glUniform1i( location, m_picking ? 1 : 0 );
 		CHECK_GL_ERRORS;
+	}
+	m_shader.disable();
 
-		if (!m_picking){
-			//-- Set LightSource uniform for the scene:
-			{
-				location = m_shader.getUniformLocation("light.position");
-				glUniform3fv(location, 1, value_ptr(m_light.position));
-				location = m_shader.getUniformLocation("light.rgbIntensity");
-				glUniform3fv(location, 1, value_ptr(m_light.rgbIntensity));
-				CHECK_GL_ERRORS;
-			}
+	m_shader_particles.enable();
+	{
+		GLint location = m_shader_particles.getUniformLocation("colour");
+		vec3 colour(1.0, 1.0, 0.0);
+		glUniform3fv(location, 1, value_ptr(colour));
+		location = m_shader_particles.getUniformLocation("shininess");
+		glUniform1f(location, 100);
+		CHECK_GL_ERRORS;
+	}
+	m_shader_particles.disable();
 
-			//-- Set background light ambient intensity
-			{
-				location = m_shader.getUniformLocation("ambientIntensity");
-				vec3 ambientIntensity(0.05f);
-				glUniform3fv(location, 1, value_ptr(ambientIntensity));
-				CHECK_GL_ERRORS;
-			}
-		}
+	m_shader_projectiles.enable();
+	{
+		// indexed by ProjectileOwner
+		GLint location = m_shader_projectiles.getUniformLocation("colours");
+		vec3 colours[2] = { vec3(1.0, 1.0, 0.0), vec3(1.0, 0.3, 0.1) };
+		glUniform3fv(location, 2, value_ptr(colours[0]));
+		location = m_shader_projectiles.getUniformLocation("shininess");
+		glUniform1f(location, 100);
+		CHECK_GL_ERRORS;
 	}
-	m_shader.disable();
+	m_shader_projectiles.disable();
+}
+
+//----------------------------------------------------------------------------------------
+// The FrameData block every program reads its camera and light from, once m_view and
+// m_depthBias are set for the frame.
+void Project::uploadFrameUniforms() {
+	FrameData frame;
+	frame.perspective = m_perpsective;
+	frame.view = m_view;
+	frame.depthBias = m_depthBias;
+	frame.lightPosition = m_light.position;
+	frame.lightRgbIntensity = m_light.rgbIntensity;
+	frame.ambientIntensity = vec3(0.05f);
+	m_frameData.update(&frame, sizeof(frame));
 }
 
 //----------------------------------------------------------------------------------------
@@ -479,48 +663,9 @@ void Project::appLogic()
 	m_current_time = clock() - m_start_time;
 	m_current_time_secs = ((float)m_current_time)/CLOCKS_PER_SEC;
 
-	if (lmb_down && m_playerNode != nullptr && lives > 0){
-		Shot* shot = new Shot(m_playerNode, shotId);
-		//cout << "Added shot " << shotId << endl;
-		shotId++;
-		if (shotId > 10000){
-			shotId = 0;
-		}
-		m_shots.emplace_back(shot);
-		m_playerNode->add_child(shot->_self);
-	}
-	
-	//if (m_current_time_secs - (int)m_current_time_secs < std::numeric_limits<float>::epsilon()){
-	for (auto& enemy: m_enemies){
-		moveEnemy(enemy);
-		if (danmaku){
-			Shot* shot = new Shot(enemy, shotId);
-			shotId++;
-			if (shotId > 10000){
-				shotId = 0;
-			}
-			m_enemyShots.emplace_back(shot);
-			enemy->add_child(shot->_self);
-		}
-	}
-	
-	//moveEnemy(m_enemy1);
-	m_collisionTree->clear();
-	m_collisionTree->construct((SceneNode*)&*m_rootNode, m_current_time_secs);
+	m_movers.clear();
+	m_moverSteps.clear();
 
-	for (Shot* shot : m_shots){
-		shot->advance();
-		//cout << "shot " << shot->_self->m_name << " advancing " << endl;
-		checkShotCollisions(shot);
-	}
-
-	for (Shot* shot : m_enemyShots){
-		shot->advance();
-		//cout << "shot " << shot->_self->m_name << " advancing " << endl;
-		checkShotCollisions(shot, true);
-	}
-
-	moveParticles();
 	double moveX = 0;
 	double moveZ = 0;
 
@@ -542,6 +687,31 @@ void Project::appLogic()
 	if (moveX != 0 || moveZ != 0)
 	movePlayer(moveX, moveZ);
 
+	if (lmb_down && m_playerNode != nullptr && lives > 0){
+		spawnShot(m_playerNode, ProjectileOwner::Player);
+	}
+	
+	//if (m_current_time_secs - (int)m_current_time_secs < std::numeric_limits<float>::epsilon()){
+	m_enemies.clear();
+	m_entities.collect(ENTITY_ENEMY, m_enemies);
+	for (auto& enemy: m_enemies){
+		moveEnemy(enemy);
+		if (danmaku){
+			spawnShot(enemy, ProjectileOwner::Enemy);
+		}
+	}
+	
+	//moveEnemy(m_enemy1);
+	resolveCollisions();
+
+	m_rootNode->update_world();
+	m_broadphase.update(m_current_time_secs);
+
+	m_projectiles.advance();
+	collideShots();
+
+	moveParticles();
+
 	uploadCommonSceneUniforms();
 }
 
@@ -582,6 +752,14 @@ void Project::guiLogic()
 
 		ImGui::Text("Lives: %s", livesDisplay.c_str());
 
+		ImGui::Text("Drawn/culled: camera %d/%d, shadow %d/%d, reflection %d/%d",
+			(int)m_drawnCount[CULL_CAMERA], (int)m_culledCount[CULL_CAMERA],
+			(int)m_drawnCount[CULL_SHADOW], (int)m_culledCount[CULL_SHADOW],
+			(int)m_drawnCount[CULL_REFLECTION], (int)m_culledCount[CULL_REFLECTION]);
+
+		const GlState::Counters & glCalls = GlState::lastFrame();
+		ImGui::Text("GL state calls issued/skipped: %u/%u", glCalls.issued, glCalls.skipped);
+
 
 	ImGui::End();
 
@@ -628,153 +806,106 @@ void Project::guiLogic()
 }
 
 //----------------------------------------------------------------------------------------
-// Update mesh specific shader uniforms:
-static void updateShaderUniforms(
-		const ShaderProgram & shader,
+void DrawData::setNormalMatrix(const glm::mat3 & m) {
+	for (int i = 0; i < 3; i++){
+		normalMatrix[i] = vec4(m[i], 0.0f);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Mesh specific shader uniforms, for the DrawData block:
+static void fillDrawData(
+		DrawData & data,
 		const GeometryNode & node,
-		const glm::mat4 & viewMatrix, 
-		bool shadow, bool gettingShadows,
-		bool inReflectionMode = false
+		const glm::mat4 & model,
+		const glm::mat4 & viewMatrix,
+		float shade = 1.0f
 ) {
+	data.modelView = viewMatrix * model;
+	data.nextModelView = data.modelView;
+	data.model = model;
+	data.setNormalMatrix(glm::transpose(glm::inverse(mat3(data.modelView))));
+
+	data.kd = shade * node.material.kd;
+	data.ks = shade * node.material.ks;
+	data.shininess = node.material.shininess;
+	data.alpha = node.material.alpha;
+
+	data.time0 = 0;
+	data.time1 = 0;
+	data.curTime = 0;
+	data.instanced = 0;
+}
 
-	shader.enable();
-	{
-
-		GLuint location;
-		//-- Set ModelView matrix:
-		location = shader.getUniformLocation("ModelView");
-		mat4 modelView = viewMatrix * node.trans;
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-		CHECK_GL_ERRORS;
-
-		location = shader.getUniformLocation("curTime");
-		glUniform1f(location, 0);
-		CHECK_GL_ERRORS;
-
-		location = shader.getUniformLocation("time0");
-		glUniform1f(location, 0);
-		CHECK_GL_ERRORS;
-
-		GLuint draw_shadows = shader.getUniformLocation("drawShadows");
-		glUniform1f(draw_shadows, shadow && !inReflectionMode);
-		CHECK_GL_ERRORS;
-
-		if(!gettingShadows){
-			//-- Set NormMatrix:
-			location = shader.getUniformLocation("NormalMatrix");
-			mat3 normalMatrix = glm::transpose(glm::inverse(mat3(modelView)));
-			glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(normalMatrix));
-			CHECK_GL_ERRORS;
-
-
-			//-- Set Material values:
-			location = shader.getUniformLocation("material.kd");
-			vec3 kd = inReflectionMode ? 0.5*node.material.kd : node.material.kd;
-			glUniform3fv(location, 1, value_ptr(kd));
-			CHECK_GL_ERRORS;
-			location = shader.getUniformLocation("material.ks");
-			vec3 ks = inReflectionMode ? 0.5*node.material.ks : node.material.ks;
-			glUniform3fv(location, 1, value_ptr(ks));
-			CHECK_GL_ERRORS;
-			location = shader.getUniformLocation("material.shininess");
-			glUniform1f(location, node.material.shininess);
-			CHECK_GL_ERRORS;
-			location = shader.getUniformLocation("material.alpha");
-			glUniform1f(location, node.material.alpha);
-		
-		}
+//----------------------------------------------------------------------------------------
+// Meshes are indexed, see init().
+static void drawBatch(const BatchInfo & batchInfo, GLenum mode, GLsizei instances = 1) {
+	const void * offset = (const void *)(batchInfo.startIndex*sizeof(GLuint));
+	if (instances == 1){
+		glDrawElements(mode, batchInfo.numIndices, GL_UNSIGNED_INT, offset);
+	} else {
+		glDrawElementsInstanced(mode, batchInfo.numIndices, GL_UNSIGNED_INT, offset, instances);
 	}
-
-	shader.disable();
-
 }
 
 //----------------------------------------------------------------------------------------
-void Project::getShadowMap(SceneNode* root){
-
-	//glGenFramebuffers(1, &m_framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+void Project::getShadowMap(){
+	glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+	GlState::bindVertexArray(m_vao_meshData);
+
+	if (m_staticShadowsDirty){
+		m_shadowCasters.clear();
+		m_entities.collect(ENTITY_STATIC, m_shadowCasters);
+		m_shadowCasters.erase(std::remove_if(m_shadowCasters.begin(), m_shadowCasters.end(),
+			[&](GeometryNode* node){ return node == m_plane || node->hasAnimation(); }),
+			m_shadowCasters.end());
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_staticShadowFramebuffer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		getNodeShadows(m_shadowCasters);
+		getInstanceShadows();
+		m_staticShadowsDirty = false;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_staticShadowFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glBlitFramebuffer(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 	CHECK_GL_ERRORS;
 
-	//glGenTextures(1, &m_shadowMap);
-	glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-	CHECK_GL_ERRORS;	
-	
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-	//CHECK_GL_ERRORS;
-	CHECK_GL_ERRORS;
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-	CHECK_GL_ERRORS;
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// then only what moves
+	m_shadowCasters.clear();
+	m_entities.collect(ENTITY_PLAYER | ENTITY_ENEMY | ENTITY_STATIC, m_shadowCasters);
+	m_shadowCasters.erase(std::remove_if(m_shadowCasters.begin(), m_shadowCasters.end(),
+		[&](GeometryNode* node){
+			return node == m_plane || (m_entities.is(node, ENTITY_STATIC) && !node->hasAnimation());
+		}),
+		m_shadowCasters.end());
 
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadowMap, 0);
-	CHECK_GL_ERRORS;
-	glDrawBuffer(GL_NONE);
-	CHECK_GL_ERRORS;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);  
-	/*if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		return false;*/
-
-	mat4 ortho_mat = glm::ortho<float>(-20, 20, -25, 25, -25, 25); //glm::perspective(degreesToRadians(60.0f), aspect, 0.1f, 100.0f);
-	//m_shadowView already set
-	m_ortho_shadowView = ortho_mat * m_shadowView;// * mat4(1.0);
-	//cout << "generating shadows" << endl;
 	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
-	glViewport(0,0,1024,1024);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	//glClear(GL_DEPTH_BUFFER_BIT);
-	glBindVertexArray(m_vao_meshData);
-	getNodeShadows(root);
-	
-	glBindVertexArray(0);
+	getNodeShadows(m_shadowCasters);
+
 	CHECK_GL_ERRORS;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	CHECK_GL_ERRORS;
-	//glViewport(0,0,1024,1024);
 	glViewport(0,0, m_windowWidth, m_windowHeight);
 }
 
 //----------------------------------------------------------------------------------------
-void Project::getNodeShadows(SceneNode* root){
-	if (root->m_nodeType == NodeType::GeometryNode){
-		GeometryNode * geometryNode = static_cast<GeometryNode *>(root);
-		if (geometryNode != m_plane)
-		{
-		//updateShaderUniforms(m_shader_shadow, *geometryNode, m_ortho_shadowView, true);
-		m_shader_shadow.enable();
-		GLint location = m_shader_shadow.getUniformLocation("ModelView");
-		mat4 modelView = m_ortho_shadowView * geometryNode->trans;
+void Project::getNodeShadows(const std::vector<GeometryNode*> & casters){
+	m_shader_shadow.enable();
+	GLint location = m_shader_shadow.getUniformLocation("ModelView");
+	for (GeometryNode* geometryNode : casters){
+		if (geometryNode->m_instanceGroup != INSTANCE_GROUP_NONE) continue;
+		if (!isVisible(CULL_SHADOW, geometryNode)) continue;
+		mat4 modelView = m_ortho_shadowView * geometryNode->get_world_transform();
 		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-		CHECK_GL_ERRORS;
-		m_shader_shadow.disable();
-
-		BatchInfo batchInfo = m_batchInfoMap[geometryNode->meshId];
-
-			//-- Now render the mesh:
-		m_shader_shadow.enable();
-		glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
 
-		m_shader_shadow.disable();
-		}
-
-		if (geometryNode == m_playerNode){
-			return; //don't draw shots twice
-		} else if (geometryNode->isEnemy()){
-			return; // shots drawn later
-		}
-
-	}
-	for (SceneNode *child : root->children){
-		child->set_transform(root->get_transform() * child->get_transform());
-		getNodeShadows(child);
-		child->set_transform(glm::inverse(root->get_transform()) * child->get_transform());
+		const BatchInfo & batchInfo = m_meshes[geometryNode->m_mesh];
+		drawBatch(batchInfo, GL_TRIANGLES);
 	}
+	CHECK_GL_ERRORS;
+	m_shader_shadow.disable();
 }
 
 //----------------------------------------------------------------------------------------
@@ -783,18 +914,27 @@ void Project::getNodeShadows(SceneNode* root){
  */
 void Project::draw() {
 
+	// appLogic moved nodes after building the collision tree, catch up on those
+	m_rootNode->update_world();
+
+	if (m_instancesDirty){
+		buildInstanceGroups();
+	}
+
 	m_view = m_translation * m_rotation * glm::lookAt( 
 		glm::vec3( 0.0f, float(DIM)*2.0*M_SQRT1_2, float(DIM)*2.0*M_SQRT1_2 ),
 		glm::vec3( 0.0f, 0.0f, 0.0f ),
 		glm::vec3( 0.0f, 1.0f, 0.0f ) );	
 
+	cullNodes();
+
 	//getShadowMap((SceneNode *) &*m_rootNode);
 
 	if (m_zbuffer)
-		glEnable( GL_DEPTH_TEST );
+		GlState::enable( GL_DEPTH_TEST );
 
 	if (m_backfaceCulling || m_frontfaceCulling){
-		glEnable(GL_CULL_FACE);
+		GlState::enable(GL_CULL_FACE);
 		if (m_backfaceCulling && m_frontfaceCulling){
 			glCullFace(GL_FRONT_AND_BACK);
 		} else if (m_backfaceCulling){
@@ -805,7 +945,7 @@ void Project::draw() {
 	}
 
 	if (m_doShadowMapping){
-		getShadowMap((SceneNode *) &*m_rootNode);
+		getShadowMap();
 
 		glm::mat4 biasMatrix(
 				0.5, 0.0, 0.0, 0.0, 
@@ -817,24 +957,26 @@ void Project::draw() {
 		m_depthBias = biasMatrix*m_ortho_shadowView;
 	}
 
+	uploadFrameUniforms();
+
 	if (m_drawReflection){
 		drawReflection((SceneNode *) &*m_rootNode);
 	}
 
 	renderSceneGraph(*m_rootNode, false);
 
-	glBindVertexArray(m_vao_meshData);
-	renderTransparentObjects((SceneNode *) &*m_rootNode);
-	glBindVertexArray(0);
+	// the transparent layer renderSceneGraph left in the queue, over everything else
+	GlState::bindVertexArray(m_vao_meshData);
+	executeRenderQueue(RENDER_LAYER_TRANSPARENT);
 	CHECK_GL_ERRORS;
 
 	drawParticles();
 
 	if (m_zbuffer)
-		glDisable( GL_DEPTH_TEST );
+		GlState::disable( GL_DEPTH_TEST );
 
 	if (m_backfaceCulling || m_frontfaceCulling){
-		glDisable(GL_CULL_FACE);
+		GlState::disable(GL_CULL_FACE);
 	}
 }
 
@@ -842,7 +984,7 @@ void Project::draw() {
 void Project::renderSceneGraph(const SceneNode & root, bool inReflectionMode) {
 
 	// Bind the VAO once here, and reuse for all GeometryNode rendering below.
-	glBindVertexArray(m_vao_meshData);
+	GlState::bindVertexArray(m_vao_meshData);
 
 	// This is emphatically *not* how you should be drawing the scene graph in
 	// your final implementation.  This is a non-hierarchical demonstration
@@ -859,17 +1001,18 @@ void Project::renderSceneGraph(const SceneNode & root, bool inReflectionMode) {
 
 	if (m_drawReflection && inReflectionMode){
 		drawPlane();
-	} else if (m_drawTexture) {
-		applyTexture(m_plane);
 	}
 
-	renderNodes((SceneNode *) &root, inReflectionMode);
+	// each node queues at most a mesh and a hitbox, each instance group one packet
+	m_renderQueue.reset(2*m_entities.size() + m_instanceGroups.size());
+	queueNodes((SceneNode *) &root, inReflectionMode, root.get_world_transform());
+	queueInstanceGroups(inReflectionMode, root.get_world_transform());
+	m_renderQueue.sort();
 
-	for (Shot* shot : m_enemyShots){
-		drawShot(shot);
-	}
+	executeRenderQueue(inReflectionMode && m_drawReflection ? RENDER_LAYER_REFLECTION : RENDER_LAYER_OPAQUE);
+
+	drawProjectiles();
 
-	glBindVertexArray(0);
 	CHECK_GL_ERRORS;
 }
 
@@ -891,33 +1034,35 @@ void Project::drawPlane(){
 	//cout << glm::to_string(m_bg->trans) << endl;
 
 	if (m_drawReflection){
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-		glStencilMask(0xFF);
-		glDepthMask(GL_FALSE);
+		GlState::stencilFunc(GL_ALWAYS, 1, 0xFF);
+		GlState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+		GlState::stencilMask(0xFF);
+		GlState::depthMask(GL_FALSE);
 		glClear(GL_STENCIL_BUFFER_BIT);
 	}
 
-	updateShaderUniforms(m_shader, *m_plane, 
-					m_view, m_doShadowMapping, false);
+	DrawData data;
+	fillDrawData(data, *m_plane, m_plane->get_world_transform(), m_view);
+	size_t offset = m_drawData.push(&data, sizeof(data));
+	m_drawData.bindRange(m_drawData.flush() + offset, sizeof(data));
+
+	m_shader.enable();
+	glUniform1f(m_shader.getUniformLocation("drawShadows"), m_doShadowMapping);
+	CHECK_GL_ERRORS;
+	m_shader.disable();
 
 	applyTexture(m_plane);
 
 	if (m_doShadowMapping){
 		m_shader.enable();
-		GLuint DepthBiasID = m_shader.getUniformLocation("depthBiasMVP");
 		GLuint ShadowMapID = m_shader.getUniformLocation("shadowMap");
 
 				//GLuint TextureID = glGetUniformLocation(programID, "textureSampler");
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, m_shadowMap);
+		GlState::activeTexture(GL_TEXTURE1);
+		GlState::bindTexture(GL_TEXTURE_2D, m_shadowMap);
 		glUniform1i(ShadowMapID, 1);
 		CHECK_GL_ERRORS;
-
-		mat4 depthBias_times_model = m_depthBias*m_plane->trans;
-		glUniformMatrix4fv(DepthBiasID, 1, GL_FALSE, value_ptr(depthBias_times_model));
-		CHECK_GL_ERRORS;
 		m_shader.disable();
 	}
 
@@ -929,9 +1074,9 @@ void Project::drawPlane(){
 
 	//-- Now render the mesh:
 	m_shader.enable();
-	glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
+	drawBatch(batchInfo, GL_TRIANGLES);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GlState::bindTexture(GL_TEXTURE_2D, 0);
 	CHECK_GL_ERRORS;
 	m_shader.disable();
 
@@ -940,153 +1085,65 @@ void Project::drawPlane(){
 
 
 //----------------------------------------------------------------------------------------
-void Project::drawShot(Shot* shot){
-	m_shader.enable();
-
-	GLuint location = m_shader.getUniformLocation("ModelView");
-	mat4 modelView = m_view * shot->_self->trans;
-	glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-	CHECK_GL_ERRORS;
-
-	location = m_shader.getUniformLocation("curTime");
-	glUniform1f(location, 0);
+// Every live shot in one instanced draw of the plane.
+void Project::drawProjectiles(){
+	size_t count = m_projectiles.gather(m_projectileInstances.data());
+	if (count == 0) return;
+
+	// orphan last frame's buffer rather than wait for the GPU to finish reading it
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_projectileInstances);
+	glBufferData(GL_ARRAY_BUFFER, MAX_PROJECTILES*PROJECTILE_INSTANCE_FLOATS*sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count*PROJECTILE_INSTANCE_FLOATS*sizeof(float), m_projectileInstances.data());
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 	CHECK_GL_ERRORS;
 
-	location = m_shader.getUniformLocation("time0");
-	glUniform1f(location, 0);
-	CHECK_GL_ERRORS;
+	m_shader_projectiles.enable();
 
-	GLuint draw_shadows = m_shader.getUniformLocation("drawShadows");
-	glUniform1f(draw_shadows, false);
-	CHECK_GL_ERRORS;
+	BatchInfo batchInfo = m_batchInfoMap["plane"];
 
-	location = m_shader.getUniformLocation("NormalMatrix");
-	mat3 normalMatrix = glm::transpose(glm::inverse(mat3(modelView)));
-	glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(normalMatrix));
-	CHECK_GL_ERRORS;
+	GlState::bindVertexArray(m_vao_projectiles);
+	drawBatch(batchInfo, GL_TRIANGLES, count);
 
-	location = m_shader.getUniformLocation("material.kd");
-	vec3 kd(1.0, 1.0, 0.0); // yellow
-	glUniform3fv(location, 1, value_ptr(kd));
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.ks");
-	vec3 ks(1.0, 1.0, 0.0); // yellow
-	glUniform3fv(location, 1, value_ptr(ks));
+	m_shader_projectiles.disable();
 	CHECK_GL_ERRORS;
-
-	location = m_shader.getUniformLocation("material.shininess");
-	glUniform1f(location, 100);
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.alpha");
-	glUniform1f(location, 1.0);
-
-	BatchInfo batchInfo = m_batchInfoMap[shot->_meshId];
-
-	glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
-
-	m_shader.disable();
-
 }
 
+//----------------------------------------------------------------------------------------
+// Every live particle in one instanced draw of the cube.
 void Project::drawParticles(){
-	for (auto& p : particles){
-
-	if (p->_life <= 0) continue; 
-	//updateShaderUniforms(m_particle_shader, *node, 
-	//				m_view, m_doShadowMapping, false);
-	glBindVertexArray(m_vao_meshData);
-
-	m_shader.enable();
-
-	GLuint location;
-		//-- Set ModelView matrix:
-	//cout << "trans: " << glm::to_string(p->_trans) << endl;
-	location = m_shader.getUniformLocation("ModelView");
-	mat4 modelView = m_view  * p->_trans;
-	glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-	CHECK_GL_ERRORS;
-
-	location = m_shader.getUniformLocation("curTime");
-		glUniform1f(location, 0);
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("time0");
-		glUniform1f(location, 0);
-		CHECK_GL_ERRORS;
-
-			//-- Set NormMatrix:
-	location = m_shader.getUniformLocation("NormalMatrix");
-	mat3 normalMatrix = glm::transpose(glm::inverse(mat3(modelView)));
-	glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(normalMatrix));
-	CHECK_GL_ERRORS;
-
-
-		//-- Set Material values:
-	location = m_shader.getUniformLocation("material.kd");
-	vec3 kd(1.0, 1.0, 0.0);
-	glUniform3fv(location, 1, value_ptr(kd));
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.ks");
-	vec3 ks(1.0, 1.0, 0.0);
-	glUniform3fv(location, 1, value_ptr(ks));
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.shininess");
-	glUniform1f(location, 100);
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.alpha");
-	glUniform1f(location, 1.0f);
-	CHECK_GL_ERRORS;
-		
-
-	//glBindBuffer( GL_ARRAY_BUFFER, m_vbo_particle );
-
-	//glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES*3*sizeof(float), NULL, GL_STREAM_DRAW);
-	//glBufferSubData(GL_ARRAY_BUFFER, 0, particleCount*3*sizeof(float), particle_positions);
+	size_t count = m_particles.gather(m_particleInstances.data());
+	if (count == 0) return;
+
+	// orphan last frame's buffer rather than wait for the GPU to finish reading it
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_particleInstances);
+	glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES*PARTICLE_INSTANCE_FLOATS*sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count*PARTICLE_INSTANCE_FLOATS*sizeof(float), m_particleInstances.data());
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
 	CHECK_GL_ERRORS;
 
+	m_shader_particles.enable();
 
 	BatchInfo batchInfo = m_batchInfoMap["cube"];
 
-	//m_particle_shader.enable();
-	/*for (int i = 0; i < particleCount; i++){
-		glDrawArrays(GL_TRIANGLES, 0, 6)
-	}*/
-	//cout << "particle count: "<< particleCount << endl;
-	//glDrawArraysInstanced(GL_TRIANGLES, 0, 3, particleCount);
-	glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
+	GlState::bindVertexArray(m_vao_particles);
+	drawBatch(batchInfo, GL_TRIANGLES, count);
 
-	//CHECK_GL_ERRORS;
-
-	m_shader.disable();
-
-	glBindVertexArray(0);
+	m_shader_particles.disable();
 	CHECK_GL_ERRORS;
-	}
 }
 
+//----------------------------------------------------------------------------------------
 void Project::moveParticles(){
-	for (auto& p : particles){
-		//Particle& p = particles[i];
-		if (p->_life > 0){
-			p->_life--;
-			if (p->_life > 0){
-				p->_speed += glm::vec3(0.0, -9.81, 0.0) * 0.1;
-				//p._pos += p._speed;
-				p->move();
-			}
-		} else {
-			auto it = std::find(particles.begin(), particles.end(), p);
-			if (it != particles.end()){
-				particles.erase(it);
-			}
-		}
-	}
-
-	
+	m_particles.update(glm::vec3(0.0, -9.81, 0.0) * 0.1, PARTICLE_KILL_HEIGHT);
 }
 
+//----------------------------------------------------------------------------------------
 void Project::generateParticles(GeometryNode* node){
 	//cout << "generateParticles at " << glm::to_string(node->trans) << endl;
+	const mat4 & world = node->get_world_transform();
+	vec3 origin(world[3]);
+	float size = 0.1f * glm::length(vec3(world[0]));
+
 	for (int i = 0; i < 50; i++){
 		float x = dis(e) - 1.0;
 		float y = dis(e);
@@ -1096,436 +1153,486 @@ void Project::generateParticles(GeometryNode* node){
 
 		vec3 pos(x*modifier, y*modifier, z*modifier);
 
-		Particle* p = new Particle(node->trans,pos);
-
-		particles.emplace_back(p);
+		m_particles.emit(origin + pos, vec3(0.0, -0.1, 0.0), size, PARTICLE_LIFE);
 	}
 }
 
 //----------------------------------------------------------------------------------------
 void Project::applyTexture(GeometryNode* node){
+	bool textured = node->m_texture != TEXTURE_NONE && m_drawTexture;
 
-	//return;
 	m_shader.enable();
-	//glGenTextures(1, &m_texture);
-	glBindTexture(GL_TEXTURE_2D, m_texture);
+	GLuint location = m_shader.getUniformLocation("drawTexture");
+	glUniform1f(location, textured);
 	CHECK_GL_ERRORS;
-	
-	//cout << "width: " << node->texture._w << ", height: " << node->texture._h << endl;
-
-	/*if(m_doShadowMapping){
-		location = m_shader.getUniformLocation("shadowMap");
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-		glUniform1i(location, 1);			
-	}*/
 
-	if (node->texture._data != nullptr && m_drawTexture){
-		//cout << "applying textures" << endl;
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, node->texture._w, node->texture._h, 0, GL_RGBA, GL_UNSIGNED_BYTE, node->texture._data);
-		CHECK_GL_ERRORS;
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	if (textured){
+		vec4 rect = m_textures.bind(node->m_texture, 0);
+		location = m_shader.getUniformLocation("textureRect");
+		glUniform4fv(location, 1, value_ptr(rect));
+		location = m_shader.getUniformLocation("textureSampler");
+		glUniform1i(location, 0);
 		CHECK_GL_ERRORS;
-
 	}
 
-	GLuint location = m_shader.getUniformLocation("drawTexture");
-	glUniform1f(location, (node->texture._data != nullptr && m_drawTexture));
-	CHECK_GL_ERRORS;
-
-	location = m_shader.getUniformLocation("textureSampler");
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_texture);
-	glUniform1i(location, 0);
-	CHECK_GL_ERRORS;
-
 	m_shader.disable();
-
 }
 
-
 //----------------------------------------------------------------------------------------
-void Project::renderNodes(SceneNode *root, bool inReflectionMode){
-
-	//cout << "inReflectionMode: " << inReflectionMode << endl;
-
-	if (root->m_nodeType == NodeType::GeometryNode){
+// Walks the tree queueing a packet per visible node; nothing is drawn until the queue
+// is sorted and executed.
+//model -- root's model matrix, its cached world transform except in the reflection pass
+void Project::queueNodes(SceneNode *root, bool inReflectionMode, const glm::mat4 & model){
+	bool reflecting = inReflectionMode && m_drawReflection;
+
+	CullPass pass = reflecting ? CULL_REFLECTION : CULL_CAMERA;
+	if (root->m_nodeType == NodeType::GeometryNode && isVisible(pass, static_cast<GeometryNode *>(root))){
 		GeometryNode * geometryNode = static_cast<GeometryNode *>(root);
 
-		//geometryNode->updateHitbox(m_current_time_secs);
-		//if (!(m_planeDrawn && (geometryNode == m_plane || geometryNode == m_bg)))
-		if (!(geometryNode->hasAnimation()))
-		{
-
-			if(inReflectionMode && m_drawReflection && geometryNode != m_plane){
-				glStencilFunc(GL_EQUAL, 1, 0xFF); //pass if stencil value 1
-				glStencilMask(0x00); //don't write to stencil buffer
-				glDepthMask(GL_TRUE);
-			}
-
-			updateShaderUniforms(m_shader, *geometryNode, 
-					m_view, m_doShadowMapping, false, inReflectionMode);
-
-			m_shader.enable();
-
-			GLuint location = m_shader.getUniformLocation("drawTexture");
-			glUniform1f(location, (geometryNode->texture._data != nullptr && m_drawTexture));
-			CHECK_GL_ERRORS;
-
-			m_shader.disable();
-
-			if (m_drawTexture && geometryNode->texture._data != nullptr){
-				applyTexture(geometryNode);
-				/*GLuint location = m_shader.getUniformLocation("textureSampler");
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, m_texture);
-				glUniform1i(location, 0);
-				CHECK_GL_ERRORS;*/
-			}
-
-			if (m_doShadowMapping){
-				m_shader.enable();
-				GLuint DepthBiasID = m_shader.getUniformLocation("depthBiasMVP");
-				GLuint ShadowMapID = m_shader.getUniformLocation("shadowMap");
-
-				//GLuint TextureID = glGetUniformLocation(programID, "textureSampler");
-
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-				glUniform1i(ShadowMapID, 1);
-				CHECK_GL_ERRORS;
-
-				mat4 depthBias_times_model = m_depthBias*geometryNode->trans;
-				glUniformMatrix4fv(DepthBiasID, 1, GL_FALSE, value_ptr(depthBias_times_model));
-				CHECK_GL_ERRORS;
-				m_shader.disable();
-			}
-
-			
-
-
-			if (!(!inReflectionMode && geometryNode->isTransparent()) && !(m_drawReflection && geometryNode == m_plane)){
-				//if (m_drawTexture)
-				//if (geometryNode == m_plane)
-				//	applyTexture(geometryNode);
-
-				BatchInfo batchInfo = m_batchInfoMap[geometryNode->meshId];
-
-				//-- Now render the mesh:
-				m_shader.enable();
-				glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
+		RenderDraw draw;
+		draw.model = model;
+		draw.node = geometryNode;
+		draw.mesh = geometryNode->m_mesh;
+		draw.kind = geometryNode->hasAnimation() ? RenderKind::Animated : RenderKind::Mesh;
+		draw.group = INSTANCE_GROUP_NONE;
+
+		RenderLayer layer = RENDER_LAYER_OPAQUE;
+		if (reflecting){
+			layer = RENDER_LAYER_REFLECTION;
+		} else if (geometryNode->isTransparent()){
+			layer = RENDER_LAYER_TRANSPARENT;
+		}
 
-				m_shader.disable();
-			}
+		float depth = -(m_view * model[3]).z;
+		uint32_t texture = m_drawTexture ? geometryNode->m_texture : TEXTURE_NONE;
 
-			if (RENDER_HITBOX && !inReflectionMode) renderHitbox(geometryNode);
-		} else {
-			renderAnimatedObject(geometryNode, inReflectionMode);
+		// with reflections on, drawPlane has drawn the plane already
+		// instanced nodes are queued by group in queueInstanceGroups
+		if (!(m_drawReflection && geometryNode == m_plane) && geometryNode->m_instanceGroup == INSTANCE_GROUP_NONE){
+			m_renderQueue.push(RenderQueue::makeKey(layer, draw.kind, texture, draw.mesh, depth), draw);
 		}
 
-		if (geometryNode == m_playerNode){
-			for (Shot* shot : m_shots){
-				drawShot(shot);
-			}
-			return; //don't draw shots twice
-		} else if (geometryNode->isEnemy()){
-			return; // shots drawn later
+		if (RENDER_HITBOX && !reflecting){
+			draw.kind = RenderKind::Hitbox;
+			draw.mesh = m_meshIndex["cube"];
+			m_renderQueue.push(RenderQueue::makeKey(RENDER_LAYER_OPAQUE, draw.kind, TEXTURE_NONE, draw.mesh, depth), draw);
 		}
 	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-				CHECK_GL_ERRORS;
-
 	for (SceneNode *child : root->children){
 
-		if (inReflectionMode && m_drawReflection){
-			child->translate(vec3(0, 1, 0));
-			child->scale(vec3(1, -1, 1));
-		}
-		child->set_keyframe_parent_transform(root->get_transform());
-		child->set_transform(root->get_transform() * child->get_transform());
-		renderNodes(child, inReflectionMode);
-		if (inReflectionMode && m_drawReflection){
-			child->scale(vec3(1, -1, 1));
-			child->translate(vec3(0, -1, 0));
+		child->set_keyframe_parent_transform(model);
+
+		//the reflection mirrors every level below the root about the plane, so
+		//those matrices are built on the way down instead of read from the cache
+		if (reflecting){
+			mat4 mirror = glm::scale(vec3(1, -1, 1)) * glm::translate(vec3(0, 1, 0));
+			queueNodes(child, inReflectionMode, model * mirror * child->get_transform());
+		} else {
+			queueNodes(child, inReflectionMode, child->get_world_transform());
 		}
-		child->set_transform(glm::inverse(root->get_transform()) * child->get_transform());
 
 	}
 }
 
 //----------------------------------------------------------------------------------------
-void Project::renderAnimatedObject(GeometryNode *node, bool inReflectionMode){
-	if(inReflectionMode && m_drawReflection && node != m_plane){
-		glStencilFunc(GL_EQUAL, 1, 0xFF); //pass if stencil value 1
-		glStencilMask(0x00); //don't write to stencil buffer
-		glDepthMask(GL_TRUE);
-	}
-
-	updateShaderUniforms(m_shader, *node, 
-		m_view, m_doShadowMapping, false, inReflectionMode);
-
-		m_shader.enable();
-
-		int seconds = (int) m_current_time_secs;
-
-		Keyframe* cur = node->getKeyframeAt(seconds);
-		Keyframe* next = node->getNextKeyframe(seconds);
-
-		mat4 modelView0 = m_view * cur->get_total_transform();
-		mat4 modelView1 = m_view * next->get_total_transform();
-		float time0 = (float)(cur->time);
-		float time1 = (float)(next->time);
-
-		if (inReflectionMode){
-			modelView0 = m_view * cur->parentTrans * glm::scale(vec3(1, -1, 1)) * translate(vec3(0, 1, 0)) * cur->trans;
-			modelView1 = m_view * next->parentTrans * glm::scale(vec3(1, -1, 1)) * translate(vec3(0, 1, 0)) * next->trans;
+// Groups the static nodes that can share a draw, by mesh, material and texture, and
+// uploads their world matrices.  Only children of the root qualify, so the reflection
+// pass can mirror a whole group with one matrix.
+void Project::buildInstanceGroups(){
+	for (GeometryNode* node : m_instancedNodes){
+		node->m_instanceGroup = INSTANCE_GROUP_NONE;
+	}
+	m_instanceGroups.clear();
+	m_instancedNodes.clear();
+	m_instanceModels.clear();
+	m_instancesDirty = false;
+
+	std::vector<GeometryNode*> statics;
+	m_entities.collect(ENTITY_STATIC, statics);
+
+	std::vector<std::vector<GeometryNode*>> groups;
+	for (GeometryNode* node : statics){
+		if (node == m_plane || node->m_mesh == 0 || node->hasAnimation() || node->isTransparent()
+				|| node->parent != m_rootNode.get()){
+			continue;
 		}
 
-		GLuint location = m_shader.getUniformLocation("ModelView");
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView0));
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("nextModelView");
-		glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView1));
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("time0");
-		glUniform1f(location, time0);
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("time1");
-		glUniform1f(location, time1);
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("curTime");
-		float dec = (float)(m_current_time_secs - seconds);
-		glUniform1f(location, (float)(seconds%node->m_animationEnd) + dec);
-		CHECK_GL_ERRORS;
-
-		location = m_shader.getUniformLocation("drawTexture");
-		glUniform1f(location, (node->texture._data != nullptr && m_drawTexture));
-		CHECK_GL_ERRORS;
-
-		if (m_drawTexture && node->texture._data != nullptr){
-			location = m_shader.getUniformLocation("textureSampler");
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, m_texture);
-			glUniform1i(location, 0);
-			CHECK_GL_ERRORS;
+		auto same = [&](const std::vector<GeometryNode*> & group){
+			const GeometryNode* other = group.front();
+			return other->m_mesh == node->m_mesh && other->m_texture == node->m_texture
+				&& other->material.kd == node->material.kd && other->material.ks == node->material.ks
+				&& other->material.shininess == node->material.shininess
+				&& other->material.alpha == node->material.alpha;
+		};
+		auto group = std::find_if(groups.begin(), groups.end(), same);
+		if (group == groups.end()){
+			groups.push_back(std::vector<GeometryNode*>(1, node));
+		} else {
+			group->push_back(node);
 		}
+	}
 
-		if (m_doShadowMapping){
-			GLuint DepthBiasID = m_shader.getUniformLocation("depthBiasMVP");
-			GLuint ShadowMapID = m_shader.getUniformLocation("shadowMap");
-
-				//GLuint TextureID = glGetUniformLocation(programID, "textureSampler");
-
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-			glUniform1i(ShadowMapID, 1);
-			CHECK_GL_ERRORS;
+	for (const auto & nodes : groups){
+		// a lone node is no cheaper instanced
+		if (nodes.size() < 2) continue;
 
-			mat4 depthBias_times_model = m_depthBias*node->trans;
-			glUniformMatrix4fv(DepthBiasID, 1, GL_FALSE, value_ptr(depthBias_times_model));
-			CHECK_GL_ERRORS;
+		InstanceGroup group;
+		group.node = nodes.front();
+		group.first = m_instancedNodes.size();
+		group.count = nodes.size();
+		for (GeometryNode* node : nodes){
+			node->m_instanceGroup = m_instanceGroups.size();
+			m_instancedNodes.push_back(node);
+			m_instanceModels.push_back(node->get_world_transform());
 		}
+		m_instanceGroups.push_back(group);
+	}
 
-	m_shader.disable();
-
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_instanceModels);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceModels.size()*sizeof(mat4), m_instanceModels.data(), GL_STATIC_DRAW);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL_ERRORS;
+}
 
-	if (!(!inReflectionMode && node->isTransparent()) && !(m_drawReflection && node == m_plane)){
-				//if (m_drawTexture)
-				//if (geometryNode == m_plane)
-				//	applyTexture(geometryNode);
+//----------------------------------------------------------------------------------------
+// A packet per group with any member in view.  Groups have no depth to sort by, so
+// they go ahead of the single draws.
+void Project::queueInstanceGroups(bool inReflectionMode, const glm::mat4 & rootModel){
+	bool reflecting = inReflectionMode && m_drawReflection;
+	CullPass pass = reflecting ? CULL_REFLECTION : CULL_CAMERA;
+
+	RenderDraw draw;
+	draw.model = mat4();
+	if (reflecting){
+		// what queueNodes does to a child of the root, as a matrix on its world transform
+		mat4 mirror = glm::scale(vec3(1, -1, 1)) * glm::translate(vec3(0, 1, 0));
+		draw.model = rootModel * mirror * glm::inverse(rootModel);
+	}
+	draw.kind = RenderKind::Instanced;
+
+	RenderLayer layer = reflecting ? RENDER_LAYER_REFLECTION : RENDER_LAYER_OPAQUE;
+	for (uint32_t i = 0; i < m_instanceGroups.size(); i++){
+		const InstanceGroup & group = m_instanceGroups[i];
+		if (!isVisible(pass, group)) continue;
+
+		draw.node = group.node;
+		draw.mesh = group.node->m_mesh;
+		draw.group = i;
+		uint32_t texture = m_drawTexture ? group.node->m_texture : TEXTURE_NONE;
+		m_renderQueue.push(RenderQueue::makeKey(layer, draw.kind, texture, draw.mesh, 0.0f), draw);
+	}
+}
 
-		BatchInfo batchInfo = m_batchInfoMap[node->meshId];
+//----------------------------------------------------------------------------------------
+// Points the instance matrix attributes of m_vao_instanced at the group's matrices;
+// GL 3.3 has no base instance to do it in the draw call.
+void Project::bindInstanceGroup(const InstanceGroup & group){
+	GlState::bindVertexArray(m_vao_instanced);
+	GlState::bindBuffer(GL_ARRAY_BUFFER, m_vbo_instanceModels);
+	for (int i = 0; i < 4; i++){
+		size_t offset = group.first*sizeof(mat4) + i*sizeof(vec4);
+		glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *)offset);
+	}
+	CHECK_GL_ERRORS;
+}
 
-				//-- Now render the mesh:
-		m_shader.enable();
-		glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
+//----------------------------------------------------------------------------------------
+void Project::getInstanceShadows(){
+	m_shader_shadow.enable();
+	glUniformMatrix4fv(m_shader_shadow.getUniformLocation("ModelView"), 1, GL_FALSE, value_ptr(m_ortho_shadowView));
+	glUniform1i(m_shader_shadow.getUniformLocation("instanced"), 1);
 
-		m_shader.disable();
+	for (const InstanceGroup & group : m_instanceGroups){
+		if (!isVisible(CULL_SHADOW, group)) continue;
+		bindInstanceGroup(group);
+		const BatchInfo & batchInfo = m_meshes[group.node->m_mesh];
+		drawBatch(batchInfo, GL_TRIANGLES, group.count);
 	}
 
-	if (RENDER_HITBOX && !inReflectionMode) renderHitbox(node);
+	glUniform1i(m_shader_shadow.getUniformLocation("instanced"), 0);
+	GlState::bindVertexArray(m_vao_meshData);
+	CHECK_GL_ERRORS;
+	m_shader_shadow.disable();
 }
 
-void Project::renderTransparentObjects(SceneNode *root){
+//----------------------------------------------------------------------------------------
+// Draws one layer of the sorted queue.  Every draw's DrawData block is uploaded to the
+// ring in one go, each draw then only binds its range, and the texture is only rebound
+// when it changes from one packet to the next.
+void Project::executeRenderQueue(RenderLayer layer){
+	size_t begin, end;
+	m_renderQueue.range(layer, begin, end);
+	if (begin == end) return;
+
+	bool reflecting = layer == RENDER_LAYER_REFLECTION;
+	if (reflecting){
+		GlState::stencilFunc(GL_EQUAL, 1, 0xFF); //pass if stencil value 1
+		GlState::stencilMask(0x00); //don't write to stencil buffer
+		GlState::depthMask(GL_TRUE);
+	} else if (layer == RENDER_LAYER_TRANSPARENT){
+		GlState::enable(GL_BLEND);
+		GlState::blendFunc(GL_SRC_COLOR, GL_DST_ALPHA);
+		GlState::blendEquation(GL_FUNC_ADD);
+	}
+
+	// reflections are drawn darker
+	float shade = reflecting ? 0.5f : 1.0f;
+
+	// every draw's block goes into the ring first, so the layer is one upload
+	m_drawOffsets.resize(end - begin);
+	for (size_t i = begin; i < end; i++){
+		const RenderDraw & draw = m_renderQueue.draw(m_renderQueue.packet(i).draw);
+		GeometryNode* node = draw.node;
+
+		DrawData data;
+		fillDrawData(data, *node, draw.model, m_view, shade);
+		data.instanced = draw.kind == RenderKind::Instanced;
+
+		if (draw.kind == RenderKind::Hitbox){
+			data.modelView = data.modelView * glm::scale(mat4(), vec3(node->hitbox->_maxXYZ));
+			data.nextModelView = data.modelView;
+			data.setNormalMatrix(glm::transpose(glm::inverse(mat3(data.modelView))));
+
+			vec3 colour(0.6f, 1.0f, 0.8f);
+			data.kd = colour;
+			data.ks = colour;
+			data.shininess = 0.0f;
+		}
 
-	if (root->m_nodeType == NodeType::GeometryNode){
-		GeometryNode * geometryNode = static_cast<GeometryNode *>(root);
+		if (draw.kind == RenderKind::Animated){
+			int seconds = (int) m_current_time_secs;
 
-		if (geometryNode->isTransparent()){
-			glEnable(GL_BLEND);
+			Keyframe* cur = node->getKeyframeAt(seconds);
+			Keyframe* next = node->getNextKeyframe(seconds);
 
-			glBlendFunc(GL_SRC_COLOR, GL_DST_ALPHA);
-			glBlendEquation(GL_FUNC_ADD);
+			mat4 modelView0 = m_view * cur->get_total_transform();
+			mat4 modelView1 = m_view * next->get_total_transform();
+			if (reflecting){
+				modelView0 = m_view * cur->parentTrans * glm::scale(vec3(1, -1, 1)) * translate(vec3(0, 1, 0)) * cur->trans;
+				modelView1 = m_view * next->parentTrans * glm::scale(vec3(1, -1, 1)) * translate(vec3(0, 1, 0)) * next->trans;
+			}
+			data.modelView = modelView0;
+			data.nextModelView = modelView1;
+			data.time0 = (float)(cur->time);
+			data.time1 = (float)(next->time);
+			float dec = (float)(m_current_time_secs - seconds);
+			data.curTime = (float)(seconds%node->m_animationEnd) + dec;
+		}
 
-			m_shader.enable();
-			GLuint location = m_shader.getUniformLocation("drawTexture");
-			glUniform1f(location, (geometryNode->texture._data != nullptr && m_drawTexture));
-			CHECK_GL_ERRORS;
+		m_drawOffsets[i - begin] = m_drawData.push(&data, sizeof(data));
+	}
+	size_t base = m_drawData.flush();
 
-			if (m_doShadowMapping){
-				
-				GLuint DepthBiasID = m_shader.getUniformLocation("depthBiasMVP");
-				GLuint ShadowMapID = m_shader.getUniformLocation("shadowMap");
+	static const UniformId drawShadowsId = ShaderProgram::internUniform("drawShadows");
+	static const UniformId drawTextureId = ShaderProgram::internUniform("drawTexture");
+	static const UniformId textureRectId = ShaderProgram::internUniform("textureRect");
+	static const UniformId textureSamplerId = ShaderProgram::internUniform("textureSampler");
+	static const UniformId shadowMapId = ShaderProgram::internUniform("shadowMap");
 
-				//GLuint TextureID = glGetUniformLocation(programID, "textureSampler");
+	m_shader.enable();
+	GLint drawTextureLocation = m_shader.getUniformLocation(drawTextureId);
+	GLint textureRectLocation = m_shader.getUniformLocation(textureRectId);
 
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-				glUniform1i(ShadowMapID, 1);
-				CHECK_GL_ERRORS;
+	glUniform1f(m_shader.getUniformLocation(drawShadowsId), m_doShadowMapping && !reflecting);
+	glUniform1i(m_shader.getUniformLocation(textureSamplerId), 0);
+	if (m_doShadowMapping){
+		GlState::activeTexture(GL_TEXTURE1);
+		GlState::bindTexture(GL_TEXTURE_2D, m_shadowMap);
+		glUniform1i(m_shader.getUniformLocation(shadowMapId), 1);
+	}
+	CHECK_GL_ERRORS;
 
-				mat4 depthBias_times_model = m_depthBias*geometryNode->trans;
-				glUniformMatrix4fv(DepthBiasID, 1, GL_FALSE, value_ptr(depthBias_times_model));
-				CHECK_GL_ERRORS;
+	uint32_t texture = UINT32_MAX;
+	for (size_t i = begin; i < end; i++){
+		const RenderDraw & draw = m_renderQueue.draw(m_renderQueue.packet(i).draw);
+
+		uint32_t nodeTexture = m_drawTexture && draw.kind != RenderKind::Hitbox ? draw.node->m_texture : TEXTURE_NONE;
+		if (nodeTexture != texture){
+			texture = nodeTexture;
+			glUniform1f(drawTextureLocation, texture != TEXTURE_NONE);
+			if (texture != TEXTURE_NONE){
+				vec4 rect = m_textures.bind(texture, 0);
+				glUniform4fv(textureRectLocation, 1, value_ptr(rect));
 			}
+		}
 
-			m_shader.disable();
-
-			updateShaderUniforms(m_shader, *geometryNode, m_view, m_doShadowMapping, false);
-
-			BatchInfo batchInfo = m_batchInfoMap[geometryNode->meshId];
+		m_drawData.bindRange(base + m_drawOffsets[i - begin], sizeof(DrawData));
 
-			//-- Now render the mesh:
-			m_shader.enable();
-			glDrawArrays(GL_TRIANGLES, batchInfo.startIndex, batchInfo.numIndices);
+		const BatchInfo & batchInfo = m_meshes[draw.mesh];
+		if (draw.kind == RenderKind::Instanced){
+			const InstanceGroup & group = m_instanceGroups[draw.group];
+			bindInstanceGroup(group);
+			drawBatch(batchInfo, GL_TRIANGLES, group.count);
+			continue;
+		}
 
-			m_shader.disable();
+		GlState::bindVertexArray(m_vao_meshData);
+		drawBatch(batchInfo, draw.kind == RenderKind::Hitbox ? GL_LINES : GL_TRIANGLES);
+	}
+	CHECK_GL_ERRORS;
 
-			glDisable(GL_BLEND);
+	m_shader.disable();
 
-			if (RENDER_HITBOX) renderHitbox(geometryNode);
-		}
+	GlState::activeTexture(GL_TEXTURE0);
+	GlState::bindTexture(GL_TEXTURE_2D, 0);
+	if (layer == RENDER_LAYER_TRANSPARENT){
+		GlState::disable(GL_BLEND);
+	}
+}
 
+//----------------------------------------------------------------------------------------
+// Keeps world bounds for every node in m_boundsHierarchy, rebuilt when nodes come or
+// go and refit otherwise, then culls them against the camera, the light and the
+// camera's mirror image under the plane.
+void Project::cullNodes(){
+	m_boundsScratch.clear();
+	m_entities.collect(ENTITY_PLAYER | ENTITY_ENEMY | ENTITY_STATIC, m_boundsScratch);
+	bool rebuild = m_boundsScratch != m_boundsNodes;
+	if (rebuild){
+		m_boundsNodes.swap(m_boundsScratch);
+	}
+
+	uint32_t slots = 0;
+	m_boundsMin.resize(m_boundsNodes.size());
+	m_boundsMax.resize(m_boundsNodes.size());
+	for (size_t i = 0; i < m_boundsNodes.size(); i++){
+		GeometryNode* node = m_boundsNodes[i];
+		const BatchInfo & batchInfo = m_meshes[node->m_mesh];
+		const mat4 & world = node->get_world_transform();
+
+		vec3 centre(world * vec4(0.5f * (batchInfo.boundsMin + batchInfo.boundsMax), 1.0f));
+		vec3 half(0.5f * (batchInfo.boundsMax - batchInfo.boundsMin));
+		vec3 extent = glm::abs(vec3(world[0])) * half.x + glm::abs(vec3(world[1])) * half.y +
+			glm::abs(vec3(world[2])) * half.z;
+		m_boundsMin[i] = centre - extent;
+		m_boundsMax[i] = centre + extent;
+
+		slots = std::max(slots, node->m_entity + 1);
+	}
+
+	if (rebuild){
+		m_boundsHierarchy.build(m_boundsMin, m_boundsMax);
+	} else {
+		m_boundsHierarchy.refit(m_boundsMin, m_boundsMax);
+	}
+
+	cullPass(CULL_CAMERA, Frustum(m_perpsective * m_view), slots);
+	if (m_doShadowMapping){
+		cullPass(CULL_SHADOW, Frustum(m_ortho_shadowView), slots);
 	}
-	for (SceneNode *child : root->children){
-		child->set_transform(root->get_transform() * child->get_transform());
-		renderTransparentObjects(child);
-		child->set_transform(glm::inverse(root->get_transform()) * child->get_transform());
+	if (m_drawReflection){
+		// same mirror as renderNodes, about the root's frame
+		const mat4 & root = m_rootNode->get_world_transform();
+		mat4 mirror = glm::scale(vec3(1, -1, 1)) * glm::translate(vec3(0, 1, 0));
+		cullPass(CULL_REFLECTION, Frustum(m_perpsective * m_view * root * mirror * glm::inverse(root)), slots);
 	}
 }
 
-void Project::renderHitbox(GeometryNode *node){
-	m_shader.enable();
-	GLint location = m_shader.getUniformLocation("ModelView");
-	mat4 scale_mat = glm::scale(mat4(), vec3(node->hitbox->_maxXYZ)); //* mat4();
-	mat4 modelView = m_view * node->trans * scale_mat; 
-	glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(modelView));
-	CHECK_GL_ERRORS;
-
-		//-- Set NormMatrix:
-	location = m_shader.getUniformLocation("NormalMatrix");
-	mat3 normalMatrix = glm::transpose(glm::inverse(mat3(modelView)));
-	glUniformMatrix3fv(location, 1, GL_FALSE, value_ptr(normalMatrix));
-	CHECK_GL_ERRORS;
-
-	//-- Set Material values:
-	location = m_shader.getUniformLocation("material.kd");
-	vec3 kd = glm::vec3(0.6f, 1.0f, 0.8f);
-	glUniform3fv(location, 1, value_ptr(kd));
-	CHECK_GL_ERRORS;
-	
-	location = m_shader.getUniformLocation("material.ks");
-	vec3 ks = glm::vec3(0.6f, 1.0f, 0.8f);
-	glUniform3fv(location, 1, value_ptr(ks));
-	CHECK_GL_ERRORS;
-	location = m_shader.getUniformLocation("material.shininess");
-	glUniform1f(location, 0.0f);
-	CHECK_GL_ERRORS;
-	
-	m_shader.disable();
+//----------------------------------------------------------------------------------------
+void Project::cullPass(CullPass pass, const Frustum & frustum, uint32_t slots){
+	m_boundsHierarchy.cull(frustum, m_culled);
+
+	std::vector<uint8_t> & visible = m_visible[pass];
+	visible.assign(slots, 1);
+	m_drawnCount[pass] = 0;
+	m_culledCount[pass] = 0;
+	for (size_t i = 0; i < m_boundsNodes.size(); i++){
+		GeometryNode* node = m_boundsNodes[i];
+
+		// keyframed nodes are placed by the shader, and below the first level the
+		// reflection isn't a single mirror, so neither is culled
+		bool keep = m_culled[i] || node->hasAnimation() ||
+			(pass == CULL_REFLECTION && node->parent != &*m_rootNode);
+		visible[node->m_entity] = keep;
+		if (keep){
+			m_drawnCount[pass]++;
+		} else {
+			m_culledCount[pass]++;
+		}
+	}
+}
 
-	BatchInfo hitbox = m_batchInfoMap["cube"];
+//----------------------------------------------------------------------------------------
+bool Project::isVisible(CullPass pass, const GeometryNode* node) const{
+	const std::vector<uint8_t> & visible = m_visible[pass];
+	return node->m_entity >= visible.size() || visible[node->m_entity];
+}
 
-	m_shader.enable();
-	glDrawArrays(GL_LINES, hitbox.startIndex, hitbox.numIndices);
-	m_shader.disable();
+//----------------------------------------------------------------------------------------
+// A group is drawn whole if any of it is visible.
+bool Project::isVisible(CullPass pass, const InstanceGroup & group) const{
+	for (uint32_t i = group.first; i < group.first + group.count; i++){
+		if (isVisible(pass, m_instancedNodes[i])) return true;
+	}
+	return false;
 }
 
 //----------------------------------------------------------------------------------------
 void Project::drawReflection(SceneNode* root){
 	if (!m_drawReflection) return;
 
-	glEnable(GL_STENCIL_TEST);
+	GlState::enable(GL_STENCIL_TEST);
 
 	renderSceneGraph(*root, true);
 
-	glDisable(GL_STENCIL_TEST);
+	GlState::disable(GL_STENCIL_TEST);
 	
 }
 
 //----------------------------------------------------------------------------------------
-void Project::findPlayerNode(SceneNode *root){
-	if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "player"){
-		m_playerNode = static_cast<GeometryNode *>(root);
-		return;
-	}
-	for (SceneNode *child : root->children){
-		findPlayerNode(child);
-	}
-}
+// Tags every geometry node once by its name, so nothing after this looks at names.
+void Project::registerEntities(SceneNode *root){
+	if (root->m_nodeType == NodeType::GeometryNode){
+		GeometryNode* node = static_cast<GeometryNode *>(root);
+		uint32_t tags = ENTITY_STATIC;
+
+		if (node->m_name == "player"){
+			m_playerNode = node;
+			tags = ENTITY_PLAYER;
+		} else if (node->isEnemy()){
+			tags = ENTITY_ENEMY;
+		} else if (node->m_name == "plane"){
+			m_plane = node;
+		} else if (node->m_name == "bg"){
+			m_bg = node;
+		} else if (node->m_name == "r1"){
+			m_reflectNode = node;
+		} else if (node->m_name.size() == 2 && node->m_name[0] == 't'){
+			if (node->m_name == "t1"){
+				m_transparentNode = node;
+			}
+			node->setTransparency(0.3f);
+		}
 
-//----------------------------------------------------------------------------------------
-void Project::findPlaneNode(SceneNode *root){
-	if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "plane"){
-		m_plane = static_cast<GeometryNode *>(root);
-		return;
-	}
-	for (SceneNode *child : root->children){
-		findPlaneNode(child);
-	}
-}
-//----------------------------------------------------------------------------------------
-void Project::findBgNode(SceneNode *root){
-	if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "bg"){
-		m_bg = static_cast<GeometryNode *>(root);
-		return;
+		auto mesh = m_meshIndex.find(node->meshId);
+		node->m_mesh = mesh == m_meshIndex.end() ? 0 : mesh->second;
+
+		m_entities.add(node, tags);
 	}
+
 	for (SceneNode *child : root->children){
-		findBgNode(child);
+		registerEntities(child);
 	}
 }
 
-
 //----------------------------------------------------------------------------------------
-void Project::findEnemyNodes(SceneNode *root){
-	if (root->m_nodeType == NodeType::GeometryNode){
-		GeometryNode* enemy1 = static_cast<GeometryNode *>(root);
-		if (enemy1->isEnemy())
-			m_enemies.emplace_back(enemy1);
-	} /*else if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "e2"){
-		m_enemy2 = static_cast<GeometryNode *>(root);
-	}*/
-
-	//if (m_enemy1 != nullptr && m_enemy2 != nullptr) return;
-	for (SceneNode *child : root->children){
-		findEnemyNodes(child);
-	}
+// The player and enemies move, everything else but keyframed nodes stays put.
+void Project::buildBroadphase(){
+	std::vector<GeometryNode*> dynamicNodes;
+	m_entities.collect(ENTITY_PLAYER | ENTITY_ENEMY, dynamicNodes);
+	m_broadphase.build((SceneNode*)&*m_rootNode, dynamicNodes, 0);
 }
 
 //----------------------------------------------------------------------------------------
-void Project::findSpecialObjects(SceneNode *root){
-	if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "t1"){
-		m_transparentNode = static_cast<GeometryNode *>(root);
-		m_transparentNode->setTransparency(0.3f);
-	} else if (root->m_nodeType == NodeType::GeometryNode && root->m_name.size() == 2 && root->m_name[0] == 't'){
-		GeometryNode* node = static_cast<GeometryNode *>(root);
-		node->setTransparency(0.3f);
-	} else if (root->m_nodeType == NodeType::GeometryNode && root->m_name == "r1"){
-		m_reflectNode = static_cast<GeometryNode *>(root);
-	}
-
-	if (m_transparentNode != nullptr && m_reflectNode != nullptr) return;
-	for (SceneNode *child : root->children){
-		findSpecialObjects(child);
-	}
+// Every texture goes to the GPU once, here, rather than each time it's drawn.
+void Project::loadTextures(){
+	std::vector<GeometryNode*> nodes;
+	m_entities.collect(ENTITY_PLAYER | ENTITY_ENEMY | ENTITY_STATIC, nodes);
+	for (GeometryNode* node : nodes){
+		node->m_texture = m_textures.add(node->texture);
+	}
+	m_textures.upload();
 }
 
 
@@ -1539,8 +1646,10 @@ void Project::resetPosition(){
 
 
 void Project::resetAll(){
-	for (auto child : m_rootNode->children){
-		m_rootNode->remove_child(child);
+	m_entities.clear();
+	m_textures.release();
+	while (!m_rootNode->children.empty()){
+		m_rootNode->remove_child(m_rootNode->children.front());
 	}
 
 	processLuaSceneFile(m_luaSceneFile);
@@ -1549,18 +1658,16 @@ void Project::resetAll(){
 		cout << "reconstructed root node" << endl;
 	}
 
-	findPlayerNode((SceneNode*)&*m_rootNode);
-
-	findPlaneNode((SceneNode*)&*m_rootNode);
+	registerEntities((SceneNode*)&*m_rootNode);
+	loadTextures();
 
-	findEnemyNodes((SceneNode*)&*m_rootNode);
+	m_rootNode->update_world();
+	buildBroadphase();
+	m_staticShadowsDirty = true;
+	m_instancesDirty = true;
 
-	findSpecialObjects((SceneNode*)&*m_rootNode);
-
-	Bounds bounds(m_plane->hitbox->_pos, m_plane->hitbox->_maxXYZ);
-	//m_collisionTree = new CollisionTreeNode(bounds, 0);
-	m_collisionTree->clear();
-	m_collisionTree->construct((SceneNode*)&*m_rootNode);
+	m_particles.clear();
+	m_projectiles.clear();
 
 	m_start_time = clock();
 
@@ -1573,6 +1680,9 @@ void Project::resetAll(){
  */
 void Project::cleanup()
 {
+	m_textures.release();
+	m_frameData.destroy();
+	m_drawData.destroy();
 
 }
 
@@ -1628,7 +1738,10 @@ void Project::moveEnemy(GeometryNode* enemy){
 
 	double modifier = 0.5;
 	if (moving_enemies && !enemy->hasAnimation()){
-		enemy->translate(vec3(modifier*x, modifier*y, modifier*z));
+		vec3 step(modifier*x, modifier*y, modifier*z);
+		enemy->translate(step);
+		m_movers.push_back(enemy);
+		m_moverSteps.push_back(step);
 	}
 
 	if (danmaku){
@@ -1637,153 +1750,165 @@ void Project::moveEnemy(GeometryNode* enemy){
 		enemy->rotate('y', 2);
 		enemy->set_transform(trans * enemy->get_transform());
 	}
-	
-	if (moving_enemies && !enemy->hasAnimation()){
-		std::vector<GeometryNode*> collisions;
-		std::vector<vec3> axis;
-		m_collisionTree->collideGeometry(enemy, collisions, axis, false);
-		bool adjust(false);
-
-		for (int i = 0; i < collisions.size(); i++){
-			GeometryNode* collision = collisions[i];
-			//cout << collision->m_name << endl;
-			if (collision == m_plane || collision == enemy) {
-				continue;
-			} else if (collision->m_name.find("shot") != std::string::npos) {
-				continue;
-			} else if (collision == m_playerNode){
-				if (invincibilityTime <= 0){
-					lives--;
-					generateParticles(m_playerNode);
-					invincibilityTime = 50;
-					if (lives <=0){
-						removeNode((SceneNode*)&*m_rootNode, m_playerNode);
-					}
-				}
-				//continue;
-			}
-			adjust = true;
-		}
+}
 
-		if (adjust){
-			enemy->translate(vec3(-modifier*x, -modifier*y, -modifier*z));
-		}
+void Project::movePlayer(double x, double z){
+	if (m_playerNode == nullptr) return;
+	vec3 step(x, 0.0, z);
+	m_playerNode->translate(step);
+	m_movers.push_back(m_playerNode);
+	m_moverSteps.push_back(step);
+}
+
+void Project::hitPlayer(){
+	if (invincibilityTime > 0) return;
+	lives--;
+	generateParticles(m_playerNode);
+	invincibilityTime = 50;
+	if (lives <= 0){
+		removeNode(m_playerNode);
 	}
 }
 
-void Project::movePlayer(double x, double z, bool adjusting){
-	if (m_playerNode == nullptr) return;
-	dvec3 transl(x, 0.0, z);
-	m_playerNode->translate(transl);
-	std::vector<GeometryNode*> collisions;
-	std::vector<vec3> axis;
-	m_collisionTree->collideGeometry(m_playerNode, collisions, axis, false);
-	bool adjust(false);
-	//cout << "collisions: " << collisions.size() << endl;
-	for (int i = 0; i < collisions.size(); i++){
-		GeometryNode* collision = collisions[i];
-		//cout << collision->m_name << endl;
-		if (collision == m_plane || collision == m_playerNode) continue;
-		if (invincibilityTime <= 0 && collision->isEnemy()){//(collision == m_enemy1 || collision == m_enemy2)){
-			cout << "collided into " << collision->m_name << endl;
-			lives--;
-			generateParticles(m_playerNode);
-			invincibilityTime = 50;
-			if (lives <= 0){
-				removeNode((SceneNode*)&*m_rootNode, m_playerNode);
-			}
+//----------------------------------------------------------------------------------------
+// Everything moved this frame is collided in one broadphase query.  Enemies that ran
+// into something step back, the player is pushed back out of whatever they hit.
+void Project::resolveCollisions(){
+	if (m_movers.empty()) return;
+
+	m_pairs.clear();
+	m_broadphase.findPairs(m_movers, m_pairs);
+
+	std::vector<char> blocked(m_movers.size(), false);
+	for (const BroadphasePair & pair : m_pairs){
+		if (pair.other == m_plane) continue;
+
+		GeometryNode* mover = m_movers[pair.mover];
+		if ((mover == m_playerNode && m_entities.is(pair.other, ENTITY_ENEMY)) ||
+			(pair.other == m_playerNode && m_entities.is(mover, ENTITY_ENEMY))){
+			hitPlayer();
 		}
-		adjust = true;
+		blocked[pair.mover] = true;
+		if (pair.otherMover >= 0) blocked[pair.otherMover] = true;
 	}
 
-	if (adjust){
-		//cout << glm::to_string(transl_back) << endl;
-		double backx = 0;
-		double backz = 0;
-		if (abs(x) > std::numeric_limits<double>::epsilon()){
-			backx = std::copysign(0.1, adjusting ? x : -x);
+	vec3 playerStep(0.0f);
+	bool playerBlocked = false;
+	for (size_t i = 0; i < m_movers.size(); i++){
+		if (!blocked[i]) continue;
+		if (m_movers[i] == m_playerNode){
+			playerStep = m_moverSteps[i];
+			playerBlocked = true;
+		} else {
+			m_movers[i]->translate(-m_moverSteps[i]);
 		}
-		if (abs(z) > std::numeric_limits<double>::epsilon()){
-			backz = std::copysign(0.1, adjusting ? z : -z);
+	}
+	if (!playerBlocked) return;
+
+	// back out 0.1 at a time the way the player came until they're clear
+	vec3 back(0.0f);
+	if (abs(playerStep.x) > std::numeric_limits<float>::epsilon()){
+		back.x = std::copysign(0.1f, -playerStep.x);
+	}
+	if (abs(playerStep.z) > std::numeric_limits<float>::epsilon()){
+		back.z = std::copysign(0.1f, -playerStep.z);
+	}
+
+	std::vector<GeometryNode*> player(1, m_playerNode);
+	for (int i = 0; i < 100 && playerBlocked; i++){
+		m_playerNode->translate(back);
+
+		m_pairs.clear();
+		m_broadphase.findPairs(player, m_pairs);
+		playerBlocked = false;
+		for (const BroadphasePair & pair : m_pairs){
+			if (pair.other == m_plane) continue;
+			if (m_entities.is(pair.other, ENTITY_ENEMY)) hitPlayer();
+			playerBlocked = true;
 		}
+	}
+}
 
-		movePlayer(backx, backz, true);
+//----------------------------------------------------------------------------------------
+// A shot leaves from the shooter's origin along its -z, at one unit of its own per frame.
+void Project::spawnShot(GeometryNode* shooter, ProjectileOwner owner){
+	const mat4 & trans = shooter->get_transform();
+	vec3 position(trans[3]);
+	vec3 velocity(trans * vec4(0.0, 0.0, -1.0, 0.0));
+	float size = glm::length(vec3(trans[0]));
+
+	m_projectiles.spawn(position, velocity, size, owner);
+}
+
+//----------------------------------------------------------------------------------------
+// Everything but the plane stops shots, except the player for their own and enemies
+// for each other's.
+void Project::collectShotTargets(){
+	m_entities.collect(ENTITY_PLAYER | ENTITY_ENEMY | ENTITY_STATIC, m_shotTargetNodes);
+	m_shotTargetNodes.erase(std::remove(m_shotTargetNodes.begin(), m_shotTargetNodes.end(), m_plane),
+		m_shotTargetNodes.end());
+
+	for (GeometryNode* geometryNode : m_shotTargetNodes){
+		vec3 origin(geometryNode->getHitboxOrigin(m_current_time_secs));
+		vec3 halfSize(0.5 * geometryNode->hitbox->_maxXYZ);
+
+		ProjectileTarget target;
+		target.min = vec2(origin.x - halfSize.x, origin.z - halfSize.z);
+		target.max = vec2(origin.x + halfSize.x, origin.z + halfSize.z);
+		if (geometryNode == m_playerNode){
+			target.kind = ProjectileTargetKind::Player;
+		} else if (m_entities.is(geometryNode, ENTITY_ENEMY)){
+			target.kind = ProjectileTargetKind::Enemy;
+		} else {
+			target.kind = ProjectileTargetKind::Solid;
+		}
+		m_shotTargets.push_back(target);
 	}
 }
 
-void Project::checkShotCollisions(Shot* shot, bool enemy){
-	if (lives <= 0) return;
-	GeometryNode* node = shot->_self;
+//----------------------------------------------------------------------------------------
+void Project::collideShots(){
+	m_shotTargets.clear();
+	m_shotTargetNodes.clear();
+	collectShotTargets();
 
-	std::vector<GeometryNode*> collisions;
-	std::vector<vec3> axis;
-	m_collisionTree->collideGeometry(node, collisions, axis, false);
-	bool removeSelf = false;
+	m_shotHits.clear();
+	m_projectiles.collide(m_shotTargets, m_shotHits);
 
-	//cout << "shot collided with " << collisions.size() << "objects" <<endl;
+	if (lives <= 0) return;
 
-	for (int i = 0; i < collisions.size(); i++){
-		GeometryNode* collision = collisions[i];
-		//cout << shot->_self->m_name << " collided with " << collision->m_name << endl;
-		if (collision == m_plane){
-			continue;
-		} else if (collision->m_name.find("shot") != std::string::npos) {
-			continue;
-		} else if (collision->isEnemy() && !enemy){// == m_enemy1 || collision == m_enemy2){
-			
-			auto it = std::find(m_enemies.begin(), m_enemies.end(), collision);
-			if (it != m_enemies.end()){
+	for (const ProjectileHit & hit : m_shotHits){
+		GeometryNode* collision = m_shotTargetNodes[hit.target];
+
+		if (m_shotTargets[hit.target].kind == ProjectileTargetKind::Enemy){
+			// several shots can hit the same enemy in one frame
+			if (m_entities.is(collision, ENTITY_ENEMY)){
 				generateParticles(collision);
-				removeNode((SceneNode*)&*m_rootNode, collision);
-				removeSelf = true;
-				m_enemies.erase(it);
+				removeNode(collision);
 			}
-		} else if (collision == m_playerNode && enemy) {
+		} else if (m_shotTargets[hit.target].kind == ProjectileTargetKind::Player) {
 			if (invincibilityTime <= 0){
 				lives--;
 				generateParticles(m_playerNode);
 				invincibilityTime = 50;
 				if (lives <=0){
-					removeNode((SceneNode*)&*m_rootNode, m_playerNode);
+					removeNode(m_playerNode);
+					return;
 				}
 			}
-			removeSelf = true;
-		}else if (collision != m_playerNode && !collision->isEnemy()){
-			if(m_particles_on_all_collisions){
-				generateParticles(collision);
-			}
-			removeSelf = true;
-		}
-	}
-
-	if (removeSelf){
-		shot->_player->remove_child(shot->_self);
-		if (enemy){
-			auto it = std::find(m_enemyShots.begin(), m_enemyShots.end(), shot);
-			if (it != m_enemyShots.end()){
-				m_enemyShots.erase(it);
-			} 
-		} else {
-			auto it = std::find(m_shots.begin(), m_shots.end(), shot);
-			if (it != m_shots.end()){
-				m_shots.erase(it);
-			} 
+		} else if (m_particles_on_all_collisions){
+			generateParticles(collision);
 		}
 	}
 }
 
-void Project::removeNode(SceneNode* root, GeometryNode* target){
-	if (root == nullptr) return;
-	for (SceneNode* child : root->children){
-		if (child->m_nodeType == NodeType::GeometryNode){
-			GeometryNode * geometryNode = static_cast<GeometryNode *>(child);
-			if (geometryNode == target){
-				//cout << "removing "<< target->m_name << endl; 
-				root->remove_child(child);
-				return;
-			}
-		}
-		removeNode(child, target);
+void Project::removeNode(GeometryNode* target){
+	if (m_entities.is(target, ENTITY_STATIC)){
+		m_staticShadowsDirty = true;
+		m_instancesDirty = true;
+	}
+	if (m_entities.remove(m_entities.handleOf(target))){
+		m_broadphase.remove(target);
 	}
 }
 
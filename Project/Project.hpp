@@ -3,14 +3,19 @@
 #include "cs488-framework/CS488Window.hpp"
 #include "cs488-framework/OpenGLImport.hpp"
 #include "cs488-framework/ShaderProgram.hpp"
+#include "cs488-framework/UniformBuffer.hpp"
 #include "cs488-framework/MeshConsolidator.hpp"
 
 #include "SceneNode.hpp"
 #include "GeometryNode.hpp"
-#include "CollisionTree.hpp"
+#include "Broadphase.hpp"
+#include "BoundsHierarchy.hpp"
+#include "RenderQueue.hpp"
+#include "EntityRegistry.hpp"
 #include "Texture.hpp"
-#include "Shot.hpp"
-#include "Particle.hpp"
+#include "TextureManager.hpp"
+#include "ParticleSystem.hpp"
+#include "ProjectileSystem.hpp"
 
 #include <glm/glm.hpp>
 #include <memory>
@@ -19,13 +24,64 @@
 #include <ctime>
 #include <random>
 
-#define MAX_PARTICLES 500
+#define MAX_PARTICLES 65536
+#define MAX_PROJECTILES 131072
+#define SHADOW_MAP_SIZE 1024
+
+// uniform buffer binding points
+#define FRAME_DATA_BINDING 0
+#define DRAW_DATA_BINDING 1
+#define DRAW_DATA_RING_SIZE (1 << 20)
+
+// layout(location) of instanceModel in VertexShader.vs and shadow_VertexShader.vs
+#define INSTANCE_MODEL_LOCATION 8
 
 struct LightSource {
 	glm::vec3 position;
 	glm::vec3 rgbIntensity;
 };
 
+// The std140 layouts of the FrameData and DrawData blocks in the shaders, vec3s and
+// mat3 columns padded out to 16 bytes.
+struct FrameData {
+	glm::mat4 perspective;
+	glm::mat4 view;
+	glm::mat4 depthBias;
+	glm::vec3 lightPosition;
+	float pad0;
+	glm::vec3 lightRgbIntensity;
+	float pad1;
+	glm::vec3 ambientIntensity;
+	float pad2;
+};
+
+struct DrawData {
+	glm::mat4 modelView;
+	glm::mat4 nextModelView;
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];
+	glm::vec3 kd;
+	float pad0;
+	glm::vec3 ks;
+	float shininess;
+	float alpha;
+	float pad1[3];
+	float time0;
+	float time1;
+	float curTime;
+	int32_t instanced;
+
+	void setNormalMatrix(const glm::mat3 & m);
+};
+
+// Static nodes with the same mesh, material and texture, drawn in one go.  Their world
+// matrices are [first, first + count) of the instance buffer and of m_instancedNodes.
+struct InstanceGroup {
+	GeometryNode* node; // the first, for the mesh, material and texture
+	uint32_t first;
+	uint32_t count;
+};
+
 
 class Project : public CS488Window {
 public:
@@ -56,25 +112,24 @@ protected:
 	void mapVboDataToVertexShaderInputLocations();
 	void initViewMatrix();
 	void initLightSources();
-	void findPlayerNode(SceneNode *root);
-	void findPlaneNode(SceneNode *root);
-	void findBgNode(SceneNode *root);
-	void findEnemyNodes(SceneNode *root);
-	void findSpecialObjects(SceneNode *root);
+	void initShadowMaps();
+	void registerEntities(SceneNode *root);
+	void buildBroadphase();
 
 	void initPerspectiveMatrix();
 	void uploadCommonSceneUniforms();
+	void uploadFrameUniforms();
 	void renderSceneGraph(const SceneNode &node, bool inReflectionMode = false);
-	void renderNodes(SceneNode *root, bool inReflectionMode = false);
-	void renderHitbox(GeometryNode *node);
-	void renderTransparentObjects(SceneNode *root);
-	void getShadowMap(SceneNode* root);
-	void getNodeShadows(SceneNode* root);
+	void queueNodes(SceneNode *root, bool inReflectionMode, const glm::mat4 & model);
+	void executeRenderQueue(RenderLayer layer);
+	void getShadowMap();
+	void getNodeShadows(const std::vector<GeometryNode*> & casters);
 	void drawReflection(SceneNode* root);
+	void cullNodes();
 	void drawPlane();
 	void applyTexture(GeometryNode* node);
-	void renderAnimatedObject(GeometryNode* node, bool inReflectionMode = false);
-	void drawShot(Shot* shot);
+	void loadTextures();
+	void drawProjectiles();
 
 	void drawParticles();
 	void generateParticles(GeometryNode* node);
@@ -86,11 +141,15 @@ protected:
 	void resetPosition();
 	void resetAll();
 
-	void movePlayer(double x, double z, bool adjusting = false);
+	void movePlayer(double x, double z);
 	void moveEnemy(GeometryNode* enemy);
-	void checkShotCollisions(Shot* shot, bool enemy = false);
+	void resolveCollisions();
+	void hitPlayer();
+	void spawnShot(GeometryNode* shooter, ProjectileOwner owner);
+	void collideShots();
+	void collectShotTargets();
 	void rotateShot(double x);
-	void removeNode(SceneNode* root, GeometryNode* target);
+	void removeNode(GeometryNode* target);
 
 	clock_t m_start_time;
 	clock_t m_current_time;
@@ -110,20 +169,57 @@ protected:
 
 	//-- GL resources for mesh geometry data:
 	GLuint m_vao_meshData;
-	GLuint m_vbo_vertexPositions;
-	GLuint m_vbo_vertexNormals;
-	GLuint m_vbo_vertexUV;
+	GLuint m_vbo_vertexData;
+	GLuint m_ebo_meshIndices;
 	GLint m_positionAttribLocation;
 	GLint m_normalAttribLocation;
 	GLint m_textureAttrribLocation;
 	GLint m_shadow_positionAttribLocation;
 	ShaderProgram m_shader;
 	GLuint m_framebuffer;
-	GLuint m_texture;
+	TextureManager m_textures;
 	GLuint m_shadowMap;
+	GLuint m_staticShadowFramebuffer;
+	GLuint m_staticShadowMap;       // static casters only, copied into m_shadowMap each frame
+	bool m_staticShadowsDirty;
+	std::vector<GeometryNode*> m_shadowCasters;
 	ShaderProgram m_shader_shadow;
 
-	std::vector<Particle*> particles;
+	//-- GL resources for particles, drawn as instanced cubes:
+	ParticleSystem m_particles;
+	std::vector<float> m_particleInstances;
+	GLuint m_vao_particles;
+	GLuint m_vbo_particleInstances;
+	GLint m_particle_positionAttribLocation;
+	GLint m_particle_normalAttribLocation;
+	GLint m_particle_instanceAttribLocation;
+	ShaderProgram m_shader_particles;
+
+	//-- Shots, drawn as instanced planes:
+	ProjectileSystem m_projectiles;
+	std::vector<float> m_projectileInstances;
+	std::vector<ProjectileTarget> m_shotTargets;
+	std::vector<GeometryNode*> m_shotTargetNodes;
+	std::vector<ProjectileHit> m_shotHits;
+	GLuint m_vao_projectiles;
+	GLuint m_vbo_projectileInstances;
+	GLint m_projectile_positionAttribLocation;
+	GLint m_projectile_normalAttribLocation;
+	GLint m_projectile_instanceAttribLocation;
+	GLint m_projectile_velocityAttribLocation;
+	ShaderProgram m_shader_projectiles;
+
+	//-- Repeated static meshes, drawn instanced:
+	std::vector<InstanceGroup> m_instanceGroups;
+	std::vector<GeometryNode*> m_instancedNodes;
+	std::vector<glm::mat4> m_instanceModels;
+	GLuint m_vao_instanced;
+	GLuint m_vbo_instanceModels;
+	bool m_instancesDirty;
+	void buildInstanceGroups();
+	void queueInstanceGroups(bool inReflectionMode, const glm::mat4 & rootModel);
+	void bindInstanceGroup(const InstanceGroup & group);
+	void getInstanceShadows();
 
 	bool m_doShadowMapping;
 	bool m_drawReflection;
@@ -140,6 +236,13 @@ protected:
 	// object. Each BatchInfo object contains an index offset and the number of indices
 	// required to render the mesh with identifier MeshId.
 	BatchInfoMap m_batchInfoMap;
+	std::unordered_map<MeshId, uint32_t> m_meshIndex; // GeometryNode::m_mesh by meshId
+	std::vector<BatchInfo> m_meshes;
+
+	RenderQueue m_renderQueue;
+	UniformBuffer m_frameData;
+	UniformBuffer m_drawData; // ring of DrawData blocks
+	std::vector<size_t> m_drawOffsets; // in m_drawData, by packet in the layer being drawn
 
 	std::string m_luaSceneFile;
 
@@ -154,11 +257,33 @@ protected:
 	GeometryNode* m_enemy2;
 	GeometryNode* m_transparentNode;
 	GeometryNode* m_reflectNode;
-	CollisionTreeNode* m_collisionTree;
-	std::vector<Shot*> m_shots;
-	std::vector<Shot*> m_enemyShots;
-	int shotId;
-	std::vector<GeometryNode*> m_enemies;
+	EntityRegistry m_entities;
+	Broadphase m_broadphase;
+	std::vector<GeometryNode*> m_movers; // moved this frame, by m_moverSteps
+	std::vector<glm::vec3> m_moverSteps;
+	std::vector<BroadphasePair> m_pairs;
+	std::vector<GeometryNode*> m_enemies; // this frame's, from m_entities
+
+	// Each pass draws only the nodes whose world bounds touch its view volume.
+	enum CullPass {
+		CULL_CAMERA,
+		CULL_SHADOW,
+		CULL_REFLECTION,
+		CULL_PASSES
+	};
+	void cullPass(CullPass pass, const Frustum & frustum, uint32_t slots);
+	bool isVisible(CullPass pass, const GeometryNode* node) const;
+	bool isVisible(CullPass pass, const InstanceGroup & group) const;
+
+	BoundsHierarchy m_boundsHierarchy;
+	std::vector<GeometryNode*> m_boundsNodes;   // leaves of m_boundsHierarchy
+	std::vector<GeometryNode*> m_boundsScratch;
+	std::vector<glm::vec3> m_boundsMin;
+	std::vector<glm::vec3> m_boundsMax;
+	std::vector<uint8_t> m_culled;
+	std::vector<uint8_t> m_visible[CULL_PASSES]; // by entity slot
+	size_t m_drawnCount[CULL_PASSES];
+	size_t m_culledCount[CULL_PASSES];
 
 	enum Mode {
 		POSITION,
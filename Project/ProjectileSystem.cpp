@@ -0,0 +1,239 @@
+#include "ProjectileSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// half the shot's hitbox in x and z
+#define PROJECTILE_HALF_WIDTH 0.025f
+#define PROJECTILE_HALF_DEPTH 0.1f
+
+// side of a grid cell, and how far past the targets shots are kept
+#define PROJECTILE_CELL_SIZE 2.0f
+#define PROJECTILE_MARGIN 2.0f
+#define PROJECTILE_MAX_CELLS 256
+
+//---------------------------------------------------------------------------------------
+ProjectileSystem::ProjectileSystem(size_t capacity)
+	: m_capacity(capacity),
+	  m_end(0),
+	  m_alive(0),
+	  m_x(capacity), m_y(capacity), m_z(capacity),
+	  m_vx(capacity), m_vy(capacity), m_vz(capacity),
+	  m_size(capacity),
+	  m_owner(capacity),
+	  m_live(capacity, 0),
+	  m_gridMin(0.0f),
+	  m_inverseCellSize(1.0f / PROJECTILE_CELL_SIZE),
+	  m_gridWidth(0),
+	  m_gridDepth(0),
+	  m_cell(capacity)
+{
+	m_free.reserve(capacity);
+}
+
+//---------------------------------------------------------------------------------------
+bool ProjectileSystem::spawn(const glm::vec3 & position, const glm::vec3 & velocity, float size, ProjectileOwner owner)
+{
+	size_t i;
+	if (!m_free.empty()) {
+		i = m_free.back();
+		m_free.pop_back();
+	} else if (m_end < m_capacity) {
+		i = m_end++;
+	} else {
+		return false;
+	}
+
+	m_x[i] = position.x;
+	m_y[i] = position.y;
+	m_z[i] = position.z;
+	m_vx[i] = velocity.x;
+	m_vy[i] = velocity.y;
+	m_vz[i] = velocity.z;
+	m_size[i] = size;
+	m_owner[i] = owner;
+	m_live[i] = 1;
+	m_alive++;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+void ProjectileSystem::kill(size_t i)
+{
+	m_live[i] = 0;
+	m_free.push_back(i);
+	m_alive--;
+}
+
+//---------------------------------------------------------------------------------------
+void ProjectileSystem::advance()
+{
+	size_t n = m_end;
+
+	// free slots move too, it's cheaper than branching around them
+	float * x = m_x.data();
+	float * y = m_y.data();
+	float * z = m_z.data();
+	const float * vx = m_vx.data();
+	const float * vy = m_vy.data();
+	const float * vz = m_vz.data();
+	for (size_t i = 0; i < n; i++) {
+		x[i] += vx[i];
+		y[i] += vy[i];
+		z[i] += vz[i];
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Counting sort of the targets into cells.  Targets are grown by the shot's hitbox,
+// so testing only the cell under a shot's centre finds everything it overlaps.
+void ProjectileSystem::buildGrid(const std::vector<ProjectileTarget> & targets)
+{
+	glm::vec2 lo(INFINITY), hi(-INFINITY);
+	for (const ProjectileTarget & target : targets) {
+		lo = glm::min(lo, target.min);
+		hi = glm::max(hi, target.max);
+	}
+	lo -= glm::vec2(PROJECTILE_MARGIN);
+	hi += glm::vec2(PROJECTILE_MARGIN);
+
+	glm::vec2 extent = hi - lo;
+	float cellSize = std::max(PROJECTILE_CELL_SIZE, std::max(extent.x, extent.y) / PROJECTILE_MAX_CELLS);
+	m_gridMin = lo;
+	m_inverseCellSize = 1.0f / cellSize;
+	m_gridWidth = std::max(1, (int)std::ceil(extent.x * m_inverseCellSize));
+	m_gridDepth = std::max(1, (int)std::ceil(extent.y * m_inverseCellSize));
+
+	const glm::vec2 pad(PROJECTILE_HALF_WIDTH, PROJECTILE_HALF_DEPTH);
+	auto cellRange = [&](const ProjectileTarget & target, int & x0, int & z0, int & x1, int & z1) {
+		glm::vec2 a = (target.min - pad - m_gridMin) * m_inverseCellSize;
+		glm::vec2 b = (target.max + pad - m_gridMin) * m_inverseCellSize;
+		x0 = glm::clamp((int)a.x, 0, m_gridWidth - 1);
+		z0 = glm::clamp((int)a.y, 0, m_gridDepth - 1);
+		x1 = glm::clamp((int)b.x, 0, m_gridWidth - 1);
+		z1 = glm::clamp((int)b.y, 0, m_gridDepth - 1);
+	};
+
+	int cells = m_gridWidth*m_gridDepth;
+	m_cellStart.assign(cells + 1, 0);
+	for (const ProjectileTarget & target : targets) {
+		int x0, z0, x1, z1;
+		cellRange(target, x0, z0, x1, z1);
+		for (int cz = z0; cz <= z1; cz++) {
+			for (int cx = x0; cx <= x1; cx++) {
+				m_cellStart[cz*m_gridWidth + cx + 1]++;
+			}
+		}
+	}
+	for (int c = 0; c < cells; c++) {
+		m_cellStart[c + 1] += m_cellStart[c];
+	}
+
+	m_cellTargets.resize(m_cellStart[cells]);
+	std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+	for (size_t t = 0; t < targets.size(); t++) {
+		int x0, z0, x1, z1;
+		cellRange(targets[t], x0, z0, x1, z1);
+		for (int cz = z0; cz <= z1; cz++) {
+			for (int cx = x0; cx <= x1; cx++) {
+				m_cellTargets[fill[cz*m_gridWidth + cx]++] = t;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+void ProjectileSystem::collide(const std::vector<ProjectileTarget> & targets, std::vector<ProjectileHit> & hits)
+{
+	size_t n = m_end;
+	if (m_alive == 0) return;
+
+	if (targets.empty()) {
+		clear();
+		return;
+	}
+
+	buildGrid(targets);
+
+	// cell under every shot, in one pass
+	const float * x = m_x.data();
+	const float * z = m_z.data();
+	int * cell = m_cell.data();
+	for (size_t i = 0; i < n; i++) {
+		float gx = (x[i] - m_gridMin.x) * m_inverseCellSize;
+		float gz = (z[i] - m_gridMin.y) * m_inverseCellSize;
+		bool inside = gx >= 0.0f && gz >= 0.0f && gx < m_gridWidth && gz < m_gridDepth;
+		cell[i] = inside ? (int)gz*m_gridWidth + (int)gx : -1;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (!m_live[i]) continue;
+		if (cell[i] < 0) {
+			kill(i);
+			continue;
+		}
+
+		glm::vec2 lo(x[i] - PROJECTILE_HALF_WIDTH, z[i] - PROJECTILE_HALF_DEPTH);
+		glm::vec2 hi(x[i] + PROJECTILE_HALF_WIDTH, z[i] + PROJECTILE_HALF_DEPTH);
+		ProjectileTargetKind friendly = m_owner[i] == ProjectileOwner::Player ?
+			ProjectileTargetKind::Player : ProjectileTargetKind::Enemy;
+
+		bool hit = false;
+		for (uint32_t k = m_cellStart[cell[i]]; k < m_cellStart[cell[i] + 1]; k++) {
+			uint32_t t = m_cellTargets[k];
+			const ProjectileTarget & target = targets[t];
+			if (target.kind == friendly) continue;
+			if (lo.x < target.max.x && hi.x > target.min.x && lo.y < target.max.y && hi.y > target.min.y) {
+				hits.push_back({ t, m_owner[i] });
+				hit = true;
+			}
+		}
+		if (hit) kill(i);
+	}
+
+	// start over from the front once everything is dead
+	if (m_alive == 0) {
+		clear();
+	}
+}
+
+//---------------------------------------------------------------------------------------
+size_t ProjectileSystem::gather(float * instances) const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_end; i++) {
+		if (!m_live[i]) continue;
+		float * instance = instances + count*PROJECTILE_INSTANCE_FLOATS;
+		instance[0] = m_x[i];
+		instance[1] = m_y[i];
+		instance[2] = m_z[i];
+		instance[3] = m_size[i];
+		instance[4] = m_vx[i];
+		instance[5] = m_vy[i];
+		instance[6] = m_vz[i];
+		instance[7] = (float)m_owner[i];
+		count++;
+	}
+	return count;
+}
+
+//---------------------------------------------------------------------------------------
+void ProjectileSystem::clear()
+{
+	std::fill(m_live.begin(), m_live.begin() + m_end, 0);
+	m_free.clear();
+	m_end = 0;
+	m_alive = 0;
+}
+
+//---------------------------------------------------------------------------------------
+size_t ProjectileSystem::size() const
+{
+	return m_alive;
+}
+
+//---------------------------------------------------------------------------------------
+size_t ProjectileSystem::capacity() const
+{
+	return m_capacity;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Floats per instance handed to the GPU: position xyz and size, then velocity xyz
+// (the shot is turned to face it) and owner
+#define PROJECTILE_INSTANCE_FLOATS 8
+
+enum class ProjectileOwner : uint8_t {
+	Player,
+	Enemy
+};
+
+enum class ProjectileTargetKind : uint8_t {
+	Solid,  // stops every shot
+	Player, // only hit by enemy shots
+	Enemy   // only hit by the player's shots
+};
+
+// Something shots can hit: its hitbox in the xz plane, the same test as the
+// collision tree makes.
+struct ProjectileTarget {
+	glm::vec2 min;
+	glm::vec2 max;
+	ProjectileTargetKind kind;
+};
+
+struct ProjectileHit {
+	uint32_t target;
+	ProjectileOwner owner;
+};
+
+// Fixed-capacity pool of shots, one array per attribute, recycled through a free list.
+// Shots aren't scene nodes: they are moved in one pass over the arrays and collided
+// all at once against a uniform grid of the targets.
+class ProjectileSystem {
+public:
+	ProjectileSystem(size_t capacity);
+
+	// Returns false, dropping the shot, if every slot is taken.
+	bool spawn(const glm::vec3 & position, const glm::vec3 & velocity, float size, ProjectileOwner owner);
+
+	// Moves every shot one frame along its velocity.
+	void advance();
+
+	// Frees the shots that hit a target, adding one entry to hits per (shot, target)
+	// pair, and the shots outside the targets' bounds, which can't hit anything again.
+	void collide(const std::vector<ProjectileTarget> & targets, std::vector<ProjectileHit> & hits);
+
+	// Writes PROJECTILE_INSTANCE_FLOATS floats per live shot, returns how many.
+	size_t gather(float * instances) const;
+
+	void clear();
+
+	size_t size() const;
+	size_t capacity() const;
+
+private:
+	void buildGrid(const std::vector<ProjectileTarget> & targets);
+	void kill(size_t i);
+
+	size_t m_capacity;
+	size_t m_end;   // slots past this have never been used
+	size_t m_alive;
+
+	std::vector<float> m_x, m_y, m_z;
+	std::vector<float> m_vx, m_vy, m_vz;
+	std::vector<float> m_size;
+	std::vector<ProjectileOwner> m_owner;
+	std::vector<uint8_t> m_live;
+
+	std::vector<uint32_t> m_free;
+
+	// targets by grid cell, cell c's are m_cellTargets[m_cellStart[c] .. m_cellStart[c+1])
+	glm::vec2 m_gridMin;
+	float m_inverseCellSize;
+	int m_gridWidth;
+	int m_gridDepth;
+	std::vector<uint32_t> m_cellStart;
+	std::vector<uint32_t> m_cellTargets;
+	std::vector<int> m_cell; // per shot, -1 outside the grid
+};
@@ -0,0 +1,87 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// view distances past this all sort the same
+#define RENDER_DEPTH_RANGE 100.0f
+
+//---------------------------------------------------------------------------------------
+RenderQueue::RenderQueue()
+	: m_count(0)
+{
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::reset(size_t capacity)
+{
+	if (m_packets.size() < capacity) {
+		m_packets.resize(capacity);
+		m_draws.resize(capacity);
+	}
+	m_count = 0;
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::push(uint64_t key, const RenderDraw & draw)
+{
+	assert(m_count < m_packets.size());
+	size_t i = m_count++;
+	m_draws[i] = draw;
+	m_packets[i].key = key;
+	m_packets[i].draw = i;
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::sort()
+{
+	std::sort(m_packets.begin(), m_packets.begin() + m_count, [](const RenderPacket & a, const RenderPacket & b) {
+		return a.key < b.key || (a.key == b.key && a.draw < b.draw);
+	});
+}
+
+//---------------------------------------------------------------------------------------
+void RenderQueue::range(RenderLayer layer, size_t & begin, size_t & end) const
+{
+	auto first = m_packets.begin(), last = m_packets.begin() + m_count;
+	auto layerOf = [](const RenderPacket & packet) { return (uint32_t)(packet.key >> 62); };
+	begin = std::partition_point(first, last, [&](const RenderPacket & p) { return layerOf(p) < layer; }) - first;
+	end = std::partition_point(first, last, [&](const RenderPacket & p) { return layerOf(p) <= layer; }) - first;
+}
+
+//---------------------------------------------------------------------------------------
+const RenderPacket & RenderQueue::packet(size_t i) const
+{
+	return m_packets[i];
+}
+
+//---------------------------------------------------------------------------------------
+const RenderDraw & RenderQueue::draw(uint32_t i) const
+{
+	return m_draws[i];
+}
+
+//---------------------------------------------------------------------------------------
+size_t RenderQueue::size() const
+{
+	return m_count;
+}
+
+//---------------------------------------------------------------------------------------
+// From the top bit down: layer (2), then for opaque layers kind (3), texture (12),
+// mesh (12), depth (24); for the transparent layer the depth, reversed, comes first.
+uint64_t RenderQueue::makeKey(RenderLayer layer, RenderKind kind, uint32_t texture, uint32_t mesh, float depth)
+{
+	uint64_t d = (uint64_t)(std::min(std::max(depth / RENDER_DEPTH_RANGE, 0.0f), 1.0f) * 0xFFFFFF);
+	uint64_t k = (uint64_t)kind & 0x7;
+	uint64_t t = texture & 0xFFF;
+	uint64_t m = mesh & 0xFFF;
+
+	uint64_t key = (uint64_t)layer << 62;
+	if (layer == RENDER_LAYER_TRANSPARENT) {
+		key |= (0xFFFFFF - d) << 38 | k << 35 | t << 23 | m << 11;
+	} else {
+		key |= k << 59 | t << 47 | m << 35 | d << 11;
+	}
+	return key;
+}
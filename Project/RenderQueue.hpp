@@ -0,0 +1,71 @@
+#pragma once
+
+#include "GeometryNode.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Layers run in this order, each with its own GL state.
+enum RenderLayer : uint32_t {
+	RENDER_LAYER_REFLECTION,
+	RENDER_LAYER_OPAQUE,
+	RENDER_LAYER_TRANSPARENT
+};
+
+// How a draw is made, each kind sets up the shader its own way.
+enum class RenderKind : uint8_t {
+	Mesh,     // a node at its world transform
+	Animated, // a keyframed node, interpolated in the vertex shader
+	Hitbox,   // a node's hitbox as lines
+	Instanced // a group of identical static nodes in one instanced draw
+};
+
+// Everything needed to make one draw once the queue is sorted.
+struct RenderDraw {
+	glm::mat4 model;
+	GeometryNode* node;
+	uint32_t mesh;
+	RenderKind kind;
+	uint32_t group; // RenderKind::Instanced only, which one
+};
+
+// The sort key and which draw it's for.
+struct RenderPacket {
+	uint64_t key;
+	uint32_t draw;
+};
+
+// Traversal fills the queue with packets instead of drawing as it goes.  Sorting by
+// key then groups the draws by layer, shader set-up, texture and mesh, so state only
+// changes between groups, with opaque draws front to back inside a group and
+// transparent ones back to front across the whole layer.
+class RenderQueue {
+public:
+	RenderQueue();
+
+	// Empties the queue, with room for capacity packets.
+	void reset(size_t capacity);
+
+	// Between reset() and sort().  The capacity given to reset() must cover every push.
+	void push(uint64_t key, const RenderDraw & draw);
+
+	void sort();
+
+	// After sort(), the packets in layer are [begin, end).
+	void range(RenderLayer layer, size_t & begin, size_t & end) const;
+
+	const RenderPacket & packet(size_t i) const;
+	const RenderDraw & draw(uint32_t i) const;
+
+	size_t size() const;
+
+	// depth is the view distance, mesh and texture are at most 12 bits.
+	static uint64_t makeKey(RenderLayer layer, RenderKind kind, uint32_t texture, uint32_t mesh, float depth);
+
+private:
+	std::vector<RenderPacket> m_packets;
+	std::vector<RenderDraw> m_draws;
+	size_t m_count;
+};
@@ -3,6 +3,7 @@
 #include "cs488-framework/MathUtils.hpp"
 
 #include <iostream>
+#include <iterator>
 #include <sstream>
 using namespace std;
 
@@ -23,8 +24,11 @@ SceneNode::SceneNode(const std::string& name)
 	m_nodeType(NodeType::SceneNode),
 	trans(mat4()),
 	invtrans(mat4()),
+	world(mat4()),
+	world_dirty(true),
 	undo_rot(mat4()),
 	isSelected(false),
+	parent(nullptr),
 	m_nodeId(nodeInstanceCount++)
 {
 
@@ -36,10 +40,16 @@ SceneNode::SceneNode(const SceneNode & other)
 	: m_nodeType(other.m_nodeType),
 	  m_name(other.m_name),
 	  trans(other.trans),
-	  invtrans(other.invtrans)
+	  invtrans(other.invtrans),
+	  world(other.world),
+	  world_dirty(true),
+	  parent(nullptr)
 {
 	for(SceneNode * child : other.children) {
-		this->children.push_front(new SceneNode(*child));
+		SceneNode * copy = new SceneNode(*child);
+		this->children.push_front(copy);
+		copy->parent = this;
+		copy->self_in_parent = this->children.begin();
 	}
 }
 
@@ -54,6 +64,20 @@ SceneNode::~SceneNode() {
 void SceneNode::set_transform(const glm::mat4& m) {
 	trans = m;
 	invtrans = glm::inverse(m);
+	world_dirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+void SceneNode::update_world(const glm::mat4& parentWorld, bool parentChanged) {
+	bool changed = parentChanged || world_dirty;
+	if (changed) {
+		world = parentWorld * trans;
+		world_dirty = false;
+	}
+
+	for (SceneNode * child : children) {
+		child->update_world(world, changed);
+	}
 }
 
 //---------------------------------------------------------------------------------------
@@ -61,6 +85,11 @@ const glm::mat4& SceneNode::get_transform() const {
 	return trans;
 }
 
+//---------------------------------------------------------------------------------------
+const glm::mat4& SceneNode::get_world_transform() const {
+	return world;
+}
+
 //---------------------------------------------------------------------------------------
 const glm::mat4& SceneNode::get_inverse() const {
 	return invtrans;
@@ -68,12 +97,21 @@ const glm::mat4& SceneNode::get_inverse() const {
 
 //---------------------------------------------------------------------------------------
 void SceneNode::add_child(SceneNode* child) {
+	if (child->parent != nullptr) {
+		child->parent->remove_child(child);
+	}
 	children.push_back(child);
+	child->parent = this;
+	child->self_in_parent = std::prev(children.end());
+	// its cached world is still relative to wherever it was before
+	child->world_dirty = true;
 }
 
 //---------------------------------------------------------------------------------------
 void SceneNode::remove_child(SceneNode* child) {
-	children.remove(child);
+	if (child->parent != this) return;
+	children.erase(child->self_in_parent);
+	child->parent = nullptr;
 }
 
 //---------------------------------------------------------------------------------------
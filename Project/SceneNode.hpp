@@ -46,11 +46,19 @@ public:
     
     const glm::mat4& get_transform() const;
     const glm::mat4& get_inverse() const;
+
+    // trans composed with every ancestor's, as of the last update_world()
+    const glm::mat4& get_world_transform() const;
     
     void set_transform(const glm::mat4& m);
+
+    // Recomputes the cached world transforms below this node, only for nodes whose
+    // trans, or an ancestor's, changed since the last update.
+    void update_world(const glm::mat4& parentWorld = glm::mat4(), bool parentChanged = false);
     
     void add_child(SceneNode* child);
     
+    // O(1), child must be one of children
     void remove_child(SceneNode* child);
 
 	void set_keyframe_parent_transform(const glm::mat4& parentTrans);
@@ -72,9 +80,14 @@ public:
     // Transformations
     glm::mat4 trans;
     glm::mat4 invtrans;
+    glm::mat4 world;
+    bool world_dirty; // trans or parent changed since world was computed
 	glm::mat4 undo_rot;
     
     std::list<SceneNode*> children;
+    SceneNode* parent;
+    std::list<SceneNode*>::iterator self_in_parent; // where parent->children holds this
+
 
 	NodeType m_nodeType;
 	std::string m_name;
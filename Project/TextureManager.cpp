@@ -0,0 +1,164 @@
+#include "TextureManager.hpp"
+
+#include "cs488-framework/GlErrorCheck.hpp"
+#include "cs488-framework/GlState.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//---------------------------------------------------------------------------------------
+TextureManager::TextureManager()
+	: m_uploaded(0)
+{
+}
+
+//---------------------------------------------------------------------------------------
+TextureHandle TextureManager::add(const Texture & texture)
+{
+	if (texture._data == nullptr) return TEXTURE_NONE;
+
+	auto found = m_handleOf.find(texture._data);
+	if (found != m_handleOf.end()) return found->second;
+
+	Entry entry;
+	entry.pixels = texture._data;
+	entry.width = texture._w;
+	entry.height = texture._h;
+	entry.texture = 0;
+	entry.rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	m_entries.push_back(entry);
+
+	TextureHandle handle = m_entries.size();
+	m_handleOf[texture._data] = handle;
+	return handle;
+}
+
+//---------------------------------------------------------------------------------------
+void TextureManager::upload()
+{
+	std::vector<uint32_t> small;
+	for (size_t i = m_uploaded; i < m_entries.size(); i++) {
+		Entry & entry = m_entries[i];
+		if (entry.width <= TEXTURE_ATLAS_MAX_SIZE && entry.height <= TEXTURE_ATLAS_MAX_SIZE) {
+			small.push_back(i);
+			continue;
+		}
+
+		glGenTextures(1, &entry.texture);
+		GlState::bindTexture(GL_TEXTURE_2D, entry.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, entry.width, entry.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, entry.pixels);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		CHECK_GL_ERRORS;
+		m_textures.push_back(entry.texture);
+	}
+
+	// tallest first, packed left to right in shelves
+	std::sort(small.begin(), small.end(), [&](uint32_t a, uint32_t b) {
+		return m_entries[a].height > m_entries[b].height;
+	});
+	std::vector<uint32_t> atlas;
+	unsigned int x = 0, y = 0, shelf = 0;
+	for (uint32_t i : small) {
+		unsigned int w = m_entries[i].width + 2*TEXTURE_ATLAS_PADDING;
+		unsigned int h = m_entries[i].height + 2*TEXTURE_ATLAS_PADDING;
+		if (x + w > TEXTURE_ATLAS_SIZE) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		if (y + h > TEXTURE_ATLAS_SIZE) {
+			uploadAtlas(atlas);
+			atlas.clear();
+			x = y = shelf = 0;
+		}
+		m_entries[i].rect = glm::vec4(x + TEXTURE_ATLAS_PADDING, y + TEXTURE_ATLAS_PADDING, 0.0f, 0.0f);
+		atlas.push_back(i);
+		x += w;
+		shelf = std::max(shelf, h);
+	}
+	if (!atlas.empty()) uploadAtlas(atlas);
+
+	GlState::bindTexture(GL_TEXTURE_2D, 0);
+	m_uploaded = m_entries.size();
+}
+
+//---------------------------------------------------------------------------------------
+// entries have their texel position in the atlas in rect.xy, which becomes their UV
+// offset and scale once the atlas size is known.
+void TextureManager::uploadAtlas(const std::vector<uint32_t> & entries)
+{
+	unsigned int width = 1, height = 1;
+	for (uint32_t i : entries) {
+		const Entry & entry = m_entries[i];
+		width = std::max(width, (unsigned int)entry.rect.x + entry.width + TEXTURE_ATLAS_PADDING);
+		height = std::max(height, (unsigned int)entry.rect.y + entry.height + TEXTURE_ATLAS_PADDING);
+	}
+
+	std::vector<unsigned char> texels(width*height*4, 0);
+	for (uint32_t i : entries) {
+		const Entry & entry = m_entries[i];
+		int x0 = (int)entry.rect.x, y0 = (int)entry.rect.y;
+		int w = entry.width, h = entry.height;
+		for (int y = -TEXTURE_ATLAS_PADDING; y < h + TEXTURE_ATLAS_PADDING; y++) {
+			int sy = std::min(std::max(y, 0), h - 1);
+			for (int x = -TEXTURE_ATLAS_PADDING; x < w + TEXTURE_ATLAS_PADDING; x++) {
+				int sx = std::min(std::max(x, 0), w - 1);
+				const unsigned char* src = entry.pixels + 4*(sy*w + sx);
+				unsigned char* dst = texels.data() + 4*((y0 + y)*width + x0 + x);
+				std::copy(src, src + 4, dst);
+			}
+		}
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GlState::bindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// past this many levels the padding is less than a texel and neighbours bleed in
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)std::log2(TEXTURE_ATLAS_PADDING));
+	CHECK_GL_ERRORS;
+	m_textures.push_back(texture);
+
+	for (uint32_t i : entries) {
+		Entry & entry = m_entries[i];
+		entry.texture = texture;
+		entry.rect = glm::vec4(entry.rect.x / width, entry.rect.y / height,
+			(float)entry.width / width, (float)entry.height / height);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+glm::vec4 TextureManager::bind(TextureHandle handle, GLuint unit) const
+{
+	GlState::activeTexture(GL_TEXTURE0 + unit);
+	if (handle == TEXTURE_NONE || handle > m_uploaded) {
+		GlState::bindTexture(GL_TEXTURE_2D, 0);
+		return glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+
+	const Entry & entry = m_entries[handle - 1];
+	GlState::bindTexture(GL_TEXTURE_2D, entry.texture);
+	return entry.rect;
+}
+
+//---------------------------------------------------------------------------------------
+void TextureManager::release()
+{
+	if (!m_textures.empty()) {
+		glDeleteTextures(m_textures.size(), m_textures.data());
+		GlState::invalidate();
+	}
+	m_textures.clear();
+	m_entries.clear();
+	m_handleOf.clear();
+	m_uploaded = 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "cs488-framework/OpenGLImport.hpp"
+
+#include "Texture.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Refers to a texture in a TextureManager, TEXTURE_NONE for no texture.
+typedef uint32_t TextureHandle;
+#define TEXTURE_NONE 0
+
+// Textures no bigger than this on either side are packed together into atlases,
+// with a border of copied edge texels so mip levels don't bleed into their neighbours.
+#define TEXTURE_ATLAS_MAX_SIZE 256
+#define TEXTURE_ATLAS_SIZE 2048
+#define TEXTURE_ATLAS_PADDING 4
+
+// Owns the GL textures for every Texture loaded by the scene.  Each set of pixels is
+// uploaded once, mipmapped, and drawn with trilinear filtering; after that, drawing a
+// textured node just binds it.
+class TextureManager {
+public:
+	TextureManager();
+
+	// Queues texture for upload.  Nodes sharing a gr.texture share its pixels, and get
+	// the same handle.
+	TextureHandle add(const Texture & texture);
+
+	// Creates the GL textures for everything added since the last upload().
+	void upload();
+
+	// Binds handle's GL texture to texture unit unit.  Returns where it sits in that
+	// texture: UVs are mapped by offset xy and scale zw, so they must stay within [0,1]
+	// for atlased textures.
+	glm::vec4 bind(TextureHandle handle, GLuint unit) const;
+
+	// Deletes every GL texture, invalidating all handles.
+	void release();
+
+private:
+	struct Entry {
+		const unsigned char* pixels;
+		unsigned int width;
+		unsigned int height;
+		GLuint texture;
+		glm::vec4 rect;
+	};
+
+	void uploadAtlas(const std::vector<uint32_t> & entries);
+
+	std::vector<Entry> m_entries; // handle h is m_entries[h - 1]
+	std::unordered_map<const unsigned char*, TextureHandle> m_handleOf;
+	std::vector<GLuint> m_textures;
+	size_t m_uploaded;            // entries before this are resident
+};
@@ -0,0 +1,212 @@
+// Benchmark for ObjFileDecoder against the stream-based decoder it replaced.
+//
+// Each file is decoded by both until BENCH_MIN_MS have passed, and the outputs are
+// compared bit for bit, so a change to the parser can be validated as well as timed:
+//
+//   ./Project-objbench [file.obj ...]      (from Assets, like Project)
+//
+// With no arguments it runs over the meshes Project loads.
+
+#include "cs488-framework/ObjFileDecoder.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+// minimum time spent timing each decoder on each file
+#define BENCH_MIN_MS 500
+
+//---------------------------------------------------------------------------------------
+// The original decoder: getline, a substr per prefix check, an istringstream per line
+// and sscanf for faces.  Kept as is as the reference.
+static void referenceDecode(
+		const char * objFilePath,
+		std::string & objectName,
+		std::vector<vec3> & positions,
+		std::vector<vec3> & normals,
+		std::vector<vec2> & uvCoords
+) {
+	positions.clear();
+	normals.clear();
+	uvCoords.clear();
+
+	ifstream in(objFilePath, std::ios::in);
+	if (!in) {
+		cerr << "Unable to open .obj file " << objFilePath << endl;
+		exit(1);
+	}
+
+	vector<vec3> temp_positions;
+	vector<vec3> temp_normals;
+	vector<vec2> temp_uvCoords;
+	string currentLine;
+	int positionIndexA, positionIndexB, positionIndexC;
+	int normalIndexA, normalIndexB, normalIndexC;
+	int uvCoordIndexA, uvCoordIndexB, uvCoordIndexC;
+
+	objectName = "";
+
+	while (!in.eof()) {
+		getline(in, currentLine);
+		if (currentLine.substr(0, 2) == "o ") {
+			istringstream s(currentLine.substr(2));
+			s >> objectName;
+
+		} else if (currentLine.substr(0, 2) == "v ") {
+			istringstream s(currentLine.substr(2));
+			glm::vec3 vertex;
+			s >> vertex.x;
+			s >> vertex.y;
+			s >> vertex.z;
+			temp_positions.push_back(vertex);
+
+		} else if (currentLine.substr(0, 3) == "vn ") {
+			istringstream s(currentLine.substr(2));
+			vec3 normal;
+			s >> normal.x;
+			s >> normal.y;
+			s >> normal.z;
+			temp_normals.push_back(normal);
+
+		} else if (currentLine.substr(0, 3) == "vt ") {
+			istringstream s(currentLine.substr(2));
+			vec2 textureCoord;
+			s >> textureCoord.s;
+			s >> textureCoord.t;
+			temp_uvCoords.push_back(textureCoord);
+
+		} else if (currentLine.substr(0, 2) == "f ") {
+			int index;
+			int numberOfIndexMatches = sscanf(currentLine.c_str(), "f %d/%d/%d",
+					&index, &index, &index);
+
+			if (numberOfIndexMatches == 3) {
+				sscanf(currentLine.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d",
+						&positionIndexA, &uvCoordIndexA, &normalIndexA,
+						&positionIndexB, &uvCoordIndexB, &normalIndexB,
+						&positionIndexC, &uvCoordIndexC, &normalIndexC);
+
+				uvCoords.push_back(temp_uvCoords[uvCoordIndexA - 1]);
+				uvCoords.push_back(temp_uvCoords[uvCoordIndexB - 1]);
+				uvCoords.push_back(temp_uvCoords[uvCoordIndexC - 1]);
+			} else {
+				sscanf(currentLine.c_str(), "f %d//%d %d//%d %d//%d",
+						&positionIndexA, &normalIndexA,
+						&positionIndexB, &normalIndexB,
+						&positionIndexC, &normalIndexC);
+			}
+
+			positions.push_back(temp_positions[positionIndexA - 1]);
+			positions.push_back(temp_positions[positionIndexB - 1]);
+			positions.push_back(temp_positions[positionIndexC - 1]);
+
+			normals.push_back(temp_normals[normalIndexA - 1]);
+			normals.push_back(temp_normals[normalIndexB - 1]);
+			normals.push_back(temp_normals[normalIndexC - 1]);
+		}
+	}
+
+	if (objectName.compare("") == 0) {
+		const char * ptr = strrchr(objFilePath, '/');
+		objectName.assign(ptr ? ptr+1 : objFilePath);
+		size_t pos = objectName.find('.');
+		if (pos != string::npos) objectName.resize(pos);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+struct Decoded {
+	string name;
+	vector<vec3> positions;
+	vector<vec3> normals;
+	vector<vec2> uvCoords;
+};
+
+//---------------------------------------------------------------------------------------
+template <typename T>
+static bool sameBits(const vector<T> & a, const vector<T> & b)
+{
+	return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()*sizeof(T)) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+// Runs body() until BENCH_MIN_MS have passed, returns ms per call.
+static double msPerCall(const std::function<void()> & body)
+{
+	typedef std::chrono::steady_clock clock;
+
+	size_t calls = 0;
+	auto start = clock::now();
+	std::chrono::nanoseconds elapsed(0);
+	do {
+		body();
+		calls++;
+		elapsed = clock::now() - start;
+	} while (elapsed < std::chrono::milliseconds(BENCH_MIN_MS));
+
+	return elapsed.count() * 1e-6 / calls;
+}
+
+//---------------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	vector<string> files;
+	for (int i = 1; i < argc; i++) {
+		files.push_back(argv[i]);
+	}
+	if (files.empty()) {
+		files = { "cube.obj", "sphere.obj", "suzanne.obj", "plane.obj", "player.obj" };
+	}
+
+	cout << left << setw(16) << "file" << right << setw(10) << "KB"
+		<< setw(14) << "old ms" << setw(14) << "new ms"
+		<< setw(12) << "new MB/s" << setw(10) << "speedup" << "  identical" << endl;
+
+	bool allIdentical = true;
+	for (const string & file : files) {
+		ifstream in(file, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!in) {
+			cerr << "Unable to open " << file << endl;
+			return 1;
+		}
+		double bytes = in.tellg();
+
+		Decoded reference, decoded;
+		double oldMs = msPerCall([&]() {
+			referenceDecode(file.c_str(), reference.name, reference.positions,
+					reference.normals, reference.uvCoords);
+		});
+		double newMs = msPerCall([&]() {
+			ObjFileDecoder::decode(file.c_str(), decoded.name, decoded.positions,
+					decoded.normals, decoded.uvCoords);
+		});
+
+		bool identical = reference.name == decoded.name &&
+				sameBits(reference.positions, decoded.positions) &&
+				sameBits(reference.normals, decoded.normals) &&
+				sameBits(reference.uvCoords, decoded.uvCoords);
+		allIdentical = allIdentical && identical;
+
+		cout << left << setw(16) << file << right << fixed
+			<< setw(10) << setprecision(1) << bytes / 1024
+			<< setw(14) << setprecision(4) << oldMs
+			<< setw(14) << setprecision(4) << newMs
+			<< setw(12) << setprecision(1) << bytes / (newMs * 1e3)
+			<< setw(9) << setprecision(1) << oldMs / newMs << "x"
+			<< "  " << (identical ? "yes" : "NO") << endl;
+	}
+
+	return allIdentical ? 0 : 1;
+}
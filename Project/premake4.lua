@@ -68,6 +68,19 @@ solution "CS488-Projects"
         includedirs (includeDirList)
         files { "*.cpp" }
 
+    -- ObjFileDecoder benchmark against the old decoder, see bench/ObjDecoderBench.cpp
+    project "Project-objbench"
+        kind "ConsoleApp"
+        language "C++"
+        location "build"
+        objdir "build/objbench"
+        targetdir "."
+        buildoptions (buildOptions)
+        libdirs (libDirectories)
+        links { "cs488-framework" }
+        includedirs (includeDirList)
+        files { "bench/*.cpp" }
+
     configuration "Debug"
         defines { "DEBUG" }
         flags { "Symbols" }
@@ -1,18 +1,29 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
 // Class for encapsulating index offset and number of indices to be rendered
 // for a batch of vertices.  It is assumed that there is a vertex buffer
 // setup so that all batch vertices are contiguous in memory and can be rendered
 // all at once given a start index offset into the vertex buffer, and a number
-// of indices to be rendered.
+// of indices to be rendered.  For indexed meshes the offset and count are into the
+// index buffer instead, for glDrawElements.
 struct BatchInfo {
 
 	// Starting index within an associated vertex buffer denoting the start
-	// of this batch's vertex data.
+	// of this batch's vertex data, or within the index buffer if indexed.
 	unsigned int startIndex;
 
 	// Number of indices to be rendered for this batch.
 	unsigned int numIndices;
 
+	// The batch's vertices, which its indices refer to if indexed.
+	unsigned int startVertex;
+	unsigned int numVertices;
+
+	// Object-space bounding box of the batch's vertex positions.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
 };
 
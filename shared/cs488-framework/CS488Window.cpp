@@ -1,6 +1,7 @@
 #include "CS488Window.hpp"
 #include "cs488-framework/Exception.hpp"
 #include "cs488-framework/OpenGLImport.hpp"
+#include "cs488-framework/GlState.hpp"
 
 #include <sstream>
 #include <iostream>
@@ -398,6 +399,7 @@ void CS488Window::run (
         while (!glfwWindowShouldClose(m_window)) {
             glfwPollEvents();
 			ImGui_ImplGlfwGL3_NewFrame();
+			GlState::beginFrame();
 
             if (!m_paused) {
 				// Apply application-specific logic
@@ -0,0 +1,253 @@
+#include "GlState.hpp"
+
+#include <cstring>
+
+
+// Texture units shadowed, binds on higher ones always go through.
+#define GL_STATE_TEXTURE_UNITS 16
+
+// Not a value GL ever takes, so the next call compares unequal.
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+namespace {
+
+struct State {
+	GLuint program;
+	GLuint vertexArray;
+	GLuint arrayBuffer;
+	GLuint elementArrayBuffer; // part of the vertex array's state
+	GLenum activeTexture;
+	GLuint textures[GL_STATE_TEXTURE_UNITS]; // GL_TEXTURE_2D by unit
+
+	GLuint blend;
+	GLuint depthTest;
+	GLuint stencilTest;
+	GLuint cullFace;
+
+	GLenum blendSrc;
+	GLenum blendDst;
+	GLenum blendEquation;
+	GLuint depthMask;
+	GLenum stencilFunc;
+	GLint stencilRef;
+	GLuint stencilFuncMask;
+	GLenum stencilFail;
+	GLenum stencilDepthFail;
+	GLenum stencilPass;
+	GLuint stencilMask;
+};
+
+State unknownState() {
+	State unknown;
+	memset(&unknown, 0xFF, sizeof(unknown));
+	return unknown;
+}
+
+State state = unknownState();
+GlState::Counters current = { 0, 0 };
+GlState::Counters previous = { 0, 0 };
+
+// True if value differs from cached, which then takes it.
+template <typename T>
+bool differs(T & cached, T value) {
+	if (cached == value) {
+		return false;
+	}
+	cached = value;
+	return true;
+}
+
+// Counts a call as issued or skipped, and passes on whether it's issued.
+bool issue(bool changed) {
+	if (changed) {
+		++current.issued;
+	} else {
+		++current.skipped;
+	}
+	return changed;
+}
+
+GLuint * capabilityOf(GLenum capability) {
+	switch (capability) {
+		case GL_BLEND: return &state.blend;
+		case GL_DEPTH_TEST: return &state.depthTest;
+		case GL_STENCIL_TEST: return &state.stencilTest;
+		case GL_CULL_FACE: return &state.cullFace;
+		default: return nullptr;
+	}
+}
+
+}
+
+//------------------------------------------------------------------------------------
+void GlState::useProgram (
+		GLuint program
+) {
+	if (issue(differs(state.program, program))) {
+		glUseProgram(program);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::bindVertexArray (
+		GLuint vertexArray
+) {
+	if (issue(differs(state.vertexArray, vertexArray))) {
+		glBindVertexArray(vertexArray);
+		state.elementArrayBuffer = GL_STATE_UNKNOWN;
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::bindBuffer (
+		GLenum target,
+		GLuint buffer
+) {
+	GLuint * cached = nullptr;
+	if (target == GL_ARRAY_BUFFER) {
+		cached = &state.arrayBuffer;
+	} else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+		cached = &state.elementArrayBuffer;
+	}
+
+	if (issue(cached == nullptr || differs(*cached, buffer))) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::activeTexture (
+		GLenum unit
+) {
+	if (issue(differs(state.activeTexture, unit))) {
+		glActiveTexture(unit);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::bindTexture (
+		GLenum target,
+		GLuint texture
+) {
+	// also covers an unknown active unit
+	GLuint unit = state.activeTexture - GL_TEXTURE0;
+	bool shadowed = target == GL_TEXTURE_2D && unit < GL_STATE_TEXTURE_UNITS;
+
+	if (issue(!shadowed || differs(state.textures[unit], texture))) {
+		glBindTexture(target, texture);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::enable (
+		GLenum capability
+) {
+	GLuint * cached = capabilityOf(capability);
+	if (issue(cached == nullptr || differs(*cached, (GLuint)GL_TRUE))) {
+		glEnable(capability);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::disable (
+		GLenum capability
+) {
+	GLuint * cached = capabilityOf(capability);
+	if (issue(cached == nullptr || differs(*cached, (GLuint)GL_FALSE))) {
+		glDisable(capability);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::blendFunc (
+		GLenum sfactor,
+		GLenum dfactor
+) {
+	bool changed = differs(state.blendSrc, sfactor);
+	changed = differs(state.blendDst, dfactor) || changed;
+	if (issue(changed)) {
+		glBlendFunc(sfactor, dfactor);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::blendEquation (
+		GLenum mode
+) {
+	if (issue(differs(state.blendEquation, mode))) {
+		glBlendEquation(mode);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::depthMask (
+		GLboolean flag
+) {
+	if (issue(differs(state.depthMask, (GLuint)flag))) {
+		glDepthMask(flag);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::stencilFunc (
+		GLenum func,
+		GLint ref,
+		GLuint mask
+) {
+	bool changed = differs(state.stencilFunc, func);
+	changed = differs(state.stencilRef, ref) || changed;
+	changed = differs(state.stencilFuncMask, mask) || changed;
+	if (issue(changed)) {
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::stencilOp (
+		GLenum sfail,
+		GLenum dpfail,
+		GLenum dppass
+) {
+	bool changed = differs(state.stencilFail, sfail);
+	changed = differs(state.stencilDepthFail, dpfail) || changed;
+	changed = differs(state.stencilPass, dppass) || changed;
+	if (issue(changed)) {
+		glStencilOp(sfail, dpfail, dppass);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::stencilMask (
+		GLuint mask
+) {
+	if (issue(differs(state.stencilMask, mask))) {
+		glStencilMask(mask);
+	}
+}
+
+//------------------------------------------------------------------------------------
+void GlState::invalidate()
+{
+	state = unknownState();
+}
+
+//------------------------------------------------------------------------------------
+void GlState::beginFrame()
+{
+	previous = current;
+	current.issued = 0;
+	current.skipped = 0;
+	state = unknownState();
+}
+
+//------------------------------------------------------------------------------------
+const GlState::Counters & GlState::counters()
+{
+	return current;
+}
+
+//------------------------------------------------------------------------------------
+const GlState::Counters & GlState::lastFrame()
+{
+	return previous;
+}
@@ -0,0 +1,60 @@
+/*
+ * GlState
+ */
+
+#pragma once
+
+#include "OpenGLImport.hpp"
+
+
+/*
+* Shadows the GL state that draws change most often -- program, vertex array, array
+* buffers, texture units, blend, depth and stencil -- and skips calls that would leave
+* it as it is.  Anything that changes the same state behind its back has to call
+* invalidate() afterwards.
+*/
+class GlState {
+public:
+	struct Counters {
+		unsigned int issued;
+		unsigned int skipped;
+	};
+
+	static void useProgram(GLuint program);
+
+	static void bindVertexArray(GLuint vertexArray);
+
+	static void bindBuffer(GLenum target, GLuint buffer);
+
+	static void activeTexture(GLenum unit);
+
+	static void bindTexture(GLenum target, GLuint texture);
+
+	static void enable(GLenum capability);
+
+	static void disable(GLenum capability);
+
+	static void blendFunc(GLenum sfactor, GLenum dfactor);
+
+	static void blendEquation(GLenum mode);
+
+	static void depthMask(GLboolean flag);
+
+	static void stencilFunc(GLenum func, GLint ref, GLuint mask);
+
+	static void stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass);
+
+	static void stencilMask(GLuint mask);
+
+	// Forgets everything, so the next call of each kind goes through.
+	static void invalidate();
+
+	// Called by CS488Window at the start of every frame.
+	static void beginFrame();
+
+	// Calls so far this frame, and over the whole of the last one.
+	static const Counters & counters();
+
+	static const Counters & lastFrame();
+};
+
@@ -2,13 +2,18 @@
 using namespace glm;
 using namespace std;
 
+#include <glm/gtc/packing.hpp>
+
 #include "cs488-framework/Exception.hpp"
 #include "cs488-framework/ObjFileDecoder.hpp"
+#include "cs488-framework/MeshOptimizer.hpp"
 
 
 //----------------------------------------------------------------------------------------
 // Default constructor
 MeshConsolidator::MeshConsolidator()
+	: m_indexed(false),
+	  m_interleaved(false)
 {
 
 }
@@ -36,27 +41,76 @@ static void appendVector (
 //----------------------------------------------------------------------------------------
 MeshConsolidator::MeshConsolidator(
 		std::initializer_list<ObjFilePath> objFileList
-) {
+)
+	: MeshConsolidator(objFileList, MESH_UNINDEXED)
+{
+
+}
+
+//----------------------------------------------------------------------------------------
+MeshConsolidator::MeshConsolidator(
+		std::initializer_list<ObjFilePath> objFileList,
+		unsigned int layout
+)
+	: m_indexed(layout & MESH_INDEXED),
+	  m_interleaved(layout & MESH_INTERLEAVED)
+{
 
 	MeshId meshId;
 	vector<vec3> positions;
 	vector<vec3> normals;
 	vector<vec2> uvCoords;
+	vector<unsigned int> indices;
 	BatchInfo batchInfo;
 	unsigned long indexOffset(0);
 
     for(const ObjFilePath & objFile : objFileList) {
-	    ObjFileDecoder::decode(objFile.c_str(), meshId, positions, normals, uvCoords);
+	    if (m_indexed) {
+		    ObjFileDecoder::decode(objFile.c_str(), meshId, positions, normals, uvCoords, indices);
+
+		    if (layout & MESH_OPTIMIZE_VERTEX_CACHE) {
+			    MeshOptimizer::optimizeVertexCache(indices, positions.size());
+
+			    if (layout & MESH_OPTIMIZE_OVERDRAW) {
+				    MeshOptimizer::optimizeOverdraw(indices, positions);
+			    }
+		    }
+	    } else {
+		    ObjFileDecoder::decode(objFile.c_str(), meshId, positions, normals, uvCoords);
+	    }
 
-	    uint numIndices = positions.size();
+	    uint numVertices = positions.size();
 
-	    if (numIndices != normals.size()) {
+	    if (numVertices != normals.size()) {
 		    throw Exception("Error within MeshConsolidator: "
 					"positions.size() != normals.size()\n");
 	    }
 
-	    batchInfo.startIndex = indexOffset;
-	    batchInfo.numIndices = numIndices;
+	    batchInfo.startVertex = m_vertexPositionData.size();
+	    batchInfo.numVertices = numVertices;
+
+	    if (m_indexed) {
+		    batchInfo.startIndex = indexOffset;
+		    batchInfo.numIndices = indices.size();
+
+		    m_indexData.reserve(m_indexData.size() + indices.size());
+		    for (unsigned int index : indices) {
+			    m_indexData.push_back(batchInfo.startVertex + index);
+		    }
+	    } else {
+		    batchInfo.startIndex = batchInfo.startVertex;
+		    batchInfo.numIndices = numVertices;
+	    }
+
+	    batchInfo.boundsMin = vec3(0.0f);
+	    batchInfo.boundsMax = vec3(0.0f);
+	    if (!positions.empty()) {
+		    batchInfo.boundsMin = batchInfo.boundsMax = positions[0];
+		    for (const vec3 & position : positions) {
+			    batchInfo.boundsMin = glm::min(batchInfo.boundsMin, position);
+			    batchInfo.boundsMax = glm::max(batchInfo.boundsMax, position);
+		    }
+	    }
 
 	    m_batchInfoMap[meshId] = batchInfo;
 
@@ -64,9 +118,37 @@ MeshConsolidator::MeshConsolidator(
 	    appendVector(m_vertexNormalData, normals);
 	    appendVector(m_vertexUVData, uvCoords);
 
-	    indexOffset += numIndices;
+	    indexOffset += batchInfo.numIndices;
     }
 
+	if (m_interleaved) {
+		packVertices();
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// Fills m_packedVertexData from the separate position, normal and uv arrays.
+void MeshConsolidator::packVertices() {
+	m_packedVertexData.resize(m_vertexPositionData.size());
+
+	for (size_t i = 0; i < m_packedVertexData.size(); ++i) {
+		PackedVertex & vertex = m_packedVertexData[i];
+		const vec3 & position = m_vertexPositionData[i];
+		vertex.position[0] = position.x;
+		vertex.position[1] = position.y;
+		vertex.position[2] = position.z;
+
+		vec3 normal = m_vertexNormalData[i];
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			normal /= length;
+		}
+		vertex.normal = (int32_t)packSnorm3x10_1x2(vec4(normal, 0.0f));
+
+		// meshes without texture coordinates can leave the uv array short
+		vec2 uv = i < m_vertexUVData.size() ? m_vertexUVData[i] : vec2(0.0f);
+		vertex.uv = packHalf2x16(uv);
+	}
 }
 
 //----------------------------------------------------------------------------------------
@@ -110,4 +192,38 @@ size_t MeshConsolidator::getNumVertexNormalBytes() const {
 // Returns the total number of bytes of all vtexture uv data.
 size_t MeshConsolidator::getNumVertexUVBytes() const {
 	return m_vertexUVData.size() * sizeof(vec2);
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------------------
+bool MeshConsolidator::isInterleaved() const {
+	return m_interleaved;
+}
+
+//----------------------------------------------------------------------------------------
+// Returns the starting memory location for interleaved vertex data.
+const PackedVertex * MeshConsolidator::getPackedVertexDataPtr() const {
+	return m_packedVertexData.data();
+}
+
+//----------------------------------------------------------------------------------------
+// Returns the total number of bytes of all interleaved vertex data.
+size_t MeshConsolidator::getNumPackedVertexBytes() const {
+	return m_packedVertexData.size() * sizeof(PackedVertex);
+}
+
+//----------------------------------------------------------------------------------------
+bool MeshConsolidator::isIndexed() const {
+	return m_indexed;
+}
+
+//----------------------------------------------------------------------------------------
+// Returns the starting memory location for index data.
+const unsigned int * MeshConsolidator::getIndexDataPtr() const {
+	return m_indexData.data();
+}
+
+//----------------------------------------------------------------------------------------
+// Returns the total number of bytes of all index data.
+size_t MeshConsolidator::getNumIndexBytes() const {
+	return m_indexData.size() * sizeof(unsigned int);
+}
@@ -4,6 +4,7 @@
 
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <initializer_list>
 #include <vector>
 #include <unordered_map>
@@ -24,6 +25,41 @@ typedef std::string ObjFilePath;
 typedef std::unordered_map<MeshId, BatchInfo>  BatchInfoMap;
 
 
+// How MeshConsolidator lays out the vertex data, or'ed together.
+enum MeshLayout {
+	// One vertex per face corner, drawn with glDrawArrays.
+	MESH_UNINDEXED = 0,
+
+	// Corners sharing a position, normal and uv share a vertex, drawn with
+	// glDrawElements from the index data.
+	MESH_INDEXED = 1,
+
+	// With MESH_INDEXED, reorder triangles for the post-transform vertex cache...
+	MESH_OPTIMIZE_VERTEX_CACHE = 2,
+
+	// ...and then front to back, from the outside in, against overdraw.
+	MESH_OPTIMIZE_OVERDRAW = 4,
+
+	// Also pack the vertices into one interleaved PackedVertex array.
+	MESH_INTERLEAVED = 8
+};
+
+
+// One vertex of the MESH_INTERLEAVED layout, 20 bytes instead of 32.
+struct PackedVertex {
+	// GL_FLOAT x3.
+	float position[3];
+
+	// GL_INT_2_10_10_10_REV, normalized, x in the low bits.
+	int32_t normal;
+
+	// GL_HALF_FLOAT x2, u in the low half.
+	uint32_t uv;
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must be tightly packed");
+
+
 /*
 * Class for consolidating all vertex data within a list of .obj files.
 */
@@ -33,6 +69,8 @@ public:
 
 	MeshConsolidator(std::initializer_list<ObjFilePath>  objFileList);
 
+	MeshConsolidator(std::initializer_list<ObjFilePath>  objFileList, unsigned int layout);
+
 	~MeshConsolidator();
 
 	const float * getVertexPositionDataPtr() const;
@@ -47,13 +85,32 @@ public:
 
 	size_t getNumVertexUVBytes() const;
 
+	bool isInterleaved() const;
+
+	const PackedVertex * getPackedVertexDataPtr() const;
+
+	size_t getNumPackedVertexBytes() const;
+
+	bool isIndexed() const;
+
+	// Indices are GL_UNSIGNED_INT, and already offset to the mesh's vertices.
+	const unsigned int * getIndexDataPtr() const;
+
+	size_t getNumIndexBytes() const;
+
 	void getBatchInfoMap(BatchInfoMap & batchInfoMap) const;
 
 
 private:
+	void packVertices();
+
 	std::vector<glm::vec3> m_vertexPositionData;
 	std::vector<glm::vec3> m_vertexNormalData;
 	std::vector<glm::vec2> m_vertexUVData;
+	std::vector<unsigned int> m_indexData;
+	std::vector<PackedVertex> m_packedVertexData;
+	bool m_indexed;
+	bool m_interleaved;
 
 	BatchInfoMap m_batchInfoMap;
 };
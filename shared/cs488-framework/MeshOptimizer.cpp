@@ -0,0 +1,261 @@
+#include "MeshOptimizer.hpp"
+using namespace glm;
+using namespace std;
+
+#include <algorithm>
+#include <cmath>
+
+
+// The simulated cache, and the scoring constants from Forsyth's article.
+#define VERTEX_CACHE_SIZE 32
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+// Hardware-like FIFO cache that optimizeOverdraw looks for cold starts with.
+#define OVERDRAW_CACHE_SIZE 16
+
+//----------------------------------------------------------------------------------------
+static float vertexScore (
+		int cachePosition,
+		unsigned int remainingTriangles
+) {
+	if (remainingTriangles == 0) {
+		// nothing left to draw with it
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// the last triangle's vertices score the same, so it's not pushed out
+			// by its own neighbour
+			score = LAST_TRIANGLE_SCORE;
+		} else {
+			float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+			score = pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+
+	// vertices with few triangles left go first, so they don't end up stranded
+	score += VALENCE_BOOST_SCALE * pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+//----------------------------------------------------------------------------------------
+void MeshOptimizer::optimizeVertexCache (
+		vector<unsigned int> & indices,
+		size_t numVertices
+) {
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+
+	// triangles using each vertex, packed: vertex v's are
+	// triangleList[firstTriangle[v], firstTriangle[v] + remaining[v])
+	vector<unsigned int> remaining(numVertices, 0);
+	for (unsigned int index : indices) {
+		remaining[index]++;
+	}
+	vector<unsigned int> firstTriangle(numVertices + 1, 0);
+	for (size_t v = 0; v < numVertices; ++v) {
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	}
+	vector<unsigned int> triangleList(indices.size());
+	{
+		vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t t = 0; t < numTriangles; ++t) {
+			for (int k = 0; k < 3; ++k) {
+				triangleList[fill[indices[3*t + k]]++] = t;
+			}
+		}
+	}
+
+	vector<int> cachePosition(numVertices, -1);
+	vector<float> score(numVertices);
+	for (size_t v = 0; v < numVertices; ++v) {
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+
+	vector<float> triangleScore(numTriangles);
+	vector<bool> emitted(numTriangles, false);
+	for (size_t t = 0; t < numTriangles; ++t) {
+		triangleScore[t] = score[indices[3*t]] + score[indices[3*t + 1]] + score[indices[3*t + 2]];
+	}
+
+	vector<unsigned int> result;
+	result.reserve(indices.size());
+
+	// three more than the cache, for the vertices being pushed in
+	unsigned int cache[VERTEX_CACHE_SIZE + 3];
+	unsigned int cacheSize = 0;
+
+	size_t best = max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+	size_t scan = 0; // triangles before this are all emitted
+	while (true) {
+		emitted[best] = true;
+
+		unsigned int newCache[VERTEX_CACHE_SIZE + 3];
+		unsigned int newCacheSize = 0;
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = indices[3*best + k];
+			result.push_back(v);
+			newCache[newCacheSize++] = v;
+
+			// take the triangle off the vertex's list
+			unsigned int * list = &triangleList[firstTriangle[v]];
+			unsigned int * end = list + remaining[v];
+			*find(list, end, (unsigned int)best) = *(end - 1);
+			remaining[v]--;
+		}
+
+		// the triangle's vertices go to the front, everything else moves back
+		for (unsigned int i = 0; i < cacheSize; ++i) {
+			unsigned int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+				newCache[newCacheSize++] = v;
+			}
+		}
+
+		for (unsigned int i = 0; i < newCacheSize; ++i) {
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// rescore the triangles touching the cache, and pick the best of them
+		float bestScore = -1.0f;
+		size_t next = numTriangles;
+		for (unsigned int i = 0; i < newCacheSize; ++i) {
+			unsigned int v = newCache[i];
+			for (unsigned int j = 0; j < remaining[v]; ++j) {
+				unsigned int t = triangleList[firstTriangle[v] + j];
+				triangleScore[t] = score[indices[3*t]] + score[indices[3*t + 1]] + score[indices[3*t + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					next = t;
+				}
+			}
+		}
+
+		cacheSize = std::min(newCacheSize, (unsigned int)VERTEX_CACHE_SIZE);
+		copy(newCache, newCache + cacheSize, cache);
+
+		if (next == numTriangles) {
+			// nothing in the cache has triangles left, carry on from the first unemitted
+			while (scan < numTriangles && emitted[scan]) {
+				++scan;
+			}
+			if (scan == numTriangles) {
+				break;
+			}
+			next = scan;
+		}
+		best = next;
+	}
+
+	indices.swap(result);
+}
+
+//----------------------------------------------------------------------------------------
+void MeshOptimizer::optimizeOverdraw (
+		vector<unsigned int> & indices,
+		const vector<vec3> & positions
+) {
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+
+	// a cluster starts wherever a triangle misses the cache on all three vertices
+	vector<size_t> clusterStart;
+	vector<int> cachedAt(positions.size(), -1);
+	int time = 0;
+	for (size_t t = 0; t < numTriangles; ++t) {
+		int misses = 0;
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = indices[3*t + k];
+			if (cachedAt[v] < 0 || time - cachedAt[v] >= OVERDRAW_CACHE_SIZE) {
+				cachedAt[v] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || t == 0) {
+			clusterStart.push_back(t);
+		}
+	}
+	clusterStart.push_back(numTriangles);
+
+	vec3 meshCentre(0.0f);
+	float meshArea = 0.0f;
+	size_t numClusters = clusterStart.size() - 1;
+	vector<vec3> clusterCentre(numClusters, vec3(0.0f));
+	vector<vec3> clusterNormal(numClusters, vec3(0.0f));
+	vector<float> clusterArea(numClusters, 0.0f);
+	for (size_t c = 0; c < numClusters; ++c) {
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+			const vec3 & a = positions[indices[3*t]];
+			const vec3 & b = positions[indices[3*t + 1]];
+			const vec3 & d = positions[indices[3*t + 2]];
+			vec3 normal = cross(b - a, d - a); // twice the area, outwards
+			float area = length(normal);
+			vec3 centre = (a + b + d) / 3.0f;
+
+			clusterCentre[c] += centre * area;
+			clusterNormal[c] += normal;
+			clusterArea[c] += area;
+		}
+		meshCentre += clusterCentre[c];
+		meshArea += clusterArea[c];
+	}
+	if (meshArea > 0.0f) {
+		meshCentre /= meshArea;
+	}
+
+	// how far out the cluster faces, outermost first
+	vector<float> sortKey(numClusters);
+	for (size_t c = 0; c < numClusters; ++c) {
+		vec3 centre = clusterArea[c] > 0.0f ? clusterCentre[c] / clusterArea[c] : clusterCentre[c];
+		float normalLength = length(clusterNormal[c]);
+		vec3 normal = normalLength > 0.0f ? clusterNormal[c] / normalLength : vec3(0.0f);
+		sortKey[c] = dot(centre - meshCentre, normal);
+	}
+
+	vector<size_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; ++c) {
+		order[c] = c;
+	}
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return sortKey[a] > sortKey[b];
+	});
+
+	vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t c : order) {
+		result.insert(result.end(), indices.begin() + 3*clusterStart[c], indices.begin() + 3*clusterStart[c + 1]);
+	}
+	indices.swap(result);
+}
+
+//----------------------------------------------------------------------------------------
+float MeshOptimizer::averageCacheMissRatio (
+		const vector<unsigned int> & indices,
+		size_t numVertices,
+		unsigned int cacheSize
+) {
+	if (indices.empty()) {
+		return 0.0f;
+	}
+
+	vector<int> cachedAt(numVertices, -1);
+	int time = 0;
+	for (unsigned int v : indices) {
+		if (cachedAt[v] < 0 || time - cachedAt[v] >= (int)cacheSize) {
+			cachedAt[v] = time++;
+		}
+	}
+
+	return (float)time / (indices.size() / 3);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+/*
+* Reorders the triangles of an indexed triangle list, leaving the vertices as they are.
+*/
+class MeshOptimizer {
+public:
+	// Tom Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle
+	// whose vertices score best against a simulated LRU cache, so the post-transform
+	// cache of any size catches as many repeats as it can.
+	static void optimizeVertexCache(
+			std::vector<unsigned int> & indices,
+			size_t numVertices
+	);
+
+	// Splits an optimizeVertexCache() order into clusters wherever the cache starts cold
+	// anyway, then sorts the clusters so that those facing out from the mesh's centre
+	// come first and hide what is behind them.  The cache efficiency is unchanged.
+	static void optimizeOverdraw(
+			std::vector<unsigned int> & indices,
+			const std::vector<glm::vec3> & positions
+	);
+
+	// Transformed vertices per triangle with a FIFO post-transform cache, 0.5 at best
+	// and 3 at worst.
+	static float averageCacheMissRatio(
+			const std::vector<unsigned int> & indices,
+			size_t numVertices,
+			unsigned int cacheSize
+	);
+};
+
@@ -1,33 +1,76 @@
 #include "ObjFileDecoder.hpp"
 using namespace glm;
 
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <sstream>
+#include <unordered_map>
 using namespace std;
 
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "cs488-framework/Exception.hpp"
 
 
 //---------------------------------------------------------------------------------------
-void ObjFileDecoder::decode(
-		const char * objFilePath,
-		std::string & objectName,
-        std::vector<vec3> & positions,
-        std::vector<vec3> & normals,
-        std::vector<vec2> & uvCoords
-) {
+// The whole file as one read-only range, memory-mapped where there's mmap.
+class ObjFile {
+public:
+    ObjFile(const char * objFilePath)
+        : m_begin(nullptr),
+          m_size(0)
+    {
+#if defined(_WIN32)
+        ifstream in(objFilePath, std::ios::in | std::ios::binary);
+        if (!in) {
+            throwUnableToOpen(objFilePath);
+        }
+        m_copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        m_begin = m_copy.data();
+        m_size = m_copy.size();
+#else
+        int fd = open(objFilePath, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) close(fd);
+            throwUnableToOpen(objFilePath);
+        }
+        m_size = info.st_size;
+        if (m_size > 0) {
+            void * mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throwUnableToOpen(objFilePath);
+            }
+            m_begin = (const char *)mapped;
+        }
+        close(fd);
+#endif
+    }
 
-	// Empty containers, and start fresh before inserting data from .obj file
-	positions.clear();
-	normals.clear();
-	uvCoords.clear();
+    ~ObjFile() {
+#if !defined(_WIN32)
+        if (m_begin) munmap((void *)m_begin, m_size);
+#endif
+    }
 
-    ifstream in(objFilePath, std::ios::in);
-    in.exceptions(std::ifstream::badbit);
+    const char * begin() const { return m_begin; }
+    const char * end() const { return m_begin + m_size; }
 
-    if (!in) {
+private:
+    ObjFile(const ObjFile &);
+    ObjFile & operator = (const ObjFile &);
+
+    static void throwUnableToOpen(const char * objFilePath) {
         stringstream errorMessage;
         errorMessage << "Unable to open .obj file " << objFilePath
             << " within method ObjFileDecoder::decode" << endl;
@@ -35,123 +78,336 @@ void ObjFileDecoder::decode(
         throw Exception(errorMessage.str().c_str());
     }
 
-    string currentLine;
-    int positionIndexA, positionIndexB, positionIndexC;
-    int normalIndexA, normalIndexB, normalIndexC;
-    int uvCoordIndexA, uvCoordIndexB, uvCoordIndexC;
-    vector<vec3> temp_positions;
-    vector<vec3> temp_normals;
-    vector<vec2> temp_uvCoords;
+    const char * m_begin;
+    size_t m_size;
+#if defined(_WIN32)
+    std::string m_copy;
+#endif
+};
+
+//---------------------------------------------------------------------------------------
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+//---------------------------------------------------------------------------------------
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+//---------------------------------------------------------------------------------------
+static inline void skipBlanks(const char *& p, const char * end) {
+    while (p < end && isBlank(*p)) ++p;
+}
+
+//---------------------------------------------------------------------------------------
+// Leaves p at the start of the next line.
+static inline void skipLine(const char *& p, const char * end) {
+    const char * newline = (const char *)memchr(p, '\n', end - p);
+    p = newline ? newline + 1 : end;
+}
+
+//---------------------------------------------------------------------------------------
+// Parses a decimal float starting at p, rounded the same as strtof.  Numbers of up to
+// 7 significant digits and 10 decimal places, which is what exporters write, take one
+// exact float division; anything else is handed to strtof.
+static float parseFloat(const char *& p, const char * end) {
+    static const float powersOf10[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+
+    skipBlanks(p, end);
+    const char * start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+    for (; p < end && isDigit(*p); ++p) {
+        anyDigits = true;
+        if (significantDigits < 19) {
+            mantissa = mantissa*10 + (*p - '0');
+            if (mantissa) ++significantDigits;
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p) {
+            anyDigits = true;
+            if (significantDigits < 19) {
+                mantissa = mantissa*10 + (*p - '0');
+                if (mantissa) ++significantDigits;
+                --exponent;
+            }
+        }
+    }
+    if (anyDigits && p < end && (*p == 'e' || *p == 'E')) {
+        const char * e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = *e == '-';
+            ++e;
+        }
+        if (e < end && isDigit(*e)) {
+            int value = 0;
+            for (; e < end && isDigit(*e); ++e) {
+                if (value < 10000) value = value*10 + (*e - '0');
+            }
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+
+    if (anyDigits && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10) {
+        float value = exponent < 0 ? (float)mantissa / powersOf10[-exponent]
+                : (float)mantissa * powersOf10[exponent];
+        return negative ? -value : value;
+    }
+
+    // slow path, on a terminated copy of the token
+    p = start;
+    while (p < end && !isBlank(*p) && *p != '\n') ++p;
+    char token[64];
+    size_t length = std::min<size_t>(p - start, sizeof(token) - 1);
+    memcpy(token, start, length);
+    token[length] = '\0';
+    return strtof(token, nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+// Parses an optionally signed integer at p, returns false if there isn't one.
+static inline bool parseInt(const char *& p, const char * end, int & value) {
+    bool negative = false;
+    const char * q = p;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = *q == '-';
+        ++q;
+    }
+    if (q >= end || !isDigit(*q)) return false;
+
+    int magnitude = 0;
+    for (; q < end && isDigit(*q); ++q) {
+        magnitude = magnitude*10 + (*q - '0');
+    }
+    value = negative ? -magnitude : magnitude;
+    p = q;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// .obj indices start at 1, or count back from the last element read if negative.
+// Returns a 0-based index, or -1 for a missing or 0 index.
+static inline int resolveIndex(int index, size_t count) {
+    if (index > 0) return index - 1;
+    if (index < 0) return (int)count + index;
+    return -1;
+}
+
+//---------------------------------------------------------------------------------------
+// Reads the .obj file's vertex data as given, with one (position, uv, normal) index
+// triple per face corner, 0-based and with uv or normal -1 if the face has none.
+// Faces with more than three corners are split into a fan of triangles.
+static void readObjFile(
+		const char * objFilePath,
+		std::string & objectName,
+        std::vector<vec3> & temp_positions,
+        std::vector<vec3> & temp_normals,
+        std::vector<vec2> & temp_uvCoords,
+        std::vector<ivec3> & corners
+) {
+    ObjFile file(objFilePath);
+    const char * end = file.end();
 
 	objectName = "";
 
-    while (!in.eof()) {
-        try {
-            getline(in, currentLine);
-        } catch (const ifstream::failure &e) {
-            in.close();
-            stringstream errorMessage;
-            errorMessage << "Error calling getline() -- " << e.what() << endl;
-            throw Exception(errorMessage.str());
+    // Count the lines of each kind first, so each vector is allocated once.
+    size_t numPositions = 0, numNormals = 0, numUVs = 0, numFaces = 0;
+    for (const char * p = file.begin(); p < end; skipLine(p, end)) {
+        if (end - p < 2) break;
+        if (p[0] == 'v') {
+            if (isBlank(p[1])) ++numPositions;
+            else if (p[1] == 'n') ++numNormals;
+            else if (p[1] == 't') ++numUVs;
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            ++numFaces;
         }
-	    if (currentLine.substr(0, 2) == "o ") {
-		    // Get entire line excluding first 2 chars.
-		    istringstream s(currentLine.substr(2));
-		    s >> objectName;
+    }
+    temp_positions.reserve(numPositions);
+    temp_normals.reserve(numNormals);
+    temp_uvCoords.reserve(numUVs);
+    corners.reserve(3*numFaces);
 
+    for (const char * p = file.begin(); p < end; skipLine(p, end)) {
+        if (end - p < 2) break;
 
-	    } else if (currentLine.substr(0, 2) == "v ") {
+        if (p[0] == 'v' && isBlank(p[1])) {
             // Vertex data on this line.
-            // Get entire line excluding first 2 chars.
-            istringstream s(currentLine.substr(2));
-            glm::vec3 vertex;
-            s >> vertex.x;
-            s >> vertex.y;
-            s >> vertex.z;
+            p += 2;
+            vec3 vertex;
+            vertex.x = parseFloat(p, end);
+            vertex.y = parseFloat(p, end);
+            vertex.z = parseFloat(p, end);
             temp_positions.push_back(vertex);
 
-        } else if (currentLine.substr(0, 3) == "vn ") {
+        } else if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && isBlank(p[2])) {
             // Normal data on this line.
-            // Get entire line excluding first 2 chars.
-            istringstream s(currentLine.substr(2));
+            p += 3;
             vec3 normal;
-            s >> normal.x;
-            s >> normal.y;
-            s >> normal.z;
+            normal.x = parseFloat(p, end);
+            normal.y = parseFloat(p, end);
+            normal.z = parseFloat(p, end);
             temp_normals.push_back(normal);
 
-        } else if (currentLine.substr(0, 3) == "vt ") {
+        } else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && isBlank(p[2])) {
             // Texture coordinate data on this line.
-            // Get entire line excluding first 2 chars.
-            istringstream s(currentLine.substr(2));
+            p += 3;
             vec2 textureCoord;
-            s >> textureCoord.s;
-            s >> textureCoord.t;
+            textureCoord.s = parseFloat(p, end);
+            textureCoord.t = parseFloat(p, end);
             temp_uvCoords.push_back(textureCoord);
 
-        } else if (currentLine.substr(0, 2) == "f ") {
-            // Face index data on this line.
-
-            int index;
-
-            // sscanf will return the number of matched index values it found
-            // from the pattern.
-            int numberOfIndexMatches = sscanf(currentLine.c_str(), "f %d/%d/%d",
-                                              &index, &index, &index);
-
-            if (numberOfIndexMatches == 3) {
-                // Line contains indices of the pattern vertex/uv-cord/normal.
-                sscanf(currentLine.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                       &positionIndexA, &uvCoordIndexA, &normalIndexA,
-                       &positionIndexB, &uvCoordIndexB, &normalIndexB,
-                       &positionIndexC, &uvCoordIndexC, &normalIndexC);
-
-                // .obj file uses indices that start at 1, so subtract 1 so they start at 0.
-                uvCoordIndexA--;
-                uvCoordIndexB--;
-                uvCoordIndexC--;
-
-                uvCoords.push_back(temp_uvCoords[uvCoordIndexA]);
-                uvCoords.push_back(temp_uvCoords[uvCoordIndexB]);
-                uvCoords.push_back(temp_uvCoords[uvCoordIndexC]);
-
-            } else {
-                // Line contains indices of the pattern vertex//normal.
-                sscanf(currentLine.c_str(), "f %d//%d %d//%d %d//%d",
-		               &positionIndexA, &normalIndexA,
-                       &positionIndexB, &normalIndexB,
-                       &positionIndexC, &normalIndexC);
-            }
-
-            positionIndexA--;
-            positionIndexB--;
-            positionIndexC--;
-            normalIndexA--;
-            normalIndexB--;
-            normalIndexC--;
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            // Face index data on this line, each corner one of v, v/vt, v//vn or
+            // v/vt/vn.
+            p += 2;
+            ivec3 first, previous, corner;
+            int numCorners = 0;
+            for (;;) {
+                skipBlanks(p, end);
+                int position, uvCoord = 0, normal = 0;
+                if (!parseInt(p, end, position)) break;
+                if (p < end && *p == '/') {
+                    ++p;
+                    parseInt(p, end, uvCoord);
+                    if (p < end && *p == '/') {
+                        ++p;
+                        parseInt(p, end, normal);
+                    }
+                }
+                corner = ivec3(resolveIndex(position, temp_positions.size()),
+                        resolveIndex(uvCoord, temp_uvCoords.size()),
+                        resolveIndex(normal, temp_normals.size()));
 
-            positions.push_back(temp_positions[positionIndexA]);
-            positions.push_back(temp_positions[positionIndexB]);
-            positions.push_back(temp_positions[positionIndexC]);
+                if (numCorners == 0) {
+                    first = corner;
+                } else if (numCorners >= 2) {
+                    corners.push_back(first);
+                    corners.push_back(previous);
+                    corners.push_back(corner);
+                }
+                previous = corner;
+                ++numCorners;
+            }
 
-            normals.push_back(temp_normals[normalIndexA]);
-            normals.push_back(temp_normals[normalIndexB]);
-            normals.push_back(temp_normals[normalIndexC]);
+        } else if (p[0] == 'o' && isBlank(p[1])) {
+            p += 2;
+            skipBlanks(p, end);
+            const char * name = p;
+            while (p < end && !isBlank(*p) && *p != '\n') ++p;
+            objectName.assign(name, p);
         }
     }
 
-    in.close();
-
 	if (objectName.compare("") == 0) {
 		// No 'o' object name tag defined in .obj file, so use the file name
 		// minus the '.obj' ending as the objectName.
 		const char * ptr = strrchr(objFilePath, '/');
-		objectName.assign(ptr+1);
+		objectName.assign(ptr ? ptr+1 : objFilePath);
 		size_t pos = objectName.find('.');
-		objectName.resize(pos);
+		if (pos != string::npos) objectName.resize(pos);
 	}
 }
 
+//---------------------------------------------------------------------------------------
+void ObjFileDecoder::decode(
+		const char * objFilePath,
+		std::string & objectName,
+        std::vector<vec3> & positions,
+        std::vector<vec3> & normals,
+        std::vector<vec2> & uvCoords
+) {
+
+	// Empty containers, and start fresh before inserting data from .obj file
+	positions.clear();
+	normals.clear();
+	uvCoords.clear();
+
+    vector<vec3> temp_positions;
+    vector<vec3> temp_normals;
+    vector<vec2> temp_uvCoords;
+    vector<ivec3> corners;
+    readObjFile(objFilePath, objectName, temp_positions, temp_normals, temp_uvCoords, corners);
+
+    positions.reserve(corners.size());
+    normals.reserve(corners.size());
+    uvCoords.reserve(temp_uvCoords.empty() ? 0 : corners.size());
+    for (const ivec3 & corner : corners) {
+        positions.push_back(temp_positions[corner.x]);
+        if (corner.y >= 0) {
+            uvCoords.push_back(temp_uvCoords[corner.y]);
+        }
+        normals.push_back(corner.z >= 0 ? temp_normals[corner.z] : vec3(0.0f));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+struct CornerHash {
+    size_t operator() (const ivec3 & corner) const {
+        return ((size_t)corner.x * 73856093u) ^ ((size_t)corner.y * 19349663u) ^
+                ((size_t)corner.z * 83492791u);
+    }
+};
+
+//---------------------------------------------------------------------------------------
+void ObjFileDecoder::decode(
+		const char * objFilePath,
+		std::string & objectName,
+        std::vector<vec3> & positions,
+        std::vector<vec3> & normals,
+        std::vector<vec2> & uvCoords,
+        std::vector<unsigned int> & indices
+) {
+
+	// Empty containers, and start fresh before inserting data from .obj file
+	positions.clear();
+	normals.clear();
+	uvCoords.clear();
+	indices.clear();
+
+    vector<vec3> temp_positions;
+    vector<vec3> temp_normals;
+    vector<vec2> temp_uvCoords;
+    vector<ivec3> corners;
+    readObjFile(objFilePath, objectName, temp_positions, temp_normals, temp_uvCoords, corners);
+
+    // weld corners with the same index triple into one vertex
+    unordered_map<ivec3, unsigned int, CornerHash> vertexOf;
+    vertexOf.reserve(corners.size());
+    indices.reserve(corners.size());
+    for (const ivec3 & corner : corners) {
+        auto found = vertexOf.find(corner);
+        if (found != vertexOf.end()) {
+            indices.push_back(found->second);
+            continue;
+        }
+
+        unsigned int index = positions.size();
+        vertexOf[corner] = index;
+        indices.push_back(index);
+
+        positions.push_back(temp_positions[corner.x]);
+        normals.push_back(corner.z >= 0 ? temp_normals[corner.z] : vec3(0.0f));
+        uvCoords.push_back(corner.y >= 0 ? temp_uvCoords[corner.y] : vec2(0.0f));
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void ObjFileDecoder::decode(
 		const char * objFilePath,
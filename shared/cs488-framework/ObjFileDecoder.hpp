@@ -11,6 +11,8 @@ public:
 	* Extracts vertex data from a Wavefront .obj file
 	* If an object name parameter is present in the .obj file, objectName is set to that,
 	* otherwise objectName is set to the name of the .obj file.
+	* Faces may have more than three corners, which are split into a triangle fan, and
+	* negative indices, which count back from the last element read.
 	*
 	* [in] objFilePath - path to .obj file
 	* [out] objectName - name given to object.
@@ -27,6 +29,28 @@ public:
     );
 
 
+	/**
+	* Extracts indexed vertex data from a Wavefront .obj file.  Face corners that use the
+	* same position, normal and uv indices become one vertex, referred to by indices.
+	* Faces without texture coordinates get a uv of (0,0).
+	*
+	* [in] objFilePath - path to .obj file
+	* [out] objectName - name given to object.
+	* [out] positions - positions given in (x,y,z) model space.
+	* [out] normals - normals given in (x,y,z) model space.
+	* [out] uvCoords - texture coordinates in (u,v) parameter space.
+	* [out] indices - three per triangle, into positions, normals and uvCoords.
+	*/
+    static void decode(
+		    const char * objFilePath,
+			std::string & objectName,
+            std::vector<glm::vec3> & positions,
+            std::vector<glm::vec3> & normals,
+            std::vector<glm::vec2> & uvCoords,
+            std::vector<unsigned int> & indices
+    );
+
+
 	/**
 	* Extracts vertex data from a Wavefront .obj file
 	* If an object name parameter is present in the .obj file, objectName is set to that,
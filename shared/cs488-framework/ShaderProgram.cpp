@@ -1,6 +1,7 @@
 #include "ShaderProgram.hpp"
 #include "ShaderException.hpp"
 #include "GlErrorCheck.hpp"
+#include "GlState.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 using glm::value_ptr;
@@ -9,6 +10,8 @@ using glm::value_ptr;
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 
 //------------------------------------------------------------------------------------
@@ -134,6 +137,84 @@ void ShaderProgram::link() {
     glLinkProgram(programObject);
     checkLinkStatus();
 
+    reflectUniforms();
+
+    CHECK_GL_ERRORS;
+}
+
+//------------------------------------------------------------------------------------
+/*
+ * Interned uniform names, shared by every ShaderProgram.
+ */
+static unordered_map<string, UniformId> & uniformIds() {
+    static unordered_map<string, UniformId> ids;
+    return ids;
+}
+
+//------------------------------------------------------------------------------------
+UniformId ShaderProgram::internUniform (
+		const char * uniformName
+) {
+    unordered_map<string, UniformId> & ids = uniformIds();
+    auto found = ids.find(uniformName);
+    if (found != ids.end()) {
+        return found->second;
+    }
+
+    UniformId id = ids.size();
+    ids[uniformName] = id;
+    return id;
+}
+
+//------------------------------------------------------------------------------------
+/*
+ * Records the location of every active uniform, and the index of every active uniform
+ * block.  Uniforms inside blocks have no location and are left out.
+ */
+void ShaderProgram::reflectUniforms() {
+    uniformLocations.clear();
+    uniformBlocks.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(programObject, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programObject, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(programObject, i, name.size(), NULL, &size, &type, name.data());
+        GLint location = glGetUniformLocation(programObject, name.data());
+        if (location == -1) {
+            continue;
+        }
+
+        // arrays are reported as "name[0]", look them up by "name" too
+        string uniformName(name.data());
+        vector<string> names(1, uniformName);
+        size_t bracket = uniformName.find('[');
+        if (bracket != string::npos) {
+            names.push_back(uniformName.substr(0, bracket));
+        }
+
+        for (const string & n : names) {
+            UniformId id = internUniform(n.c_str());
+            if (id >= uniformLocations.size()) {
+                uniformLocations.resize(id + 1, -1);
+            }
+            uniformLocations[id] = location;
+        }
+    }
+
+    count = 0;
+    maxLength = 0;
+    glGetProgramiv(programObject, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(programObject, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for (GLint i = 0; i < count; ++i) {
+        glGetActiveUniformBlockName(programObject, i, name.size(), NULL, name.data());
+        uniformBlocks[name.data()] = i;
+    }
+
     CHECK_GL_ERRORS;
 }
 
@@ -147,6 +228,7 @@ void ShaderProgram::deleteShaders() {
     glDeleteShader(vertexShader.shaderObject);
     glDeleteShader(fragmentShader.shaderObject);
     glDeleteProgram(programObject);
+    GlState::invalidate();
 }
 
 //------------------------------------------------------------------------------------
@@ -198,14 +280,16 @@ void ShaderProgram::checkCompilationStatus (
 
 //------------------------------------------------------------------------------------
 void ShaderProgram::enable() const {
-    glUseProgram(programObject);
+    GlState::useProgram(programObject);
     CHECK_GL_ERRORS;
 }
 
 //------------------------------------------------------------------------------------
+/*
+ * Leaves the program bound, so that enabling it again right after is free.  Whatever
+ * draws next enables its own program first.
+ */
 void ShaderProgram::disable() const {
-    glUseProgram((GLuint)NULL);
-    CHECK_GL_ERRORS;
 }
 
 //------------------------------------------------------------------------------------
@@ -244,7 +328,14 @@ GLuint ShaderProgram::getProgramObject() const {
 GLint ShaderProgram::getUniformLocation (
 		const char * uniformName
 ) const {
-    GLint result = glGetUniformLocation(programObject, (const GLchar *)uniformName);
+    const unordered_map<string, UniformId> & ids = uniformIds();
+    auto found = ids.find(uniformName);
+    GLint result = found == ids.end() ? -1 : getUniformLocation(found->second);
+
+    // only "name" and "name[0]" of an array are reflected, ask GL for other elements
+    if (result == -1) {
+        result = glGetUniformLocation(programObject, uniformName);
+    }
 
     if (result == -1) {
         stringstream errorMessage;
@@ -255,6 +346,33 @@ GLint ShaderProgram::getUniformLocation (
     return result;
 }
 
+//------------------------------------------------------------------------------------
+GLint ShaderProgram::getUniformLocation (
+		UniformId uniform
+) const {
+    return uniform < uniformLocations.size() ? uniformLocations[uniform] : -1;
+}
+
+//------------------------------------------------------------------------------------
+GLuint ShaderProgram::getUniformBlockIndex (
+		const char * blockName
+) const {
+    auto found = uniformBlocks.find(blockName);
+    return found == uniformBlocks.end() ? GL_INVALID_INDEX : found->second;
+}
+
+//------------------------------------------------------------------------------------
+void ShaderProgram::bindUniformBlock (
+		const char * blockName,
+		GLuint binding
+) const {
+    GLuint index = getUniformBlockIndex(blockName);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programObject, index, binding);
+        CHECK_GL_ERRORS;
+    }
+}
+
 //------------------------------------------------------------------------------------
 /*
  * Returns the location value of an attribute variable within the shader program.
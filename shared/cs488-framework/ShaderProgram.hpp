@@ -7,6 +7,12 @@
 #include "OpenGLImport.hpp"
 
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+// A uniform name interned once, process wide, so that looking its location up in any
+// ShaderProgram is an array index instead of a string search.
+typedef unsigned int UniformId;
 
 
 class ShaderProgram {
@@ -33,8 +39,21 @@ public:
 
     GLuint getProgramObject() const;
 
+    // Throws if the program has no such active uniform.
     GLint getUniformLocation(const char * uniformName) const;
 
+    // -1, which glUniform* ignores, if the program has no such active uniform.
+    GLint getUniformLocation(UniformId uniform) const;
+
+    static UniformId internUniform(const char * uniformName);
+
+    // GL_INVALID_INDEX if the program has no such active uniform block.
+    GLuint getUniformBlockIndex(const char * blockName) const;
+
+    // Points the named uniform block at a uniform buffer binding point, if the
+    // program uses the block.
+    void bindUniformBlock(const char * blockName, GLuint binding) const;
+
     GLint getAttribLocation(const char * attributeName) const;
 
 
@@ -66,6 +85,12 @@ private:
 
     void checkLinkStatus();
 
+    void reflectUniforms();
+
+    // Every active uniform and uniform block, read once at link time.
+    std::vector<GLint> uniformLocations; // by UniformId
+    std::unordered_map<std::string, GLuint> uniformBlocks;
+
     void deleteShaders();
 };
 
@@ -0,0 +1,130 @@
+#include "UniformBuffer.hpp"
+
+#include "GlErrorCheck.hpp"
+
+#include <cstring>
+using namespace std;
+
+
+//------------------------------------------------------------------------------------
+UniformBuffer::UniformBuffer()
+	: m_buffer(0),
+	  m_binding(0),
+	  m_capacity(0),
+	  m_head(0),
+	  m_alignment(1)
+{
+
+}
+
+//------------------------------------------------------------------------------------
+UniformBuffer::~UniformBuffer()
+{
+	destroy();
+}
+
+//------------------------------------------------------------------------------------
+void UniformBuffer::create (
+		GLuint binding,
+		size_t capacity
+) {
+	destroy();
+
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_alignment = alignment > 0 ? alignment : 1;
+
+	m_binding = binding;
+	m_capacity = capacity;
+	m_head = 0;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, m_capacity, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+
+	CHECK_GL_ERRORS;
+}
+
+//------------------------------------------------------------------------------------
+void UniformBuffer::destroy()
+{
+	if (m_buffer != 0) {
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_staging.clear();
+}
+
+//------------------------------------------------------------------------------------
+void UniformBuffer::update (
+		const void * data,
+		size_t size
+) {
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	if (size > m_capacity) {
+		m_capacity = size;
+	}
+	// orphan rather than wait for draws still reading the old contents
+	glBufferData(GL_UNIFORM_BUFFER, m_capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, m_binding, m_buffer, 0, size);
+	m_head = 0;
+
+	CHECK_GL_ERRORS;
+}
+
+//------------------------------------------------------------------------------------
+size_t UniformBuffer::push (
+		const void * data,
+		size_t size
+) {
+	size_t offset = m_staging.size();
+	m_staging.resize(offset + (size + m_alignment - 1) / m_alignment * m_alignment);
+	memcpy(m_staging.data() + offset, data, size);
+
+	return offset;
+}
+
+//------------------------------------------------------------------------------------
+size_t UniformBuffer::flush()
+{
+	size_t size = m_staging.size();
+	if (size == 0) {
+		return m_head;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	if (m_head + size > m_capacity) {
+		// full, start over in a fresh buffer and leave the old one to the draws using it
+		if (size > m_capacity) {
+			m_capacity = size;
+		}
+		glBufferData(GL_UNIFORM_BUFFER, m_capacity, NULL, GL_STREAM_DRAW);
+		m_head = 0;
+	}
+
+	// nothing in flight reads past m_head, so there's no need to synchronise
+	void * dst = glMapBufferRange(GL_UNIFORM_BUFFER, m_head, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	memcpy(dst, m_staging.data(), size);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	CHECK_GL_ERRORS;
+
+	size_t base = m_head;
+	m_head += size;
+	m_staging.clear();
+
+	return base;
+}
+
+//------------------------------------------------------------------------------------
+void UniformBuffer::bindRange (
+		size_t offset,
+		size_t size
+) const {
+	glBindBufferRange(GL_UNIFORM_BUFFER, m_binding, m_buffer, offset, size);
+}
@@ -0,0 +1,54 @@
+/*
+ * UniformBuffer
+ */
+
+#pragma once
+
+#include "OpenGLImport.hpp"
+
+#include <vector>
+
+
+/*
+* A std140 uniform buffer attached to one binding point.  Either holds a single block
+* that update() replaces, or is used as a ring: blocks are push()ed, flush() uploads them
+* in one go, and each draw binds its own range.
+*/
+class UniformBuffer {
+public:
+	UniformBuffer();
+
+	~UniformBuffer();
+
+	void create(GLuint binding, size_t capacity);
+
+	void destroy();
+
+	// Replaces the contents and binds all of them.
+	void update(const void * data, size_t size);
+
+	// Stages a block, returns its offset from the start of what the next flush() uploads.
+	// Offsets are aligned for glBindBufferRange.
+	size_t push(const void * data, size_t size);
+
+	// Uploads everything pushed since the last flush and returns the buffer offset it
+	// starts at.  Wraps to the start of a fresh buffer when the ring is full.
+	size_t flush();
+
+	void bindRange(size_t offset, size_t size) const;
+
+
+private:
+	// owns a GL buffer name, a copy would delete it twice
+	UniformBuffer(const UniformBuffer &);
+	UniformBuffer & operator = (const UniformBuffer &);
+
+	GLuint m_buffer;
+	GLuint m_binding;
+	size_t m_capacity;
+	size_t m_head;
+	size_t m_alignment;
+
+	std::vector<unsigned char> m_staging;
+};
+